@@ -0,0 +1,690 @@
+/* --------------------------------------------------------------------
+EXTREME TUXRACER
+
+Copyright (C) 2010 Extreme Tuxracer Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+---------------------------------------------------------------------*/
+
+#ifdef HAVE_CONFIG_H
+#include <etr_config.h>
+#endif
+
+#include "benchmark.h"
+#include "audio.h"
+#include "course.h"
+#include "env.h"
+#include "game_ctrl.h"
+#include "intro.h"
+#include "racing.h"
+#include "tux.h"
+#include "view.h"
+#include "spx.h"
+#include "winsys.h"
+#include "replay.h"
+#include "physics.h"
+#include "ogl.h"
+#include "simd.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#define BENCH_TIME_STEP (1.0 / 30.0)	// fixed step, so every run simulates the same frames
+#define BENCH_MAX_TIME 90.0				// seconds of race time per course
+
+CBenchmark Benchmark;
+
+// The input script is repeated until the course is finished. Steering
+// goes through the joystick interface of the racing state.
+struct TBenchInput {
+	float duration;
+	float turn;		// -1 = left, 1 = right
+	float push;		// -1 = paddling, 1 = braking
+};
+
+static const TBenchInput script[] = {
+	{2.0,  0.0, -1.0},
+	{1.5, -0.6,  0.0},
+	{1.5,  0.6,  0.0},
+	{1.0,  0.0,  1.0},
+	{2.0, -0.3, -1.0},
+	{2.0,  0.3,  0.0}
+};
+static const size_t script_len = sizeof(script) / sizeof(script[0]);
+
+// "name X ms, Y unit/s" for count operations in ms, the caller ends the line
+static ostream& PrintRate (const char *name, double ms, double count, const char *unit) {
+	return cout << name << ms << " ms, " << count / ms * 1000.0 << ' ' << unit << "/s";
+}
+
+void CBenchmark::Keyb (unsigned int key, bool special, bool release, int x, int y) {
+	if (!release && key == SDLK_ESCAPE) State::manager.RequestQuit ();
+}
+
+void CBenchmark::Enter () {
+	// same resources as the splash screen loads
+	Course.MakeStandardPolyhedrons ();
+	Sound.LoadSoundList ();
+	Char.LoadCharacterList ();
+	Course.LoadObjectTypes ();
+	Course.LoadTerrainTypes ();
+	Env.LoadEnvironmentList ();
+	Course.LoadCourseList ();
+	Players.LoadAvatars ();
+	Players.LoadPlayers ();
+
+	Players.ResetControls ();
+	Players.AllocControl (g_game.start_player);
+	g_game.player = Players.GetPlayer (g_game.start_player);
+	g_game.character = Char.GetCharacter (0);
+	g_game.mirrorred = false;
+	g_game.light_id = 0;
+	g_game.snow_id = 0;
+	g_game.theme_id = 0;
+
+	string filename = param.config_dir + SEP + "benchmark.csv";
+	report.open (filename.c_str());
+	if (!report) Message ("could not write benchmark report", filename);
+	report << "course,frame,race_time,cpu_ms\n";
+
+	course_idx = 0;
+	racing = false;
+	if (!replayfile.empty() && !Replay.Load (replayfile)) State::manager.RequestQuit ();
+}
+
+// The race parameters of the replay instead of the next course
+bool CBenchmark::SetupReplay () {
+	g_game.course = NULL;
+	for (size_t i = 0; i < Course.CourseList.size(); i++)
+		if (Course.CourseList[i].dir == Replay.course_dir) g_game.course = &Course.CourseList[i];
+	g_game.character = NULL;
+	for (size_t i = 0; i < Char.CharList.size(); i++)
+		if (Char.CharList[i].dir == Replay.char_dir) g_game.character = Char.GetCharacter (i);
+	if (g_game.course == NULL || g_game.character == NULL) {
+		Message ("course or character of the replay not found", Replay.course_dir + ' ' + Replay.char_dir);
+		return false;
+	}
+	g_game.mirrorred = Replay.mirrored;
+	g_game.light_id = Replay.light_id;
+	g_game.snow_id = Replay.snow_id;
+	g_game.wind_id = Replay.wind_id;
+	return true;
+}
+
+void CBenchmark::StartCourse () {
+	CTimer timer;
+	if (replayfile.empty()) {
+		g_game.course = &Course.CourseList[course_idx];
+	} else if (!SetupReplay ()) {
+		State::manager.RequestQuit ();
+		return;
+	}
+	Course.LoadCourse (g_game.course);
+	g_game.location_id = Course.GetEnv ();
+	Env.LoadEnvironment (g_game.location_id, g_game.light_id);
+	load_ms = timer.Milliseconds ();
+
+	// skip the intro animation, but do the same initialization
+	srand (1);
+	State& intro = Intro;
+	State& race = Racing;
+	intro.Enter ();
+	if (!replayfile.empty()) {
+		g_game.player->ctrl->cpos.x = Replay.start_x;
+		g_game.player->ctrl->cpos.z = Replay.start_z;
+	}
+	race.Enter ();
+	if (replayfile.empty()) set_view_mode (g_game.player->ctrl, BEHIND);
+	else Replay.StartPlayback ();
+
+	frame_ms.clear ();
+	racing = true;
+}
+
+void CBenchmark::ApplyScript () {
+	float period = 0;
+	for (size_t i = 0; i < script_len; i++) period += script[i].duration;
+
+	float t = fmod (g_game.time, period);
+	size_t step = 0;
+	while (step < script_len - 1 && t >= script[step].duration) {
+		t -= script[step].duration;
+		step++;
+	}
+
+	State& race = Racing;
+	race.Jaxis (0, script[step].turn);
+	race.Jaxis (1, script[step].push);
+}
+
+void CBenchmark::FinishCourse () {
+	State& race = Racing;
+	race.Exit ();
+	racing = false;
+
+	const string& name = g_game.course->name;
+	if (!frame_ms.empty()) {
+		double sum = 0;
+		for (size_t i = 0; i < frame_ms.size(); i++) sum += frame_ms[i];
+		vector<float> sorted = frame_ms;
+		sort (sorted.begin(), sorted.end());
+		cout << name << ": " << frame_ms.size() << " frames, load " << load_ms << " ms, avg "
+		     << sum / frame_ms.size() << " ms, p95 " << sorted[sorted.size() * 95 / 100]
+		     << " ms, max " << sorted.back() << " ms\n";
+	}
+	course_idx++;
+	if (!replayfile.empty()) State::manager.RequestQuit ();
+}
+
+void CBenchmark::Loop () {
+	if (!racing) {
+		if (course_idx >= Course.CourseList.size()) {
+			State::manager.RequestQuit ();
+			return;
+		}
+		StartCourse ();
+		if (!racing) return;
+	}
+
+	// a replay sets the time step and the input in CRacing::Loop
+	if (replayfile.empty()) {
+		g_game.time_step = BENCH_TIME_STEP;
+		ApplyScript ();
+	}
+
+	State& race = Racing;
+	CTimer timer;
+	race.Loop ();
+	float ms = timer.Milliseconds ();
+
+	report << g_game.course->dir << ',' << frame_ms.size() << ',' << g_game.time << ',' << ms << '\n';
+	frame_ms.push_back (ms);
+
+	// the racing state asks for the game over screen when the race ends,
+	// a replay runs until the recorded frames are used up
+	bool done = replayfile.empty() ? g_game.finish || g_game.time > BENCH_MAX_TIME : !Replay.Playing ();
+	if (State::manager.NextState() != NULL || done) {
+		State::manager.CancelRequest ();
+		FinishCourse ();
+	}
+}
+
+void CBenchmark::Exit () {
+	if (racing) FinishCourse ();
+	if (report.is_open()) {
+		report.close ();
+		Message ("benchmark report written to", param.config_dir + SEP + "benchmark.csv");
+	}
+}
+
+// --------------------------------------------------------------------
+//				parser benchmark
+// --------------------------------------------------------------------
+
+#define PARSE_PASSES 20
+
+void BenchmarkParser () {
+	CSPList courses (MAX_COURSES);
+	if (!courses.Load (param.common_course_dir, "courses.lst")) {
+		Message ("could not load courses.lst");
+		return;
+	}
+
+	vector<string> lines;
+	size_t bytes = 0;
+	for (size_t i = 0; i < courses.Count(); i++) {
+		CSPList items (16000);
+		string dir = param.common_course_dir + SEP + SPStrN (courses.Line(i), "dir");
+		if (!items.Load (dir, "items.lst")) continue;
+		for (size_t l = 0; l < items.Count(); l++) {
+			lines.push_back (items.Line(l));
+			bytes += items.Line(l).size();
+		}
+	}
+	if (lines.empty()) return;
+
+	// the sums keep the compiler from dropping the work
+	double sum = 0;
+	CTimer timer;
+	for (int pass = 0; pass < PARSE_PASSES; pass++) {
+		for (size_t i = 0; i < lines.size(); i++) {
+			const string& line = lines[i];
+			sum += SPIntN (line, "x", 0) + SPIntN (line, "z", 0);
+			sum += SPFloatN (line, "height", 1) + SPFloatN (line, "diam", 1);
+			sum += SPStrN (line, "name").size();
+		}
+	}
+	double sp_ms = timer.Milliseconds ();
+
+	timer.Start ();
+	for (int pass = 0; pass < PARSE_PASSES; pass++) {
+		for (size_t i = 0; i < lines.size(); i++) {
+			CSPLine line (lines[i]);
+			sum += line.Int ("x", 0) + line.Int ("z", 0);
+			sum += line.Float ("height", 1) + line.Float ("diam", 1);
+			sum += line.Str ("name").size();
+		}
+	}
+	double line_ms = timer.Milliseconds ();
+
+	double num = (double)lines.size() * PARSE_PASSES;
+	double mb = (double)bytes * PARSE_PASSES / (1024.0 * 1024.0);
+	cout << lines.size() << " item lines, " << bytes << " bytes, " << PARSE_PASSES << " passes (" << sum << ")\n";
+	PrintRate ("SP*N:    ", sp_ms, num, "lines") << ", " << mb / sp_ms * 1000.0 << " MB/s\n";
+	PrintRate ("CSPLine: ", line_ms, num, "lines") << ", " << mb / line_ms * 1000.0 << " MB/s\n";
+}
+
+// --------------------------------------------------------------------
+//				pose benchmark
+// --------------------------------------------------------------------
+
+#define POSE_UPDATES 200000
+
+// the joint updates of CCharShape::AdjustJoints by joint name, as they
+// were done before the joints were resolved in CCharShape::Load
+static void AdjustJointsByName (CCharShape& shape, ETR_DOUBLE turnFact, ETR_DOUBLE paddling) {
+	ETR_DOUBLE arm = min (paddling * 35.0, 30.0);
+	shape.ResetNode ("left_shldr");
+	shape.ResetNode ("right_shldr");
+	shape.ResetNode ("left_hip");
+	shape.ResetNode ("right_hip");
+	shape.ResetNode ("left_knee");
+	shape.ResetNode ("right_knee");
+	shape.ResetNode ("left_ankle");
+	shape.ResetNode ("right_ankle");
+	shape.ResetNode ("tail");
+	shape.ResetNode ("neck");
+	shape.ResetNode ("head");
+	shape.RotateNode ("left_shldr", 3, arm);
+	shape.RotateNode ("right_shldr", 3, arm);
+	shape.RotateNode ("left_shldr", 2, -paddling * 30.0);
+	shape.RotateNode ("right_shldr", 2, paddling * 30.0);
+	shape.RotateNode ("left_hip", 3, -20 + turnFact * 10);
+	shape.RotateNode ("right_hip", 3, -20 - turnFact * 10);
+	shape.RotateNode ("left_knee", 3, -10 + turnFact * 10 - 35.0);
+	shape.RotateNode ("right_knee", 3, -10 - turnFact * 10 - 35.0);
+	shape.RotateNode ("left_ankle", 3, 30.0);
+	shape.RotateNode ("right_ankle", 3, 30.0);
+	shape.RotateNode ("tail", 3, turnFact * 20);
+	shape.RotateNode ("neck", 3, -50);
+	shape.RotateNode ("head", 3, -30);
+	shape.RotateNode ("head", 2, -turnFact * 70);
+}
+
+void BenchmarkPose () {
+	CCharShape shape;
+	if (!shape.Load (param.char_dir + SEP "tux", "shape.lst", false)) return;
+
+	const TVector3d force (0, 0, -3000);
+	CTimer timer;
+	for (int i = 0; i < POSE_UPDATES; i++) {
+		ETR_DOUBLE t = (ETR_DOUBLE)i / POSE_UPDATES;
+		AdjustJointsByName (shape, t * 2.0 - 1.0, t);
+	}
+	double name_ms = timer.Milliseconds ();
+
+	timer.Start ();
+	for (int i = 0; i < POSE_UPDATES; i++) {
+		ETR_DOUBLE t = (ETR_DOUBLE)i / POSE_UPDATES;
+		shape.AdjustJoints (t * 2.0 - 1.0, false, t, 40.0, force, 0.0);
+	}
+	double pose_ms = timer.Milliseconds ();
+
+	cout << POSE_UPDATES << " pose updates of " << shape.GetNumNodes () << " nodes\n";
+	PrintRate ("by name:   ", name_ms, POSE_UPDATES, "poses") << '\n';
+	PrintRate ("TCharPose: ", pose_ms, POSE_UPDATES, "poses") << '\n';
+}
+
+// --------------------------------------------------------------------
+//				affine transform benchmark
+// --------------------------------------------------------------------
+
+#define AFFINE_UPDATES 200000
+#define AFFINE_SEQUENCES 1000
+// largest allowed deviation from TMatrix<4, 4>, relative to the value
+// (at least 1)
+#define AFFINE_EPS (sizeof(ETR_DOUBLE) == sizeof(float) ? 1e-5 : 1e-10)
+
+static ETR_DOUBLE MaxDeviation (const TAffine& a, const TMatrix<4, 4>& m) {
+	ETR_DOUBLE dev = 0;
+	for (int row = 0; row < 3; row++)
+		for (int col = 0; col < 4; col++) {
+			ETR_DOUBLE size = max ((ETR_DOUBLE)1, (ETR_DOUBLE)fabs (m[col][row]));
+			dev = max (dev, (ETR_DOUBLE)fabs (a[row][col] - m[col][row]) / size);
+		}
+	return dev;
+}
+
+enum {
+	DEV_TRANSFORM,		// Translate, Rotate, Scale
+	DEV_PRETRANSFORM,	// PreTranslate, PreRotate, PreScale
+	DEV_INVERSE,
+	DEV_RIGID_INVERSE,
+	DEV_PRODUCT,
+	NUM_DEVIATIONS
+};
+
+static const char *deviation_names[NUM_DEVIATIONS] = {
+	"Translate/Rotate/Scale",
+	"PreTranslate/PreRotate/PreScale",
+	"GetInverse",
+	"GetRigidInverse",
+	"operator*"
+};
+
+bool BenchmarkAffine () {
+	static const char axes[] = "xyz";
+	ETR_DOUBLE dev[NUM_DEVIATIONS] = {0};
+
+	// equivalence: the node updates of CCharShape with both types, and
+	// the same without scaling for the rigid inverse
+	for (int seq = 0; seq < AFFINE_SEQUENCES; seq++) {
+		TMatrix<4, 4> mat, inv, rigmat, riginv, op;
+		TAffine aff, affinv, rig;
+		mat.SetIdentity();
+		inv.SetIdentity();
+		rigmat.SetIdentity();
+		riginv.SetIdentity();
+		aff.SetIdentity();
+		affinv.SetIdentity();
+		rig.SetIdentity();
+		for (int step = 0; step < 6; step++) {
+			ETR_DOUBLE v = (ETR_DOUBLE)((seq * 7 + step * 13) % 50) / 10.0 - 2.5;
+			char axis = axes[(seq + step) % 3];
+			switch ((seq + step * 5) % 3) {
+				case 0:
+					op.SetTranslationMatrix (v, -v, v * 0.5);
+					mat = mat * op;
+					rigmat = rigmat * op;
+					op.SetTranslationMatrix (-v, v, -v * 0.5);
+					inv = op * inv;
+					riginv = op * riginv;
+					aff.Translate (v, -v, v * 0.5);
+					affinv.PreTranslate (-v, v, -v * 0.5);
+					rig.Translate (v, -v, v * 0.5);
+					break;
+				case 1:
+					op.SetRotationMatrix (v * 60, axis);
+					mat = mat * op;
+					rigmat = rigmat * op;
+					op.SetRotationMatrix (-v * 60, axis);
+					inv = op * inv;
+					riginv = op * riginv;
+					aff.Rotate (v * 60, axis);
+					affinv.PreRotate (-v * 60, axis);
+					rig.Rotate (v * 60, axis);
+					break;
+				case 2:
+					op.SetScalingMatrix (1.5 + v * 0.1, 1.0, 0.8);
+					mat = mat * op;
+					op.SetScalingMatrix (1.0 / (1.5 + v * 0.1), 1.0, 1.0 / 0.8);
+					inv = op * inv;
+					aff.Scale (1.5 + v * 0.1, 1.0, 0.8);
+					affinv.PreScale (1.0 / (1.5 + v * 0.1), 1.0, 1.0 / 0.8);
+					break;
+			}
+		}
+		dev[DEV_TRANSFORM] = max (dev[DEV_TRANSFORM], MaxDeviation (aff, mat));
+		dev[DEV_TRANSFORM] = max (dev[DEV_TRANSFORM], MaxDeviation (rig, rigmat));
+		dev[DEV_PRETRANSFORM] = max (dev[DEV_PRETRANSFORM], MaxDeviation (affinv, inv));
+		dev[DEV_INVERSE] = max (dev[DEV_INVERSE], MaxDeviation (aff.GetInverse(), inv));
+		dev[DEV_RIGID_INVERSE] = max (dev[DEV_RIGID_INVERSE], MaxDeviation (rig.GetRigidInverse(), riginv));
+		dev[DEV_PRODUCT] = max (dev[DEV_PRODUCT], MaxDeviation (TAffine (mat) * TAffine (inv), mat * inv));
+		dev[DEV_PRODUCT] = max (dev[DEV_PRODUCT], MaxDeviation (TAffine (inv) * TAffine (mat), inv * mat));
+	}
+
+	bool ok = true;
+	for (int i = 0; i < NUM_DEVIATIONS; i++) {
+		bool within = dev[i] <= AFFINE_EPS;
+		cout << deviation_names[i] << ": max deviation " << dev[i] << (within ? "" : ", FAILED") << '\n';
+		ok &= within;
+	}
+	if (ok) cout << "all results within " << AFFINE_EPS << " of TMatrix<4, 4>\n";
+	else cout << "FAILED: results differ by more than " << AFFINE_EPS << " from TMatrix<4, 4>\n";
+
+	// speed: translate + rotate of a node and its inverse, then one product
+	TMatrix<4, 4> mat, inv, op, sum;
+	mat.SetIdentity();
+	inv.SetIdentity();
+	CTimer timer;
+	for (int i = 0; i < AFFINE_UPDATES; i++) {
+		ETR_DOUBLE angle = (ETR_DOUBLE)(i % 360);
+		op.SetTranslationMatrix (0.1, 0.2, 0.3);
+		mat = mat * op;
+		op.SetTranslationMatrix (-0.1, -0.2, -0.3);
+		inv = op * inv;
+		op.SetRotationMatrix (angle, axes[i % 3]);
+		mat = mat * op;
+		op.SetRotationMatrix (-angle, axes[i % 3]);
+		inv = op * inv;
+		sum = mat * inv;
+	}
+	double matrix_ms = timer.Milliseconds ();
+	ETR_DOUBLE check = sum[0][0];
+
+	TAffine aff, affinv, affsum;
+	aff.SetIdentity();
+	affinv.SetIdentity();
+	timer.Start ();
+	for (int i = 0; i < AFFINE_UPDATES; i++) {
+		ETR_DOUBLE angle = (ETR_DOUBLE)(i % 360);
+		aff.Translate (0.1, 0.2, 0.3);
+		affinv.PreTranslate (-0.1, -0.2, -0.3);
+		aff.Rotate (angle, axes[i % 3]);
+		affinv.PreRotate (-angle, axes[i % 3]);
+		affsum = aff * affinv;
+	}
+	double affine_ms = timer.Milliseconds ();
+	check += affsum[0][0];
+
+	cout << AFFINE_UPDATES << " node updates (" << check << ")\n";
+	PrintRate ("TMatrix<4, 4>: ", matrix_ms, AFFINE_UPDATES, "updates") << '\n';
+	PrintRate ("TAffine:       ", affine_ms, AFFINE_UPDATES, "updates") << '\n';
+	return ok;
+}
+
+// --------------------------------------------------------------------
+//				character instances benchmark
+// --------------------------------------------------------------------
+
+#define INSTANCE_FRAMES 200
+#define MAX_BENCH_INSTANCES 32
+
+static double DrawInstanceFrames (CCharShape& shape, const TCharInstance *inst, size_t num, bool batched) {
+	CTimer timer;
+	for (int f = 0; f < INSTANCE_FRAMES; f++) {
+		ClearRenderContext (colDDBackgr);
+		if (batched) shape.DrawInstances (inst, num, 1.0);
+		else for (size_t k = 0; k < num; k++) shape.DrawInstances (&inst[k], 1, 1.0);
+		glFinish ();
+	}
+	return timer.Milliseconds () / INSTANCE_FRAMES;
+}
+
+void BenchmarkInstances () {
+	CCharShape shape;
+	if (!shape.Load (param.char_dir + SEP "tux", "shape.lst", false)) return;
+
+	// a grid of tuxes in front of the camera, each with its own pose
+	TCharInstance inst[MAX_BENCH_INSTANCES];
+	const TVector3d force (0, 0, -3000);
+	for (int k = 0; k < MAX_BENCH_INSTANCES; k++) {
+		ETR_DOUBLE t = (ETR_DOUBLE)k / MAX_BENCH_INSTANCES;
+		shape.ResetRoot ();
+		shape.TranslateNode (0, TVector3d ((k % 8) - 3.5, (k / 8) - 1.5, -8));
+		shape.AdjustJoints (t * 2.0 - 1.0, k % 2 == 1, t, 40.0, force, 0.0);
+		shape.GetInstance (inst[k]);
+	}
+
+	Reshape (Winsys.resolution.width, Winsys.resolution.height);
+	glLoadIdentity ();
+	cout << "ms per frame of " << shape.GetNumNodes () << " nodes each\n";
+	static const size_t counts[] = {1, 8, MAX_BENCH_INSTANCES};
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		size_t num = counts[c];
+		double single_ms = DrawInstanceFrames (shape, inst, num, false);
+		unsigned int single_draws = CCharShape::DrawStats ().draws * num;
+		double batched_ms = DrawInstanceFrames (shape, inst, num, true);
+		unsigned int batched_draws = CCharShape::DrawStats ().draws;
+		cout << num << " instances: one by one " << single_ms << " ms (" << single_draws
+		     << " draws), batched " << batched_ms << " ms (" << batched_draws << " draws)\n";
+	}
+}
+
+// --------------------------------------------------------------------
+//				SIMD math benchmark
+// --------------------------------------------------------------------
+
+#define SIMD_SAMPLES 1024		// random inputs, also cycled through by the timing loops
+#define SIMD_CALLS 2000000
+#define SIMD_MAX_ULP 2			// allowed if the compiler fuses multiply and add
+
+// Floats ordered as integers, so the difference counts the values in
+// between. +0 and -0 are the same.
+static Sint64 OrderedBits (ETR_DOUBLE f) {
+	if (sizeof(f) == sizeof(Sint32)) {
+		Sint32 i;
+		memcpy (&i, &f, sizeof(i));
+		return i < 0 ? -(Sint64)(i & 0x7fffffff) : i;
+	}
+	Sint64 i;
+	memcpy (&i, &f, sizeof(i));
+	return i < 0 ? -(i & 0x7fffffffffffffffLL) : i;
+}
+
+struct TSimdCheck {
+	Sint64 max_ulp;
+	size_t equal;
+	size_t values;
+	TSimdCheck () : max_ulp(0), equal(0), values(0) {}
+	void Add (ETR_DOUBLE simd, ETR_DOUBLE scalar) {
+		Sint64 ulp = OrderedBits (simd) - OrderedBits (scalar);
+		if (ulp < 0) ulp = -ulp;
+		max_ulp = max (max_ulp, ulp);
+		if (ulp == 0) equal++;
+		values++;
+	}
+	void Add (const TVector3d& simd, const TVector3d& scalar) {
+		Add (simd.x, scalar.x);
+		Add (simd.y, scalar.y);
+		Add (simd.z, scalar.z);
+	}
+	void Add (const TMatrix<4, 4>& simd, const TMatrix<4, 4>& scalar) {
+		for (int row = 0; row < 4; row++)
+			for (int col = 0; col < 4; col++)
+				Add (simd[row][col], scalar[row][col]);
+	}
+	void Add (const TAffine& simd, const TAffine& scalar) {
+		for (int row = 0; row < 3; row++)
+			for (int col = 0; col < 4; col++)
+				Add (simd[row][col], scalar[row][col]);
+	}
+};
+
+typedef TVector3d (*PMatrixVector) (const TMatrix<4, 4>&, const TVector3d&);
+typedef TVector3d (*PQuatVector) (const TQuaternion&, const TVector3d&);
+typedef TMatrix<4, 4> (*PQuatMatrix) (const TQuaternion&);
+typedef TAffine (*PAffineAffine) (const TAffine&, const TAffine&);
+
+struct TSimdInput {
+	vector<TAffine> aff;
+	vector<TMatrix<4, 4> > mat;
+	vector<TQuaternion> quat;
+	vector<TVector3d> vec;
+};
+
+static void PrintSimdResult (const char *name, const TSimdCheck& check, double simd_ms, double scalar_ms) {
+	cout << name << ": max " << (long)check.max_ulp << " ulp, " << check.equal << " of "
+	     << check.values << " equal, " << scalar_ms << " ms scalar, " << simd_ms << " ms\n";
+}
+
+// The argument of sample i for each function type, and one value of
+// the result for the sum that keeps the calls from being dropped
+static TVector3d CallSample (PMatrixVector func, const TSimdInput& in, size_t i) {
+	return func (in.mat[i], in.vec[i]);
+}
+static TVector3d CallSample (PQuatVector func, const TSimdInput& in, size_t i) {
+	return func (in.quat[i], in.vec[i]);
+}
+static TMatrix<4, 4> CallSample (PQuatMatrix func, const TSimdInput& in, size_t i) {
+	return func (in.quat[i]);
+}
+static TAffine CallSample (PAffineAffine func, const TSimdInput& in, size_t i) {
+	return func (in.aff[i], in.aff[(i + 1) % SIMD_SAMPLES]);
+}
+
+static ETR_DOUBLE SumValue (const TVector3d& v) { return v.x; }
+static ETR_DOUBLE SumValue (const TMatrix<4, 4>& m) { return m[1][2]; }
+static ETR_DOUBLE SumValue (const TAffine& a) { return a[0][3]; }
+
+template <class Func>
+static double TimeSimd (Func func, const TSimdInput& in, ETR_DOUBLE& sum) {
+	CTimer timer;
+	for (int i = 0; i < SIMD_CALLS; i++)
+		sum += SumValue (CallSample (func, in, i % SIMD_SAMPLES));
+	return timer.Milliseconds ();
+}
+
+template <class Func>
+static bool CheckSimd (const char *name, Func simd, Func scalar, const TSimdInput& in, ETR_DOUBLE& sum) {
+	TSimdCheck check;
+	for (size_t i = 0; i < SIMD_SAMPLES; i++)
+		check.Add (CallSample (simd, in, i), CallSample (scalar, in, i));
+	PrintSimdResult (name, check, TimeSimd (simd, in, sum), TimeSimd (scalar, in, sum));
+	return check.max_ulp <= SIMD_MAX_ULP;
+}
+
+bool BenchmarkSimd () {
+#if defined ETR_SSE
+	cout << "SSE";
+#elif defined ETR_NEON
+	cout << "NEON";
+#else
+	cout << "no SIMD, both columns are the scalar code";
+#endif
+	cout << ", " << SIMD_SAMPLES << " random inputs, " << SIMD_CALLS << " calls each\n";
+
+	// node transformations and unit quaternions as the game has them
+	static const char axes[] = "xyz";
+	TSimdInput in;
+	for (int i = 0; i < SIMD_SAMPLES; i++) {
+		TAffine aff;
+		aff.SetIdentity ();
+		aff.Translate (XRandom (-100, 100), XRandom (-100, 100), XRandom (-100, 100));
+		aff.Rotate (XRandom (-180, 180), axes[i % 3]);
+		aff.Rotate (XRandom (-180, 180), axes[(i + 1) % 3]);
+		aff.Scale (XRandom (0.2, 2), XRandom (0.2, 2), XRandom (0.2, 2));
+		in.aff.push_back (aff);
+		in.mat.push_back (aff.GetMatrix ());
+		TQuaternion q (XRandom (-1, 1), XRandom (-1, 1), XRandom (-1, 1), XRandom (-1, 1));
+		q.Norm ();
+		in.quat.push_back (q);
+		in.vec.push_back (TVector3d (XRandom (-10, 10), XRandom (-10, 10), XRandom (-10, 10)));
+	}
+
+	ETR_DOUBLE sum = 0;
+	bool ok = true;
+	PMatrixVector matPoint = TransformPoint, matPointScalar = TransformPointScalar;
+	PMatrixVector matVector = TransformVector, matVectorScalar = TransformVectorScalar;
+	PQuatMatrix quatMatrix = MakeMatrixFromQuaternion, quatMatrixScalar = MakeMatrixFromQuaternionScalar;
+	PQuatVector quatVector = RotateVector, quatVectorScalar = RotateVectorScalar;
+	PAffineAffine affMul = operator*, affMulScalar = MultiplyAffineScalar;
+	ok &= CheckSimd ("TransformPoint (TMatrix)", matPoint, matPointScalar, in, sum);
+	ok &= CheckSimd ("TransformVector (TMatrix)", matVector, matVectorScalar, in, sum);
+	ok &= CheckSimd ("MakeMatrixFromQuaternion", quatMatrix, quatMatrixScalar, in, sum);
+	ok &= CheckSimd ("RotateVector", quatVector, quatVectorScalar, in, sum);
+	ok &= CheckSimd ("TAffine * TAffine", affMul, affMulScalar, in, sum);
+
+	cout << "(" << sum << ")\n";
+	if (ok) cout << "all results within " << SIMD_MAX_ULP << " ulp of the scalar code\n";
+	else cout << "FAILED: results differ by more than " << SIMD_MAX_ULP << " ulp\n";
+	return ok;
+}
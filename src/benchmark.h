@@ -0,0 +1,79 @@
+/* --------------------------------------------------------------------
+EXTREME TUXRACER
+
+Copyright (C) 2010 Extreme Tuxracer Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+---------------------------------------------------------------------*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "bh.h"
+#include "states.h"
+#include <vector>
+#include <fstream>
+
+// Scripted benchmark race, started with "--benchmark [window|offscreen|null]".
+// Races every course of courses.lst with a fixed time step, a fixed
+// camera and a fixed input script, and writes the CPU time of each
+// frame to benchmark.csv in the config directory. With
+// "--replay file [window|offscreen|null]" it races the recorded race
+// instead, with its time steps, input and views (see replay.h).
+// Offscreen renders with the GL of the EGL driver; without a GPU that is
+// a software rasterizer and the frame times include its work. Null only
+// counts the gl calls and needs a build with -DUSE_GLSTATS.
+class CBenchmark : public State {
+	size_t course_idx;
+	bool racing;
+	double load_ms;
+	vector<float> frame_ms;
+	ofstream report;
+	string replayfile;
+
+	bool SetupReplay ();
+	void StartCourse ();
+	void FinishCourse ();
+	void ApplyScript ();
+	void Enter();
+	void Loop();
+	void Keyb(unsigned int key, bool special, bool release, int x, int y);
+	void Exit();
+public:
+	CBenchmark () : course_idx(0), racing(false), load_ms(0) {}
+	void SetReplay (const string& filename) { replayfile = filename; }
+};
+
+extern CBenchmark Benchmark;
+
+// "--benchmark-parse": SP line parsing throughput on the items.lst files
+// of all courses, the SP*N functions against CSPLine
+void BenchmarkParser ();
+
+// "--benchmark-pose": joint updates per second of the tux shape, by
+// joint name against the joint handles of TCharPose
+void BenchmarkPose ();
+
+// "--benchmark-affine": checks TAffine against TMatrix<4, 4> for the
+// node updates of CCharShape and compares their speed. False if a
+// result is further from TMatrix than the tolerance.
+bool BenchmarkAffine ();
+
+// "--benchmark-instances [window|offscreen]": draws 1, 8 and 32 tuxes of
+// one shared shape, one by one against one batch per material
+void BenchmarkInstances ();
+
+// "--benchmark-simd": checks the SSE/NEON versions of the mathlib
+// functions (see simd.h) against the scalar ones and compares their
+// speed. False if a result is more than SIMD_MAX_ULP from the scalar one.
+bool BenchmarkSimd ();
+
+#endif
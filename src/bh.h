@@ -156,6 +156,7 @@ using namespace std;
 #include "etr_types.h"
 #include "common.h"
 #include "game_config.h"
+#include "glstats.h"
 
 extern TGameData g_game;
 
@@ -21,8 +21,15 @@ GNU General Public License for more details.
 
 #include "common.h"
 #include "spx.h"
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_timer.h>
 #include <sys/stat.h>
+#ifndef OS_WIN32_MSC
+#include <sys/mman.h>
+#include <fcntl.h>
+#endif
 #include <iostream>
+#include <fstream>
 #include <cerrno>
 #include <ctime>
 
@@ -124,7 +131,9 @@ void PrintQuaternion (const TQuaternion& q) {
 //				message utils
 // --------------------------------------------------------------------
 
+// the course loader thread can report errors too
 static CSPList msg_list (100);
+static SDL_SpinLock msg_lock = 0;
 
 void SaveMessages () {
 	msg_list.Save (param.config_dir, "messages");
@@ -138,24 +147,32 @@ void Message (const char *msg, const char *desc) {
 
 	string aa = msg;
 	string bb = desc;
+	SDL_AtomicLock (&msg_lock);
 	cout << aa << "  " << bb << '\n';
 	msg_list.Add (aa + bb);
+	SDL_AtomicUnlock (&msg_lock);
 }
 
 void Message (const char *msg) {
+	SDL_AtomicLock (&msg_lock);
 	cout << msg << '\n';
 	if (*msg != 0)
 		msg_list.Add (msg);
+	SDL_AtomicUnlock (&msg_lock);
 }
 
 void Message (const string& a, const string& b) {
+	SDL_AtomicLock (&msg_lock);
 	cout << a << ' ' << b << endl;
 	msg_list.Add (a + b);
+	SDL_AtomicUnlock (&msg_lock);
 }
 
 void Message (const string& msg) {
+	SDL_AtomicLock (&msg_lock);
 	cout << msg << endl;
 	msg_list.Add (msg);
+	SDL_AtomicUnlock (&msg_lock);
 }
 
 // --------------------------------------------------------------------
@@ -196,6 +213,78 @@ bool DirExists (const char *dirname) {
 }
 #endif
 
+bool FileStat (const string& filename, Sint64 *mtime, Sint64 *size) {
+	struct stat stat_info;
+	if (stat (filename.c_str(), &stat_info) != 0) return false;
+	*mtime = (Sint64)stat_info.st_mtime;
+	*size = (Sint64)stat_info.st_size;
+	return true;
+}
+
+string CompiledName (const string& filename) {
+	size_t dot = filename.rfind ('.');
+	return filename.substr (0, dot) + ".pak";
+}
+
+bool CMappedFile::Open (const string& filename) {
+	Close ();
+#ifndef OS_WIN32_MSC
+	int fd = open (filename.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat stat_info;
+	if (fstat (fd, &stat_info) == 0 && stat_info.st_size > 0) {
+		void *addr = mmap (NULL, stat_info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED) {
+			data = (unsigned char*)addr;
+			size = stat_info.st_size;
+			mapped = true;
+		}
+	}
+	close (fd);
+	if (mapped) {
+		opened = true;
+		return true;
+	}
+#endif
+	ifstream file (filename.c_str(), ios::in | ios::binary);
+	if (!file) return false;
+	file.seekg (0, ios::end);
+	streamoff len = file.tellg ();
+	if (len < 0) return false;
+	opened = true;
+	if (len == 0) return true;	// empty, Data() is NULL
+	file.seekg (0, ios::beg);
+	data = new unsigned char[(size_t)len];
+	size = (size_t)len;
+	if (!file.read ((char*)data, len)) {
+		Close ();
+		return false;
+	}
+	return true;
+}
+
+void CMappedFile::Close () {
+	opened = false;
+	if (data == NULL) return;
+#ifndef OS_WIN32_MSC
+	if (mapped) munmap (data, size);
+	else delete[] data;
+#else
+	delete[] data;
+#endif
+	data = NULL;
+	size = 0;
+	mapped = false;
+}
+
+void CTimer::Start () {
+	start = SDL_GetPerformanceCounter ();
+}
+
+double CTimer::Milliseconds () const {
+	return (double)(SDL_GetPerformanceCounter () - start) * 1000.0 / (double)SDL_GetPerformanceFrequency ();
+}
+
 // --------------------------------------------------------------------
 //				date and time
 // --------------------------------------------------------------------
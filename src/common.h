@@ -19,6 +19,7 @@ GNU General Public License for more details.
 #define COMMON_H
 
 #include "bh.h"
+#include <SDL2/SDL_stdinc.h>
 #include "matrices.h"
 
 using namespace std;
@@ -99,6 +100,45 @@ bool	FileExists (const char *filename);
 bool	FileExists (const string& filename);
 bool	FileExists (const string& dir, const string& filename);
 bool	DirExists (const char *dirname);
+bool	FileStat (const string& filename, Sint64 *mtime, Sint64 *size);
+string	CompiledName (const string& filename);	// "start.lst" -> "start.pak"
+
+// A whole file in memory, read-only for the file itself. Where mmap is
+// available the file is mapped privately (copy on write), otherwise it
+// is read in one block.
+class CMappedFile {
+	unsigned char *data;
+	size_t size;
+	bool mapped;
+	bool opened;
+	CMappedFile (const CMappedFile&);
+	CMappedFile& operator= (const CMappedFile&);
+public:
+	CMappedFile () : data(NULL), size(0), mapped(false), opened(false) {}
+	~CMappedFile () { Close (); }
+
+	bool Open (const string& filename);
+	void Close ();
+	bool IsOpen () const { return opened; }
+	unsigned char *Data () const { return data; }
+	size_t Size () const { return size; }
+	void Swap (CMappedFile& other) {
+		swap (data, other.data);
+		swap (size, other.size);
+		swap (mapped, other.mapped);
+		swap (opened, other.opened);
+	}
+};
+
+// Wall clock time in ms since the construction or the last Start, for
+// the benchmarks and the compile tools
+class CTimer {
+	Uint64 start;
+public:
+	CTimer () { Start (); }
+	void Start ();
+	double Milliseconds () const;
+};
 
 // --------------------------------------------------------------------
 //				message utils
@@ -33,7 +33,10 @@ GNU General Public License for more details.
 #include "physics.h"
 #include "winsys.h"
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <fstream>
+#include <iostream>
 
 CCourse Course;
 
@@ -43,11 +46,30 @@ CCourse::CCourse () {
 	nmls = NULL;
 	vnc_array = NULL;
 	mirrored = false;
+	use_package = true;
+
+	load_course = NULL;
+	loader = NULL;
+	load_ok = false;
+	load_pending = false;
+	load_reload = false;
+	load_mirror = false;
+	load_cached = false;
+	load_treemap = false;
+	SDL_AtomicSet (&load_progress, 0);
+	SDL_AtomicSet (&load_done, 0);
+
+	preview_idx = 0;
+	preview_image = NULL;
+	preview_loader = NULL;
+	preview_ok = false;
+	SDL_AtomicSet (&preview_done, 0);
 
 	curr_course = NULL;
 }
 
 CCourse::~CCourse() {
+	WaitLoader ();
 	FreeCourseList ();
 	ResetCourse ();
 }
@@ -85,135 +107,121 @@ size_t CCourse::GetCourseIdx(const TCourse* course) const {
 	return idx;
 }
 
-void CCourse::CalcNormals () {
-	for (int y=0; y<ny; y++) {
+// The normal of a vertex is the sum of the normals of the adjacent
+// triangles. The triangle pattern alternates like a chess board.
+// The x and z coordinates only depend
+// on the column and the row, so they are taken from tables instead of
+// being divided out for every point. Rows are independent of each
+// other and are split among several threads on big courses.
+
+struct TNormalJob {
+	const ETR_DOUBLE *elevation;
+	const ETR_DOUBLE *xcd;
+	const ETR_DOUBLE *zcd;
+	TVector3d *out;
+	int nx, ny;
+	int y0, y1;
+};
+
+static inline void AddTriangleNormal (TVector3d& nml, const TVector3d& p0,
+                                      const TVector3d& p1, const TVector3d& p2) {
+	TVector3d n = CrossProduct (p2 - p0, p1 - p0);
+	n.Norm();
+	nml += n;
+}
+
+static void CalcNormalRows (const TNormalJob& job) {
+	const int nx = job.nx;
+	const int ny = job.ny;
+	const ETR_DOUBLE *elev = job.elevation;
+	const ETR_DOUBLE *xcd = job.xcd;
+	const ETR_DOUBLE *zcd = job.zcd;
+#define PT(_x,_y) TVector3d(xcd[_x], elev[(_x) + nx*(_y)], zcd[_y])
+
+	for (int y=job.y0; y<job.y1; y++) {
 		for (int x=0; x<nx; x++) {
 			TVector3d nml(0.0, 0.0, 0.0);
-			TVector3d p0 (XCD(x), ELEV(x,y), ZCD(y));
+			TVector3d p0 = PT(x, y);
+			bool left = x > 0;
+			bool right = x < nx-1;
+			bool up = y > 0;
+			bool down = y < ny-1;
 
+			// the order of the sums matters for exact results
 			if ((x + y) % 2 == 0) {
-				if (x > 0 && y > 0) {
-					TVector3d p1 = NMLPOINT(x,  y-1);
-					TVector3d p2 = NMLPOINT(x-1,y-1);
-					TVector3d v1 = p1 - p0;
-					TVector3d v2 = p2 - p0;
-					TVector3d n = CrossProduct (v2, v1);
-
-					n.Norm();
-					nml += n;
-
-					p1 = NMLPOINT (x-1, y-1);
-					p2 = NMLPOINT (x-1, y);
-					v1 = p1 - p0;
-					v2 = p2 - p0;
-					n = CrossProduct (v2, v1);
-
-					n.Norm();
-					nml += n;
+				if (left && up) {
+					AddTriangleNormal (nml, p0, PT(x, y-1), PT(x-1, y-1));
+					AddTriangleNormal (nml, p0, PT(x-1, y-1), PT(x-1, y));
 				}
-				if (x > 0 && y < ny-1) {
-					TVector3d p1 = NMLPOINT(x-1,y);
-					TVector3d p2 = NMLPOINT(x-1,y+1);
-					TVector3d v1 = p1 - p0;
-					TVector3d v2 = p2 - p0;
-					TVector3d n = CrossProduct (v2, v1);
-
-					n.Norm();
-					nml += n;
-
-					p1 = NMLPOINT(x-1,y+1);
-					p2 = NMLPOINT(x  ,y+1);
-					v1 = p1 - p0;
-					v2 = p2 - p0;
-					n = CrossProduct (v2, v1);
-
-					n.Norm();
-					nml += n;
+				if (left && down) {
+					AddTriangleNormal (nml, p0, PT(x-1, y), PT(x-1, y+1));
+					AddTriangleNormal (nml, p0, PT(x-1, y+1), PT(x, y+1));
 				}
-				if (x < nx-1 && y > 0) {
-					TVector3d p1 = NMLPOINT(x+1,y);
-					TVector3d p2 = NMLPOINT(x+1,y-1);
-					TVector3d v1 = p1 - p0;
-					TVector3d v2 = p2 - p0;
-					TVector3d n = CrossProduct (v2, v1);
-
-					n.Norm();
-					nml += n;
-
-					p1 = NMLPOINT(x+1,y-1);
-					p2 = NMLPOINT(x  ,y-1);
-					v1 = p1 - p0;
-					v2 = p2 - p0;
-					n = CrossProduct (v2, v1);
-
-					n.Norm();
-					nml += n;
+				if (right && up) {
+					AddTriangleNormal (nml, p0, PT(x+1, y), PT(x+1, y-1));
+					AddTriangleNormal (nml, p0, PT(x+1, y-1), PT(x, y-1));
 				}
-				if (x < nx-1 && y < ny-1) {
-					TVector3d p1 = NMLPOINT(x+1,y);
-					TVector3d p2 = NMLPOINT(x+1,y+1);
-					TVector3d v1 = p1 - p0;
-					TVector3d v2 = p2 - p0;
-					TVector3d n = CrossProduct (v1, v2);
-
-					n.Norm();
-					nml += n;
-
-					p1 = NMLPOINT(x+1,y+1);
-					p2 = NMLPOINT(x  ,y+1);
-					v1 = p1 - p0;
-					v2 = p2 - p0;
-					n = CrossProduct (v1, v2);
-
-					n.Norm();
-					nml += n;
+				if (right && down) {
+					AddTriangleNormal (nml, p0, PT(x+1, y+1), PT(x+1, y));
+					AddTriangleNormal (nml, p0, PT(x, y+1), PT(x+1, y+1));
 				}
 			} else {
-				if (x > 0 && y > 0) {
-					TVector3d p1 = NMLPOINT(x,  y-1);
-					TVector3d p2 = NMLPOINT(x-1,y);
-					TVector3d v1 = p1 - p0;
-					TVector3d v2 = p2 - p0;
-					TVector3d n = CrossProduct (v2, v1);
+				if (left && up)
+					AddTriangleNormal (nml, p0, PT(x, y-1), PT(x-1, y));
+				if (left && down)
+					AddTriangleNormal (nml, p0, PT(x-1, y), PT(x, y+1));
+				if (right && up)
+					AddTriangleNormal (nml, p0, PT(x+1, y), PT(x, y-1));
+				if (right && down)
+					AddTriangleNormal (nml, p0, PT(x, y+1), PT(x+1, y));
+			}
+			nml.Norm();
+			job.out [x + nx * y] = nml;
+		}
+	}
+#undef PT
+}
 
-					n.Norm();
-					nml += n;
-				}
-				if (x > 0 && y < ny-1) {
-					TVector3d p1 = NMLPOINT(x-1,y);
-					TVector3d p2 = NMLPOINT(x  ,y+1);
-					TVector3d v1 = p1 - p0;
-					TVector3d v2 = p2 - p0;
-					TVector3d n = CrossProduct (v2, v1);
+static int NormalThread (void *job) {
+	CalcNormalRows (*(const TNormalJob*)job);
+	return 0;
+}
 
-					n.Norm();
-					nml += n;
-				}
-				if (x < nx-1 && y > 0) {
-					TVector3d p1 = NMLPOINT(x+1,y);
-					TVector3d p2 = NMLPOINT(x  ,y-1);
-					TVector3d v1 = p1 - p0;
-					TVector3d v2 = p2 - p0;
-					TVector3d n = CrossProduct (v2, v1);
+#define MAX_NORMAL_THREADS 8
+#define MIN_THREADED_VERTICES 65536
 
-					n.Norm();
-					nml += n;
-				}
-				if (x < nx-1 && y < ny-1) {
-					TVector3d p1 = NMLPOINT(x+1,y);
-					TVector3d p2 = NMLPOINT(x  ,y+1);
-					TVector3d v1 = p1 - p0;
-					TVector3d v2 = p2 - p0;
-					TVector3d n = CrossProduct (v1, v2);
+void CCourse::CalcNormals (TVector3d *out, int numthreads) const {
+	vector<ETR_DOUBLE> xcd (nx);
+	vector<ETR_DOUBLE> zcd (ny);
+	for (int x=0; x<nx; x++) xcd[x] = XCD(x);
+	for (int y=0; y<ny; y++) zcd[y] = ZCD(y);
 
-					n.Norm();
-					nml += n;
-				}
-			}
-			nml.Norm();
-			nmls [x + nx * y] = nml;
-		}
+	if (numthreads <= 0) {
+		numthreads = nx * ny < MIN_THREADED_VERTICES ? 1 : SDL_GetCPUCount ();
+	}
+	numthreads = max (1, min (min (numthreads, MAX_NORMAL_THREADS), ny));
+
+	TNormalJob jobs[MAX_NORMAL_THREADS];
+	SDL_Thread *threads[MAX_NORMAL_THREADS];
+	for (int i=0; i<numthreads; i++) {
+		jobs[i].elevation = elevation;
+		jobs[i].xcd = &xcd[0];
+		jobs[i].zcd = &zcd[0];
+		jobs[i].out = out;
+		jobs[i].nx = nx;
+		jobs[i].ny = ny;
+		jobs[i].y0 = ny * i / numthreads;
+		jobs[i].y1 = ny * (i+1) / numthreads;
+	}
+
+	// the calling thread does the first band itself
+	for (int i=1; i<numthreads; i++) {
+		threads[i] = SDL_CreateThread (NormalThread, "normals", &jobs[i]);
+		if (threads[i] == NULL) CalcNormalRows (jobs[i]);
 	}
+	CalcNormalRows (jobs[0]);
+	for (int i=1; i<numthreads; i++)
+		if (threads[i] != NULL) SDL_WaitThread (threads[i], NULL);
 }
 
 void CCourse::MakeCourseNormals () {
@@ -223,8 +231,9 @@ void CCourse::MakeCourseNormals () {
 	} catch (...) {
 		nmls = NULL;
 		Message ("Allocation failed in MakeCourseNormals");
+		return;
 	}
-	CalcNormals ();
+	CalcNormals (nmls);
 }
 
 
@@ -235,12 +244,6 @@ void CCourse::MakeCourseNormals () {
 void CCourse::FillGlArrays() {
 	TVector3d pt, *normals = nmls;
 
-#ifndef USE_GLES1
-	glDisableClientState (GL_VERTEX_ARRAY);
-	glDisableClientState (GL_NORMAL_ARRAY);
-	glDisableClientState (GL_COLOR_ARRAY);
-#endif
-
 	if(vnc_array == NULL)
 		vnc_array = new GLubyte[STRIDE_GL_ARRAY * nx * ny];
 
@@ -278,7 +281,9 @@ void CCourse::FillGlArrays() {
 			BYTEVAL(3) = 255;
 		}
 	}
-	
+}
+
+void CCourse::BindGlArrays () {
 #ifndef USE_GLES1
 	glEnableClientState (GL_VERTEX_ARRAY);
 	glVertexPointer (3, GL_FLOAT, STRIDE_GL_ARRAY, vnc_array);
@@ -346,14 +351,22 @@ void CCourse::MakeStandardPolyhedrons () {
 
 void CCourse::FreeTerrainTextures () {
 	for (size_t i=0; i<TerrList.size(); i++) {
-		delete TerrList[i].texture;
+		Tex.Release (TerrList[i].texture);
 		TerrList[i].texture = NULL;
 	}
 }
 
+void CCourse::LoadObjectTexture (size_t type) {
+	if (ObjTypes[type].texture == NULL && ObjTypes[type].drawable) {
+		string terrpath = param.obj_dir + SEP + ObjTypes[type].textureFile;
+		ObjTypes[type].texture = Tex.Acquire (terrpath, true, false);
+		Tex.MakeResident (ObjTypes[type].texture);
+	}
+}
+
 void CCourse::FreeObjectTextures () {
 	for (size_t i=0; i<ObjTypes.size(); i++) {
-		delete ObjTypes[i].texture;
+		Tex.Release (ObjTypes[i].texture);
 		ObjTypes[i].texture = NULL;
 	}
 }
@@ -409,37 +422,46 @@ bool sortItem (const TItem& i,const TItem& j)
 	return i.type<j.type;
 }
 
-void CCourse::LoadItemList () {
-	CSPList list (16000);
+void CCourse::AddItem (const CSPLine& line) {
+	int x = line.Int ("x", 0);
+	int z = line.Int ("z", 0);
+	ETR_DOUBLE height = line.Float ("height", 1);
+	ETR_DOUBLE diam = line.Float ("diam", 1);
+	ETR_DOUBLE xx = (nx - x) / (ETR_DOUBLE)(nx - 1.0) * curr_course->size.x;
+	ETR_DOUBLE zz = -(ny - z) / (ETR_DOUBLE)(ny - 1.0) * curr_course->size.y;
+
+	// runs on the loader thread, so the index is only read; unknown
+	// names get the first type, as before
+	map<string, size_t>::const_iterator it = ObjectIndex.find (line.Str ("name"));
+	size_t type = it != ObjectIndex.end() ? it->second : 0;
+
+	if (ObjTypes[type].collidable)
+		CollArr.push_back(TCollidable(xx, CalcYCoord(xx, zz), zz, height, diam, type));
+	else
+		NocollArr.push_back(TItem(xx, CalcYCoord(xx, zz), zz, height, diam, &ObjTypes[type]));
+}
 
-	if (!list.Load (CourseDir, "items.lst")) {
-		Message ("could not load items list");
-		return;
+// items.lst can have many thousand lines, so it is parsed straight
+// from the file buffer
+class CItemListVisitor : public CSPVisitor {
+	CCourse& course;
+	CSPLine line;
+public:
+	CItemListVisitor (CCourse& c) : course(c) {}
+	void Visit (const char *s, size_t len) {
+		line.Parse (s, len);
+		course.AddItem (line);
 	}
+};
 
+void CCourse::LoadItemList () {
 	CollArr.clear();
 	NocollArr.clear();
-	for (size_t i=0; i<list.Count(); i++) {
-		const string& line = list.Line(i);
-		int x = SPIntN (line, "x", 0);
-		int z = SPIntN (line, "z", 0);
-		ETR_DOUBLE height = SPFloatN (line, "height", 1);
-		ETR_DOUBLE diam = SPFloatN (line, "diam", 1);
-		ETR_DOUBLE xx = (nx - x) / (ETR_DOUBLE)(nx - 1.0) * curr_course->size.x;
-		ETR_DOUBLE zz = -(ny - z) / (ETR_DOUBLE)(ny - 1.0) * curr_course->size.y;
-
-		string name = SPStrN (line, "name");
-		size_t type = ObjectIndex[name];
-		if (ObjTypes[type].texture == NULL && ObjTypes[type].drawable) {
-			string terrpath = param.obj_dir + SEP + ObjTypes[type].textureFile;
-			ObjTypes[type].texture = new TTexture();
-			ObjTypes[type].texture->LoadMipmap(terrpath, false);
-		}
 
-		if (ObjTypes[type].collidable)
-			CollArr.push_back(TCollidable(xx, FindYCoord(xx, zz), zz, height, diam, type));
-		else
-			NocollArr.push_back(TItem(xx, FindYCoord(xx, zz), zz, height, diam, &ObjTypes[type]));
+	CItemListVisitor visitor (*this);
+	if (!CSPList::Stream (CourseDir, "items.lst", visitor)) {
+		Message ("could not load items list");
+		return;
 	}
 	std::sort(CollArr.begin(),CollArr.end(),sortCollidable);
 	std::sort(NocollArr.begin(),NocollArr.end(),sortItem);
@@ -505,11 +527,6 @@ bool CCourse::LoadAndConvertObjectMap () {
 				cnt++;
 				ETR_DOUBLE xx = (nx - x) / (ETR_DOUBLE)(nx - 1.0) * curr_course->size.x;
 				ETR_DOUBLE zz = -(ny - y) / (ETR_DOUBLE)(ny - 1.0) * curr_course->size.y;
-				if (ObjTypes[type].texture == NULL && ObjTypes[type].drawable) {
-					string terrpath = param.obj_dir + SEP + ObjTypes[type].textureFile;
-					ObjTypes[type].texture = new TTexture();
-					ObjTypes[type].texture->LoadMipmap(terrpath, false);
-				}
 
 				// set random height and diam - see constants above
 				switch (type) {
@@ -536,9 +553,9 @@ bool CCourse::LoadAndConvertObjectMap () {
 				}
 
 				if (ObjTypes[type].collidable)
-					CollArr.push_back(TCollidable(xx, FindYCoord(xx, zz), zz, height, diam, type));
+					CollArr.push_back(TCollidable(xx, CalcYCoord(xx, zz), zz, height, diam, type));
 				else
-					NocollArr.push_back(TItem(xx, FindYCoord(xx, zz), zz, height, diam, &ObjTypes[type]));
+					NocollArr.push_back(TItem(xx, CalcYCoord(xx, zz), zz, height, diam, &ObjTypes[type]));
 
 				string line = "*[name]";
 				line += ObjTypes[type].name;
@@ -551,6 +568,8 @@ bool CCourse::LoadAndConvertObjectMap () {
 		}
 		pad += (nx * treeImg.depth) % 4;
 	}
+	std::sort(CollArr.begin(),CollArr.end(),sortCollidable);
+	std::sort(NocollArr.begin(),NocollArr.end(),sortItem);
 	string itemfile = CourseDir + SEP "items.lst";
 	savelist.Save (itemfile); // Convert trees.png to items.lst
 	return true;
@@ -672,10 +691,6 @@ bool CCourse::LoadTerrainMap () {
 			int arridx = (nx-1-x) + nx * (ny-1-y);
 			int terr = GetTerrain (&terrImage.data[imgidx]);
 			terrain[arridx] = terr;
-			if (TerrList[terr].texture == NULL) {
-				TerrList[terr].texture = new TTexture();
-				TerrList[terr].texture->LoadMipmap(param.terr_dir, TerrList[terr].textureFile, true);
-			}
 		}
 		pad += (nx * terrImage.depth) % 4;
 	}
@@ -686,6 +701,29 @@ bool CCourse::LoadTerrainMap () {
 //					LoadCourseList
 // --------------------------------------------------------------------
 
+// The course.dim files are summarized in courses.idx in the config
+// directory, together with their time stamps. Only files that changed
+// since the index was written are read again.
+
+#define COURSE_INDEX "courses.idx"
+
+bool CCourse::LoadCourseIndex (map<string, string>& index) const {
+	string filename = param.config_dir + SEP COURSE_INDEX;
+	if (!FileExists (filename)) return false;
+	CSPList list (MAX_COURSES);
+	if (!list.Load (filename)) return false;
+	for (size_t i=0; i<list.Count(); i++)
+		index[SPStrN (list.Line(i), "dir")] = list.Line(i);
+	return true;
+}
+
+void CCourse::SaveCourseIndex (const map<string, string>& index) const {
+	CSPList list (index.size());
+	for (map<string, string>::const_iterator it = index.begin(); it != index.end(); ++it)
+		list.Add (it->second);
+	list.Save (param.config_dir + SEP COURSE_INDEX);
+}
+
 bool CCourse::LoadCourseList () {
 	CSPList list (128);
 
@@ -694,6 +732,9 @@ bool CCourse::LoadCourseList () {
 		return false;
 	}
 
+	map<string, string> index;
+	LoadCourseIndex (index);
+	bool index_changed = false;
 	CSPList paramlist (48);
 
 	CourseList.resize(list.Count());
@@ -701,57 +742,159 @@ bool CCourse::LoadCourseList () {
 		const string& line1 = list.Line(i);
 		CourseList[i].name = SPStrN (line1, "name", "noname");
 		CourseList[i].dir = SPStrN (line1, "dir", "nodir");
-
-		string desc = SPStrN (line1, "desc");
-		FT.AutoSizeN (2);
-		vector<string> desclist = FT.MakeLineList (desc.c_str(), 300 * Winsys.scale - 16.0);
-		size_t cnt = min<size_t>(desclist.size(), MAX_DESCRIPTION_LINES);
-		CourseList[i].num_lines = cnt;
-		for (size_t ll=0; ll<cnt; ll++) {
-			CourseList[i].desc[ll] = desclist[ll];
+		CourseList[i].description = SPStrN (line1, "desc");
+		CourseList[i].num_lines = 0;
+		CourseList[i].wrapped = false;
+		CourseList[i].preview = NULL;
+		CourseList[i].no_preview = false;
+		CourseList[i].preview_used = 0;
+
+		// params
+		string paramfile = param.common_course_dir + SEP + CourseList[i].dir + SEP "course.dim";
+		Sint64 mtime = 0, fsize = 0;
+		if (!FileStat (paramfile, &mtime, &fsize))
+			Message ("could not load course.dim");
+
+		string& line2 = index[CourseList[i].dir];
+		if (SPIntN (line2, "mtime", -1) != mtime || SPIntN (line2, "fsize", -1) != fsize) {
+			line2.clear();
+			SPAddStrN (line2, "dir", CourseList[i].dir);
+			SPAddIntN (line2, "mtime", mtime);
+			SPAddIntN (line2, "fsize", fsize);
+			if (fsize > 0 && paramlist.Load (paramfile) && paramlist.Count() > 0)
+				line2 += ' ' + paramlist.Line (0);
+			paramlist.Clear ();	// the list is used several times
+			index_changed = true;
 		}
 
-		string coursepath = param.common_course_dir + SEP + CourseList[i].dir;
-		if (DirExists (coursepath.c_str())) {
-			// preview
-			string previewfile = coursepath + SEP "preview.png";
-			CourseList[i].preview = new TTexture();
-			if (!CourseList[i].preview->LoadMipmap(previewfile, false)) {
-				Message ("couldn't load previewfile");
-//				texid = Tex.TexID (NO_PREVIEW);
-			}
+		CSPLine dim (line2);
+		CourseList[i].author = dim.Str ("author", "unknown");
+		CourseList[i].size.x = dim.Float ("width", 100);
+		CourseList[i].size.y = dim.Float ("length", 1000);
+		CourseList[i].play_size.x = dim.Float ("play_width", 90);
+		CourseList[i].play_size.y = dim.Float ("play_length", 900);
+		CourseList[i].angle = dim.Float ("angle", 10);
+		CourseList[i].scale = dim.Float ("scale", 10);
+		CourseList[i].start.x = dim.Float ("startx", 50);
+		CourseList[i].start.y = dim.Float ("starty", 5);
+		CourseList[i].env = Env.GetEnvIdx (dim.Str ("env", "etr"));
+		CourseList[i].music_theme = Music.GetThemeIdx (dim.Str ("theme", "normal"));
+		CourseList[i].use_keyframe = dim.Bool ("use_keyframe", false);
+		CourseList[i].finish_brake = dim.Float ("finish_brake", 20);
+	}
+	list.MakeIndex (CourseIndex, "dir");
+	if (index_changed) SaveCourseIndex (index);
+	return true;
+}
 
-			// params
-			string paramfile = coursepath + SEP "course.dim";
-			if (!paramlist.Load (paramfile)) {
-				Message ("could not load course.dim");
-			}
+void CCourse::WrapDescription (size_t idx) {
+	if (idx >= CourseList.size() || CourseList[idx].wrapped) return;
+	TCourse& course = CourseList[idx];
+	FT.AutoSizeN (2);
+	vector<string> desclist = FT.MakeLineList (course.description.c_str(), 300 * Winsys.scale - 16.0);
+	course.num_lines = min<size_t>(desclist.size(), MAX_DESCRIPTION_LINES);
+	for (size_t ll=0; ll<course.num_lines; ll++) {
+		course.desc[ll] = desclist[ll];
+	}
+	course.wrapped = true;
+}
 
-			const string& line2 = paramlist.Line (0);
-			CourseList[i].author = SPStrN (line2, "author", "unknown");
-			CourseList[i].size.x = SPFloatN (line2, "width", 100);
-			CourseList[i].size.y = SPFloatN (line2, "length", 1000);
-			CourseList[i].play_size.x = SPFloatN (line2, "play_width", 90);
-			CourseList[i].play_size.y = SPFloatN (line2, "play_length", 900);
-			CourseList[i].angle = SPFloatN (line2, "angle", 10);
-			CourseList[i].scale = SPFloatN (line2, "scale", 10);
-			CourseList[i].start.x = SPFloatN (line2, "startx", 50);
-			CourseList[i].start.y = SPFloatN (line2, "starty", 5);
-			CourseList[i].env = Env.GetEnvIdx (SPStrN (line2, "env", "etr"));
-			CourseList[i].music_theme = Music.GetThemeIdx (SPStrN (line2, "theme", "normal"));
-			CourseList[i].use_keyframe = SPBoolN (line2, "use_keyframe", false);
-			CourseList[i].finish_brake = SPFloatN (line2, "finish_brake", 20);
-			paramlist.Clear ();	// the list is used several times
+// --------------------------------------------------------------------
+//				course previews
+// --------------------------------------------------------------------
+// Previews are only loaded for the courses the race selection shows or
+// will probably show next. The png is decoded on a thread, the texture
+// is made on the main thread. At most MAX_PREVIEWS textures are kept,
+// the ones shown longest ago are freed first.
+
+int CCourse::PreviewThread (void *course) {
+	CCourse *c = (CCourse*)course;
+	string previewfile = param.common_course_dir + SEP + c->CourseList[c->preview_idx].dir + SEP "preview.png";
+	c->preview_ok = c->preview_image->LoadPng (previewfile.c_str(), true, true);
+	SDL_AtomicSet (&c->preview_done, 1);
+	return 0;
+}
+
+void CCourse::UpdatePreviews () {
+	if (preview_loader != NULL) {
+		if (SDL_AtomicGet (&preview_done) == 0) return;
+		SDL_WaitThread (preview_loader, NULL);
+		preview_loader = NULL;
+
+		TCourse& course = CourseList[preview_idx];
+		course.preview = new TTexture();
+		if (!preview_ok || !course.preview->LoadMipmap (*preview_image, false)) {
+			Message ("couldn't load previewfile");
+			delete course.preview;
+			course.preview = NULL;
+			course.no_preview = true;
+		}
+		course.preview_used = SDL_GetTicks ();
+		delete preview_image;
+		preview_image = NULL;
+
+		size_t loaded = 0;
+		size_t oldest = CourseList.size();
+		for (size_t i=0; i<CourseList.size(); i++) {
+			if (CourseList[i].preview == NULL) continue;
+			loaded++;
+			if (oldest == CourseList.size() || CourseList[i].preview_used < CourseList[oldest].preview_used)
+				oldest = i;
+		}
+		if (loaded > MAX_PREVIEWS) {
+			delete CourseList[oldest].preview;
+			CourseList[oldest].preview = NULL;
 		}
 	}
-	list.MakeIndex (CourseIndex, "dir");
-	return true;
+
+	while (!preview_queue.empty()) {
+		size_t idx = preview_queue.front();
+		preview_queue.erase (preview_queue.begin());
+		if (CourseList[idx].preview != NULL || CourseList[idx].no_preview) continue;
+
+		preview_idx = idx;
+		preview_image = new CImage;
+		SDL_AtomicSet (&preview_done, 0);
+		preview_loader = SDL_CreateThread (PreviewThread, "preview loader", this);
+		if (preview_loader == NULL) PreviewThread (this);
+		else break;
+	}
 }
 
-void CCourse::FreeCourseList () {
+TTexture* CCourse::GetPreview (size_t idx) {
+	if (idx >= CourseList.size()) return NULL;
+	TCourse& course = CourseList[idx];
+	if (course.preview != NULL) {
+		course.preview_used = SDL_GetTicks ();
+	} else if (!course.no_preview) {
+		// the neighbours are the next ones the up/down control can show
+		preview_queue.clear();
+		preview_queue.push_back (idx);
+		if (idx + 1 < CourseList.size()) preview_queue.push_back (idx + 1);
+		if (idx > 0) preview_queue.push_back (idx - 1);
+	}
+	UpdatePreviews ();
+	return course.preview;
+}
+
+void CCourse::FreePreviews () {
+	if (preview_loader != NULL) {
+		SDL_WaitThread (preview_loader, NULL);
+		preview_loader = NULL;
+	}
+	delete preview_image;
+	preview_image = NULL;
+	preview_queue.clear();
 	for (size_t i=0; i<CourseList.size(); i++) {
 		delete CourseList[i].preview;
+		CourseList[i].preview = NULL;
 	}
+}
+
+void CCourse::FreeCourseList () {
+	WaitLoader ();			// the loader reads the current entry
+	FreeCourseCache ();		// refers to the list entries
+	FreePreviews ();
 	CourseList.clear();
 }
 
@@ -760,6 +903,15 @@ void CCourse::FreeCourseList () {
 //  ===================================================================
 
 void CCourse::ResetCourse () {
+	WaitLoader ();
+	load_pending = false;
+	if (package.IsOpen ()) {
+		nmls = NULL;
+		vnc_array = NULL;
+		elevation = NULL;
+		terrain = NULL;
+		package.Close ();
+	}
 	if (nmls != NULL) {delete[] nmls; nmls = NULL;}
 	if (vnc_array != NULL) {delete[] vnc_array; vnc_array = NULL;}
 	if (elevation != NULL) {delete[] elevation; elevation = NULL;}
@@ -772,9 +924,40 @@ void CCourse::ResetCourse () {
 	mirrored = false;
 }
 
+// Loading is split in two stages. The data stage (png decoding or the
+// course package, normals, gl arrays, items) only reads files and fills
+// the course arrays and can run on a loader thread. Everything that
+// touches other state (quadtree, mirroring, textures and gl state) is
+// done in FinishLoading on the thread that owns the gl context. Nothing
+// else may use the course until FinishLoading.
+
 bool CCourse::LoadCourse (TCourse* course) {
-	if (course != curr_course || g_game.force_treemap) {
-		ResetCourse ();
+	StartLoading (course, false);
+	return FinishLoading ();
+}
+
+void CCourse::StartLoading (TCourse* course, bool threaded) {
+	if (load_pending) {
+		// a prefetch of this course is still running, just go on with it
+		if (course == load_course && !g_game.force_treemap) return;
+		FinishLoading ();
+	}
+
+	load_reload = course != curr_course || !load_ok || g_game.force_treemap;
+	load_treemap = g_game.force_treemap;
+	g_game.force_treemap = false;
+	// with the load state of the course before, so a failed one isn't kept
+	if (load_reload) StashCourse ();	// may free textures, so not on the loader thread
+
+	load_course = course;
+	load_ok = true;
+	load_pending = true;
+	load_mirror = false;
+	load_cached = false;
+	SDL_AtomicSet (&load_progress, 0);
+	SDL_AtomicSet (&load_done, 0);
+
+	if (load_reload) {
 		curr_course = course;
 		CourseDir = param.common_course_dir + SEP + curr_course->dir;
 
@@ -785,94 +968,692 @@ bool CCourse::LoadCourse (TCourse* course) {
 		g_game.use_keyframe = course->use_keyframe;
 		g_game.finish_brake = course->finish_brake;
 
-		if (!LoadElevMap ()) {
-			Message ("could not load course elev map");
-			return false;
-		}
+		load_cached = !load_treemap && RestoreCourse (course);
+	}
+
+	if (threaded && !load_cached) loader = SDL_CreateThread (LoadThread, "course loader", this);
+	if (loader == NULL) LoadCourseData ();
+}
+
+int CCourse::LoadThread (void *course) {
+	((CCourse*)course)->LoadCourseData ();
+	return 0;
+}
+
+void CCourse::WaitLoader () {
+	if (loader != NULL) {
+		SDL_WaitThread (loader, NULL);
+		loader = NULL;
+	}
+}
+
+bool CCourse::LoadCourseFiles () {
+	if (!LoadElevMap ()) {
+		Message ("could not load course elev map");
+		return false;
+	}
+	SDL_AtomicSet (&load_progress, 20);
+
+	MakeCourseNormals ();
+	SDL_AtomicSet (&load_progress, 45);
+	FillGlArrays ();
+	SDL_AtomicSet (&load_progress, 55);
+
+	if (!LoadTerrainMap ()) {
+		Message ("could not load course terrain map");
+		return false;
+	}
+	SDL_AtomicSet (&load_progress, 70);
 
-		MakeCourseNormals ();
-		FillGlArrays ();
+	// ................................................................
+	string itemfile = CourseDir + SEP "items.lst";
+	bool itemsexists = FileExists (itemfile);
 
-		if (!LoadTerrainMap ()) {
-			Message ("could not load course terrain map");
-			return false;
+	if (itemsexists && !load_treemap)
+		LoadItemList ();
+	else
+		LoadAndConvertObjectMap ();
+	// ................................................................
+	return true;
+}
+
+void CCourse::LoadCourseData () {
+	if (load_reload && !load_cached) {
+		if (load_treemap || !use_package || !LoadPackage ())
+			load_ok = LoadCourseFiles ();
+	}
+
+	SDL_AtomicSet (&load_progress, 100);
+	SDL_AtomicSet (&load_done, 1);
+}
+
+void CCourse::LoadCourseTextures () {
+	vector<bool> used (TerrList.size(), false);
+	for (int i=0; i<nx*ny; i++) {
+		size_t terr = (unsigned char)terrain[i];
+		if (terr < used.size()) used[terr] = true;
+	}
+	for (size_t i=0; i<TerrList.size(); i++) {
+		if (used[i] && TerrList[i].texture == NULL) {
+			// uploaded now rather than in the first frames of the race
+			TerrList[i].texture = Tex.Acquire (param.terr_dir + SEP + TerrList[i].textureFile, true, true);
+			Tex.MakeResident (TerrList[i].texture);
 		}
+	}
+
+	for (size_t i=0; i<CollArr.size(); i++) LoadObjectTexture (CollArr[i].tree_type);
+	for (size_t i=0; i<NocollArr.size(); i++) LoadObjectTexture (NocollArr[i].type - &ObjTypes[0]);
+}
 
-		// ................................................................
-		string itemfile = CourseDir + SEP "items.lst";
-		bool itemsexists = FileExists (itemfile);
-		const CControl *ctrl = g_game.player->ctrl;
+bool CCourse::FinishLoading () {
+	WaitLoader ();
+	if (!load_pending) return load_ok;
+	load_pending = false;
+	if (!load_ok) return false;
 
-		if (itemsexists && !g_game.force_treemap)
-			LoadItemList ();
-		else
-			LoadAndConvertObjectMap ();
-		g_game.force_treemap = false;
-		// ................................................................
+	if (load_reload && !load_cached) {
+		// the course compiler runs without a player
+		TVector3d viewpos;
+		if (g_game.player != NULL) viewpos = g_game.player->ctrl->viewpos;
 
-		init_track_marks ();
 		InitQuadtree (
 		    elevation, nx, ny,
 		    curr_course->size.x / (nx - 1.0),
 		    -curr_course->size.y / (ny - 1.0),
-		    ctrl->viewpos,
+		    viewpos,
 		    param.course_detail_level);
 	}
 
+	// cheap, and a prefetched course may have been started unmirrored
 	if (g_game.mirrorred != mirrored) {
-		MirrorCourse ();
-		mirrored = g_game.mirrorred;
+		MirrorCourseData ();
+		load_mirror = true;
+	}
+	if (load_reload) LoadCourseTextures ();
+	if (load_reload) BindGlArrays ();
+	if (load_reload || load_mirror) init_track_marks ();
+	return true;
+}
+
+// Called every frame by the menus that choose a course. The course is
+// loaded in the background while the player looks at the menu and the
+// one loaded before goes into the cache, see StashCourse.
+
+void CCourse::Prefetch (TCourse* course) {
+	if (load_pending) {
+		if (!LoadingDone ()) return;
+		FinishLoading ();
+	}
+	if (course == NULL || course == curr_course || g_game.force_treemap) return;
+	StartLoading (course);
+}
+
+// --------------------------------------------------------------------
+//				course cache
+// --------------------------------------------------------------------
+// Instead of being freed, the current course is kept with everything
+// the loader computed (arrays, objects, quadtree), as long as all kept
+// courses fit into param.course_cache_size MB. Going back to one of them
+// only swaps pointers. Terrain and object textures are shared by all
+// courses and stay loaded while the cache is on.
+
+void CCourse::StashCourse () {
+	// only finished courses are kept, an unfinished one has no quadtree
+	// and its arrays may still be written by the loader
+	WaitLoader ();
+	if (curr_course == NULL || !load_ok || load_pending || param.course_cache_size <= 0) {
+		ResetCourse ();
+		return;
 	}
+
+	TCourseState *state = new TCourseState;
+	state->course = curr_course;
+	state->nx = nx;
+	state->ny = ny;
+	state->start_pt = start_pt;
+	state->mirrored = mirrored;
+	state->elevation = elevation;
+	state->terrain = terrain;
+	state->nmls = nmls;
+	state->vnc_array = vnc_array;
+	state->package.Swap (package);
+	state->CollArr.swap (CollArr);
+	state->NocollArr.swap (NocollArr);
+	state->quadtree = DetachQuadtree ();
+
+	if (state->package.IsOpen ()) state->bytes = state->package.Size ();
+	else state->bytes = (size_t)nx * ny * (sizeof(ETR_DOUBLE) + sizeof(char)
+	                    + sizeof(TVector3d) + STRIDE_GL_ARRAY);
+	state->bytes += state->CollArr.size() * sizeof(TCollidable)
+	                + state->NocollArr.size() * sizeof(TItem)
+	                + QuadtreeBytes (state->quadtree);
+	cache.push_front (state);
+
+	elevation = NULL;
+	terrain = NULL;
+	nmls = NULL;
+	vnc_array = NULL;
+	curr_course = NULL;
+	mirrored = false;
+	TrimCache ((size_t)param.course_cache_size * 1024 * 1024);
+}
+
+bool CCourse::RestoreCourse (TCourse* course) {
+	list<TCourseState*>::iterator it = cache.begin();
+	while (it != cache.end() && (*it)->course != course) ++it;
+	if (it == cache.end()) return false;
+
+	TCourseState *state = *it;
+	cache.erase (it);
+	nx = state->nx;
+	ny = state->ny;
+	start_pt = state->start_pt;
+	mirrored = state->mirrored;
+	elevation = state->elevation;
+	terrain = state->terrain;
+	nmls = state->nmls;
+	vnc_array = state->vnc_array;
+	package.Swap (state->package);
+	CollArr.swap (state->CollArr);
+	NocollArr.swap (state->NocollArr);
+	AttachQuadtree (state->quadtree, nx, ny,
+	                curr_course->size.x / (nx - 1.0), -curr_course->size.y / (ny - 1.0));
+	delete state;
 	return true;
 }
 
+void CCourse::TrimCache (size_t budget) {
+	size_t total = 0;
+	for (list<TCourseState*>::iterator it = cache.begin(); it != cache.end(); ++it)
+		total += (*it)->bytes;
+
+	while (!cache.empty() && total > budget) {
+		total -= cache.back()->bytes;
+		FreeCourseState (cache.back());
+		cache.pop_back();
+	}
+}
+
+void CCourse::FreeCourseState (TCourseState* state) {
+	if (!state->package.IsOpen ()) {
+		delete[] state->elevation;
+		delete[] state->terrain;
+		delete[] state->nmls;
+		delete[] state->vnc_array;
+	}
+	DeleteQuadtree (state->quadtree);
+	delete state;
+}
+
 size_t CCourse::GetEnv () const {
 	return curr_course->env;
 }
 
 // --------------------------------------------------------------------
-//				mirror course
+//				compiled course package
 // --------------------------------------------------------------------
+// course.pak in the course directory holds everything LoadCourse
+// computes from the png files and items.lst, in the in-memory layout of
+// this build. The file is mapped and elevation, nmls, terrain and
+// vnc_array point straight into the mapping. A package is only used if
+// the source files and course parameters match the ones it was
+// compiled from, otherwise the course is loaded from the png files.
+// Packages are written by "etr --compile-courses". The header and the
+// object records have only fixed-width fields (and ETR_DOUBLE, which is
+// checked), so they have the same layout on 32 and 64 bit systems.
+
+#define PACKAGE_FILE "course.pak"
+#define PACKAGE_MAGIC 0x43525445	// "ETRC"
+#define PACKAGE_VERSION 2
+#define PACKAGE_ALIGN 16
+#define NUM_PACKAGE_STAMPS 10
+
+struct TPackageHeader {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 header_size;		// the layout checks
+	Uint32 real_size;
+	Uint32 vector_size;
+	Uint32 stride;
+	Uint32 num_terr_types;
+	Uint32 num_obj_types;
+	Sint32 nx, ny;
+	Uint32 num_coll;
+	Uint32 num_items;
+	ETR_DOUBLE size_x, size_y;
+	ETR_DOUBLE angle, scale;
+	Sint64 stamps[NUM_PACKAGE_STAMPS];	// mtime and size of the source files and type lists
+	Uint64 elevation_ofs;
+	Uint64 nmls_ofs;
+	Uint64 terrain_ofs;
+	Uint64 vnc_ofs;
+	Uint64 coll_ofs;
+	Uint64 items_ofs;
+	Uint64 total_size;
+};
+
+struct TPackageObject {
+	ETR_DOUBLE x, y, z;
+	ETR_DOUBLE height, diam;
+	Uint32 type;
+	Uint32 unused;			// pads the record to 8 bytes if ETR_DOUBLE is double
+};
 
-void CCourse::MirrorCourseData () {
-	for (int y=0; y<ny; y++) {
-		for (int x=0; x<nx/2; x++) {
-			ETR_DOUBLE tmp = ELEV(x,y);
-			ELEV(x,y) = ELEV(nx-1-x, y);
-			ELEV(nx-1-x,y) = tmp;
-
-			int idx1 = (x+1) + nx*(y);
-			int idx2 = (nx-1-x) + nx*(y);
-			swap(terrain[idx1], terrain[idx2]);
-
-			idx1 = (x) + nx*(y);
-			idx2 = (nx-1-x) + nx*(y);
-			swap(nmls[idx1], nmls[idx2]);
-			nmls[idx1].x *= -1;
-			nmls[idx2].x *= -1;
-		}
+static size_t AlignPackage (size_t ofs) {
+	return (ofs + PACKAGE_ALIGN - 1) & ~(size_t)(PACKAGE_ALIGN - 1);
+}
+
+// true if count records of the given size at ofs lie inside the file
+static bool InPackage (Uint64 ofs, Uint64 count, Uint64 size, Uint64 file_size) {
+	return ofs % PACKAGE_ALIGN == 0 && ofs <= file_size && count <= (file_size - ofs) / size;
+}
+
+static bool ValidObjectTypes (const TPackageObject* obj, size_t count, size_t num_types) {
+	for (size_t i=0; i<count; i++)
+		if (obj[i].type >= num_types) return false;
+	return true;
+}
+
+// quadsquare counts the terrain types with the bytes as indices
+static bool ValidTerrain (const unsigned char* terr, size_t count, size_t num_types) {
+	for (size_t i=0; i<count; i++)
+		if (terr[i] >= num_types) return false;
+	return true;
+}
+
+bool CCourse::GetPackageStamps (Sint64 stamps[]) const {
+	string objfile = FileExists (CourseDir + SEP "items.lst") ? "items.lst" : "trees.png";
+	return FileStat (CourseDir + SEP "elev.png", &stamps[0], &stamps[1])
+	       && FileStat (CourseDir + SEP "terrain.png", &stamps[2], &stamps[3])
+	       && FileStat (CourseDir + SEP + objfile, &stamps[4], &stamps[5])
+	       && FileStat (param.terr_dir + SEP "terrains.lst", &stamps[6], &stamps[7])
+	       && FileStat (param.obj_dir + SEP "object_types.lst", &stamps[8], &stamps[9]);
+}
+
+static void FillPackageHeader (TPackageHeader& hdr, const TCourse* course, size_t num_terr, size_t num_obj) {
+	memset (&hdr, 0, sizeof(hdr));
+	hdr.magic = PACKAGE_MAGIC;
+	hdr.version = PACKAGE_VERSION;
+	hdr.header_size = sizeof(TPackageHeader);
+	hdr.real_size = sizeof(ETR_DOUBLE);
+	hdr.vector_size = sizeof(TVector3d);
+	hdr.stride = STRIDE_GL_ARRAY;
+	hdr.num_terr_types = num_terr;
+	hdr.num_obj_types = num_obj;
+	hdr.size_x = course->size.x;
+	hdr.size_y = course->size.y;
+	hdr.angle = course->angle;
+	hdr.scale = course->scale;
+}
+
+bool CCourse::LoadPackage () {
+	string filename = CourseDir + SEP PACKAGE_FILE;
+	if (!FileExists (filename)) return false;
+
+	TPackageHeader expected;
+	FillPackageHeader (expected, curr_course, TerrList.size(), ObjTypes.size());
+	if (!GetPackageStamps (expected.stamps)) return false;
+
+	if (!package.Open (filename)) return false;
+	const TPackageHeader* hdr = (const TPackageHeader*)package.Data();
+	if (package.Size() < sizeof(TPackageHeader)
+	        || hdr->magic != expected.magic
+	        || hdr->version != expected.version
+	        || hdr->header_size != expected.header_size
+	        || hdr->real_size != expected.real_size
+	        || hdr->vector_size != expected.vector_size
+	        || hdr->stride != expected.stride
+	        || hdr->num_terr_types != expected.num_terr_types
+	        || hdr->num_obj_types != expected.num_obj_types
+	        || hdr->size_x != expected.size_x || hdr->size_y != expected.size_y
+	        || hdr->angle != expected.angle || hdr->scale != expected.scale
+	        || memcmp (hdr->stamps, expected.stamps, sizeof(expected.stamps)) != 0
+	        || hdr->total_size != package.Size()) {
+		Message ("course package is out of date", filename);
+		package.Close ();
+		return false;
 	}
 
-	for (size_t i=0; i<CollArr.size(); i++) {
-		CollArr[i].pt.x = curr_course->size.x - CollArr[i].pt.x;
-		CollArr[i].pt.y = FindYCoord (CollArr[i].pt.x, CollArr[i].pt.z);
+	// nothing is read from the mapping before all blocks are known to
+	// lie inside it
+	Uint64 size = package.Size();
+	Uint64 num = (Uint64)hdr->nx * (Uint64)hdr->ny;
+	if (hdr->nx <= 0 || hdr->ny <= 0
+	        || !InPackage (hdr->elevation_ofs, num, sizeof(ETR_DOUBLE), size)
+	        || !InPackage (hdr->nmls_ofs, num, sizeof(TVector3d), size)
+	        || !InPackage (hdr->terrain_ofs, num, 1, size)
+	        || !InPackage (hdr->vnc_ofs, num, STRIDE_GL_ARRAY, size)
+	        || !InPackage (hdr->coll_ofs, hdr->num_coll, sizeof(TPackageObject), size)
+	        || !InPackage (hdr->items_ofs, hdr->num_items, sizeof(TPackageObject), size)
+	        || !ValidObjectTypes ((const TPackageObject*)(package.Data() + hdr->coll_ofs), hdr->num_coll, ObjTypes.size())
+	        || !ValidObjectTypes ((const TPackageObject*)(package.Data() + hdr->items_ofs), hdr->num_items, ObjTypes.size())
+	        || !ValidTerrain (package.Data() + hdr->terrain_ofs, num, TerrList.size())) {
+		Message ("corrupt course package", filename);
+		package.Close ();
+		return false;
 	}
 
-	for (size_t i=0; i<NocollArr.size(); i++) {
-		NocollArr[i].pt.x = curr_course->size.x - NocollArr[i].pt.x;
-		NocollArr[i].pt.y = FindYCoord (NocollArr[i].pt.x, NocollArr[i].pt.z);
+	unsigned char *data = package.Data();
+	const TPackageObject* coll = (const TPackageObject*)(data + hdr->coll_ofs);
+	const TPackageObject* items = (const TPackageObject*)(data + hdr->items_ofs);
+
+	nx = hdr->nx;
+	ny = hdr->ny;
+	elevation = (ETR_DOUBLE*)(data + hdr->elevation_ofs);
+	nmls = (TVector3d*)(data + hdr->nmls_ofs);
+	terrain = (char*)(data + hdr->terrain_ofs);
+	vnc_array = data + hdr->vnc_ofs;
+
+	CollArr.clear();
+	CollArr.reserve(hdr->num_coll);
+	for (size_t i=0; i<hdr->num_coll; i++) {
+		CollArr.push_back(TCollidable(coll[i].x, coll[i].y, coll[i].z, coll[i].height, coll[i].diam, coll[i].type));
 	}
 
-	FillGlArrays();
+	NocollArr.clear();
+	NocollArr.reserve(hdr->num_items);
+	for (size_t i=0; i<hdr->num_items; i++) {
+		NocollArr.push_back(TItem(items[i].x, items[i].y, items[i].z, items[i].height, items[i].diam, &ObjTypes[items[i].type]));
+	}
+	return true;
+}
 
-	ResetQuadtree ();
-	if (nx > 0 && ny > 0) {
-		const CControl *ctrl = g_game.player->ctrl;
-		InitQuadtree (elevation, nx, ny, curr_course->size.x/(nx-1),
-		              - curr_course->size.y/(ny-1), ctrl->viewpos, param.course_detail_level);
+static void WritePackageObject (ofstream& file, const TVector3d& pt, ETR_DOUBLE height, ETR_DOUBLE diam, size_t type) {
+	TPackageObject obj;
+	memset (&obj, 0, sizeof(obj));
+	obj.x = pt.x;
+	obj.y = pt.y;
+	obj.z = pt.z;
+	obj.height = height;
+	obj.diam = diam;
+	obj.type = type;
+	file.write ((const char*)&obj, sizeof(obj));
+}
+
+static void PadPackage (ofstream& file, size_t ofs) {
+	static const char zeros[PACKAGE_ALIGN] = {0};
+	size_t pos = (size_t)file.tellp ();
+	if (ofs > pos) file.write (zeros, ofs - pos);
+}
+
+bool CCourse::SavePackage () const {
+	if (mirrored || package.IsOpen ()) return false;
+
+	TPackageHeader hdr;
+	FillPackageHeader (hdr, curr_course, TerrList.size(), ObjTypes.size());
+	if (!GetPackageStamps (hdr.stamps)) return false;
+	hdr.nx = nx;
+	hdr.ny = ny;
+	hdr.num_coll = CollArr.size();
+	hdr.num_items = NocollArr.size();
+	size_t num = nx * ny;
+	hdr.elevation_ofs = AlignPackage (sizeof(hdr));
+	hdr.nmls_ofs = AlignPackage (hdr.elevation_ofs + num * sizeof(ETR_DOUBLE));
+	hdr.terrain_ofs = AlignPackage (hdr.nmls_ofs + num * sizeof(TVector3d));
+	hdr.vnc_ofs = AlignPackage (hdr.terrain_ofs + num);
+	hdr.coll_ofs = AlignPackage (hdr.vnc_ofs + num * STRIDE_GL_ARRAY);
+	hdr.items_ofs = AlignPackage (hdr.coll_ofs + hdr.num_coll * sizeof(TPackageObject));
+	hdr.total_size = hdr.items_ofs + hdr.num_items * sizeof(TPackageObject);
+
+	string filename = CourseDir + SEP PACKAGE_FILE;
+	ofstream file (filename.c_str(), ios::out | ios::binary);
+	if (!file) {
+		Message ("could not write course package", filename);
+		return false;
+	}
+	file.write ((const char*)&hdr, sizeof(hdr));
+	PadPackage (file, hdr.elevation_ofs);
+	file.write ((const char*)elevation, num * sizeof(ETR_DOUBLE));
+	PadPackage (file, hdr.nmls_ofs);
+	file.write ((const char*)nmls, num * sizeof(TVector3d));
+	PadPackage (file, hdr.terrain_ofs);
+	file.write (terrain, num);
+	PadPackage (file, hdr.vnc_ofs);
+	file.write ((const char*)vnc_array, num * STRIDE_GL_ARRAY);
+	PadPackage (file, hdr.coll_ofs);
+	for (size_t i=0; i<CollArr.size(); i++)
+		WritePackageObject (file, CollArr[i].pt, CollArr[i].height, CollArr[i].diam, CollArr[i].tree_type);
+	PadPackage (file, hdr.items_ofs);
+	for (size_t i=0; i<NocollArr.size(); i++)
+		WritePackageObject (file, NocollArr[i].pt, NocollArr[i].height, NocollArr[i].diam, NocollArr[i].type - &ObjTypes[0]);
+	if (!file) {
+		Message ("could not write course package", filename);
+		return false;
+	}
+	return true;
+}
+
+// Writes the package of every course in courses.lst and compares the
+// load times of both paths.
+void CCourse::CompilePackages () {
+	ETR_DOUBLE png_total = 0, pak_total = 0;
+	for (size_t i=0; i<CourseList.size(); i++) {
+		TCourse* course = &CourseList[i];
+		ResetCourse ();
+		use_package = false;
+		CTimer timer;
+		bool ok = LoadCourse (course);
+		double png_ms = timer.Milliseconds ();
+		use_package = true;
+		if (!ok || !SavePackage ()) {
+			Message ("could not compile course", course->dir);
+			continue;
+		}
+
+		ResetCourse ();
+		timer.Start ();
+		LoadCourse (course);
+		double pak_ms = timer.Milliseconds ();
+		if (!package.IsOpen ()) Message ("course package not used", course->dir);
+
+		png_total += png_ms;
+		pak_total += pak_ms;
+		cout << course->dir << ": png " << png_ms << " ms, package " << pak_ms << " ms\n";
 	}
+	ResetCourse ();
+	cout << "all courses: png " << png_total << " ms, package " << pak_total << " ms\n";
+}
+
+// --------------------------------------------------------------------
+//				normals benchmark
+// --------------------------------------------------------------------
+
+// The straightforward version CalcNormals replaced, only kept as
+// reference for BenchmarkNormals.
+void CCourse::CalcNormalsReference (TVector3d *out) const {
+	for (int y=0; y<ny; y++) {
+		for (int x=0; x<nx; x++) {
+			TVector3d nml(0.0, 0.0, 0.0);
+			TVector3d p0 (XCD(x), ELEV(x,y), ZCD(y));
+
+			if ((x + y) % 2 == 0) {
+				if (x > 0 && y > 0) {
+					TVector3d p1 = NMLPOINT(x,  y-1);
+					TVector3d p2 = NMLPOINT(x-1,y-1);
+					TVector3d v1 = p1 - p0;
+					TVector3d v2 = p2 - p0;
+					TVector3d n = CrossProduct (v2, v1);
+
+					n.Norm();
+					nml += n;
+
+					p1 = NMLPOINT (x-1, y-1);
+					p2 = NMLPOINT (x-1, y);
+					v1 = p1 - p0;
+					v2 = p2 - p0;
+					n = CrossProduct (v2, v1);
+
+					n.Norm();
+					nml += n;
+				}
+				if (x > 0 && y < ny-1) {
+					TVector3d p1 = NMLPOINT(x-1,y);
+					TVector3d p2 = NMLPOINT(x-1,y+1);
+					TVector3d v1 = p1 - p0;
+					TVector3d v2 = p2 - p0;
+					TVector3d n = CrossProduct (v2, v1);
+
+					n.Norm();
+					nml += n;
+
+					p1 = NMLPOINT(x-1,y+1);
+					p2 = NMLPOINT(x  ,y+1);
+					v1 = p1 - p0;
+					v2 = p2 - p0;
+					n = CrossProduct (v2, v1);
+
+					n.Norm();
+					nml += n;
+				}
+				if (x < nx-1 && y > 0) {
+					TVector3d p1 = NMLPOINT(x+1,y);
+					TVector3d p2 = NMLPOINT(x+1,y-1);
+					TVector3d v1 = p1 - p0;
+					TVector3d v2 = p2 - p0;
+					TVector3d n = CrossProduct (v2, v1);
+
+					n.Norm();
+					nml += n;
+
+					p1 = NMLPOINT(x+1,y-1);
+					p2 = NMLPOINT(x  ,y-1);
+					v1 = p1 - p0;
+					v2 = p2 - p0;
+					n = CrossProduct (v2, v1);
+
+					n.Norm();
+					nml += n;
+				}
+				if (x < nx-1 && y < ny-1) {
+					TVector3d p1 = NMLPOINT(x+1,y);
+					TVector3d p2 = NMLPOINT(x+1,y+1);
+					TVector3d v1 = p1 - p0;
+					TVector3d v2 = p2 - p0;
+					TVector3d n = CrossProduct (v1, v2);
+
+					n.Norm();
+					nml += n;
+
+					p1 = NMLPOINT(x+1,y+1);
+					p2 = NMLPOINT(x  ,y+1);
+					v1 = p1 - p0;
+					v2 = p2 - p0;
+					n = CrossProduct (v1, v2);
+
+					n.Norm();
+					nml += n;
+				}
+			} else {
+				if (x > 0 && y > 0) {
+					TVector3d p1 = NMLPOINT(x,  y-1);
+					TVector3d p2 = NMLPOINT(x-1,y);
+					TVector3d v1 = p1 - p0;
+					TVector3d v2 = p2 - p0;
+					TVector3d n = CrossProduct (v2, v1);
+
+					n.Norm();
+					nml += n;
+				}
+				if (x > 0 && y < ny-1) {
+					TVector3d p1 = NMLPOINT(x-1,y);
+					TVector3d p2 = NMLPOINT(x  ,y+1);
+					TVector3d v1 = p1 - p0;
+					TVector3d v2 = p2 - p0;
+					TVector3d n = CrossProduct (v2, v1);
+
+					n.Norm();
+					nml += n;
+				}
+				if (x < nx-1 && y > 0) {
+					TVector3d p1 = NMLPOINT(x+1,y);
+					TVector3d p2 = NMLPOINT(x  ,y-1);
+					TVector3d v1 = p1 - p0;
+					TVector3d v2 = p2 - p0;
+					TVector3d n = CrossProduct (v2, v1);
+
+					n.Norm();
+					nml += n;
+				}
+				if (x < nx-1 && y < ny-1) {
+					TVector3d p1 = NMLPOINT(x+1,y);
+					TVector3d p2 = NMLPOINT(x  ,y+1);
+					TVector3d v1 = p1 - p0;
+					TVector3d v2 = p2 - p0;
+					TVector3d n = CrossProduct (v1, v2);
+
+					n.Norm();
+					nml += n;
+				}
+			}
+			nml.Norm();
+			out [x + nx * y] = nml;
+		}
+	}
+}
+
+#define NORMAL_PASSES 5
+
+void CCourse::BenchmarkNormals () {
+	double ref_total = 0, serial_total = 0, threaded_total = 0;
+	bool all_equal = true;
+	for (size_t i=0; i<CourseList.size(); i++) {
+		TCourse* course = &CourseList[i];
+		ResetCourse ();
+		use_package = false;
+		if (!LoadCourse (course)) continue;
+
+		vector<TVector3d> ref (nx * ny);
+		vector<TVector3d> result (nx * ny);
+		CTimer timer;
+		for (int pass = 0; pass < NORMAL_PASSES; pass++)
+			CalcNormalsReference (&ref[0]);
+		double ref_ms = timer.Milliseconds () / NORMAL_PASSES;
+
+		timer.Start ();
+		for (int pass = 0; pass < NORMAL_PASSES; pass++)
+			CalcNormals (&result[0], 1);
+		double serial_ms = timer.Milliseconds () / NORMAL_PASSES;
+		bool equal = memcmp (&ref[0], &result[0], ref.size() * sizeof(TVector3d)) == 0;
+
+		timer.Start ();
+		for (int pass = 0; pass < NORMAL_PASSES; pass++)
+			CalcNormals (&result[0], SDL_GetCPUCount ());
+		double threaded_ms = timer.Milliseconds () / NORMAL_PASSES;
+		equal = equal && memcmp (&ref[0], &result[0], ref.size() * sizeof(TVector3d)) == 0;
+		all_equal = all_equal && equal;
+
+		ref_total += ref_ms;
+		serial_total += serial_ms;
+		threaded_total += threaded_ms;
+		cout << course->dir << " (" << nx << "x" << ny << "): reference " << ref_ms
+		     << " ms, tables " << serial_ms << " ms, " << SDL_GetCPUCount () << " threads "
+		     << threaded_ms << " ms" << (equal ? "" : ", RESULTS DIFFER") << '\n';
+	}
+	ResetCourse ();
+	cout << "all courses: reference " << ref_total << " ms, tables " << serial_total
+	     << " ms, threaded " << threaded_total << " ms\n";
+	if (!all_equal) Message ("normals differ from the reference");
+}
+
+// --------------------------------------------------------------------
+//				mirror course
+// --------------------------------------------------------------------
+
+// The course arrays, the gl arrays and the quadtree always hold the
+// course as it is stored. A mirrored course is the same data seen
+// through x -> size.x - x: the queries below flip x on the way in
+// (and normals on the way out), RenderCourse draws the terrain with a
+// mirrored model matrix. Only the object positions and the start point
+// are stored in world coordinates, their heights don't change.
+
+void CCourse::MirrorCourseData () {
+	for (size_t i=0; i<CollArr.size(); i++)
+		CollArr[i].pt.x = curr_course->size.x - CollArr[i].pt.x;
+	for (size_t i=0; i<NocollArr.size(); i++)
+		NocollArr[i].pt.x = curr_course->size.x - NocollArr[i].pt.x;
 
 	start_pt.x = curr_course->size.x - start_pt.x;
+	mirrored = !mirrored;
 }
 
 void CCourse::MirrorCourse () {
@@ -880,6 +1661,11 @@ void CCourse::MirrorCourse () {
 	init_track_marks ();
 }
 
+TVector3d CCourse::ToCourseData (const TVector3d& pt) const {
+	if (!mirrored) return pt;
+	return TVector3d (curr_course->size.x - pt.x, pt.y, pt.z);
+}
+
 // ********************************************************************
 //				from phys_sim:
 // ********************************************************************
@@ -960,7 +1746,7 @@ void CCourse::FindBarycentricCoords (ETR_DOUBLE x, ETR_DOUBLE z, TVector2i *idx0
                        ELEV((_x),(_y)), -(ETR_DOUBLE)(_y)/(ny-1.)*curr_course->size.y )
 
 TVector3d CCourse::FindCourseNormal (ETR_DOUBLE x, ETR_DOUBLE z) const {
-
+	x = DataX (x);
 	ETR_DOUBLE *elevation = Course.elevation;
 	int x0, x1, y0, y1;
 	GetIndicesForPoint (x, z, &x0, &y0, &x1, &y1);
@@ -990,6 +1776,7 @@ TVector3d CCourse::FindCourseNormal (ETR_DOUBLE x, ETR_DOUBLE z) const {
 	TVector3d interp_nml = interp_factor * tri_nml + (1.-interp_factor) * smooth_nml;
 	interp_nml.Norm();
 
+	if (mirrored) interp_nml.x = -interp_nml.x;
 	return interp_nml;
 }
 
@@ -997,7 +1784,21 @@ ETR_DOUBLE CCourse::FindYCoord (ETR_DOUBLE x, ETR_DOUBLE z) const {
 	static ETR_DOUBLE last_x, last_z, last_y;
 	static bool cache_full = false;
 
-	if (cache_full && last_x == x && last_z == z) return last_y;
+	ETR_DOUBLE data_x = DataX (x);
+	if (cache_full && last_x == data_x && last_z == z) return last_y;
+	ETR_DOUBLE ycoord = CalcYCoord (x, z);
+
+	last_x = data_x;
+	last_z = z;
+	last_y = ycoord;
+	cache_full = true;
+
+	return ycoord;
+}
+
+// FindYCoord without its cache, for the loader thread
+ETR_DOUBLE CCourse::CalcYCoord (ETR_DOUBLE x, ETR_DOUBLE z) const {
+	x = DataX (x);
 	ETR_DOUBLE *elevation = Course.elevation;
 
 	TVector2i idx0, idx1, idx2;
@@ -1008,20 +1809,13 @@ ETR_DOUBLE CCourse::FindYCoord (ETR_DOUBLE x, ETR_DOUBLE z) const {
 	TVector3d p1 = COURSE_VERTX (idx1.x, idx1.y);
 	TVector3d p2 = COURSE_VERTX (idx2.x, idx2.y);
 
-	ETR_DOUBLE ycoord = u * p0.y + v * p1.y +  (1. - u - v) * p2.y;
-
-	last_x = x;
-	last_z = z;
-	last_y = ycoord;
-	cache_full = true;
-
-	return ycoord;
+	return u * p0.y + v * p1.y +  (1. - u - v) * p2.y;
 }
 
 void CCourse::GetSurfaceType (ETR_DOUBLE x, ETR_DOUBLE z, ETR_DOUBLE weights[]) const {
 	TVector2i idx0, idx1, idx2;
 	ETR_DOUBLE u, v;
-	FindBarycentricCoords (x, z, &idx0, &idx1, &idx2, &u, &v);
+	FindBarycentricCoords (DataX (x), z, &idx0, &idx1, &idx2, &u, &v);
 
 	char *terrain = Course.terrain;
 	for (size_t i=0; i<Course.TerrList.size(); i++) {
@@ -1035,7 +1829,7 @@ void CCourse::GetSurfaceType (ETR_DOUBLE x, ETR_DOUBLE z, ETR_DOUBLE weights[])
 int CCourse::GetTerrainIdx (ETR_DOUBLE x, ETR_DOUBLE z, ETR_DOUBLE level) const {
 	TVector2i idx0, idx1, idx2;
 	ETR_DOUBLE u, v;
-	FindBarycentricCoords (x, z, &idx0, &idx1, &idx2, &u, &v);
+	FindBarycentricCoords (DataX (x), z, &idx0, &idx1, &idx2, &u, &v);
 	char *terrain = Course.terrain;
 
 	for (size_t i=0; i<Course.TerrList.size(); i++) {
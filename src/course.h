@@ -20,8 +20,10 @@ GNU General Public License for more details.
 
 #include "bh.h"
 #include "mathlib.h"
+#include <SDL2/SDL.h>
 #include <vector>
 #include <map>
+#include <list>
 
 #define FLOATVAL(i) (*(GLfloat*)(vnc_array+idx+(i)*sizeof(GLfloat)))
 #ifdef USE_GLES1
@@ -44,8 +46,10 @@ GNU General Public License for more details.
 #define MAX_TERR_TYPES 64
 #define MAX_OBJECT_TYPES 128
 #define MAX_DESCRIPTION_LINES 8
+#define MAX_PREVIEWS 8		// preview textures kept loaded
 
 class TTexture;
+class CImage;
 
 struct TTerrType {
 	string textureFile;
@@ -103,9 +107,13 @@ struct TCourse {
 	string name;
 	string dir;
 	string author;
+	string description;		// wrapped into desc on first display
 	string desc[MAX_DESCRIPTION_LINES];
 	size_t num_lines;
-	TTexture* preview;
+	bool wrapped;
+	TTexture* preview;		// loaded on demand, see CCourse::GetPreview
+	bool no_preview;
+	Uint32 preview_used;
 	TVector2d size;
 	TVector2d play_size;
 	ETR_DOUBLE angle;
@@ -118,7 +126,29 @@ struct TCourse {
 };
 
 
+class CSPLine;
+class quadsquare;
+
+// A loaded course that is not the current one, see CCourse::StashCourse.
+// The arrays point into the package if the course came from one.
+struct TCourseState {
+	const TCourse* course;
+	int			nx, ny;
+	TVector2d	start_pt;
+	bool		mirrored;
+	ETR_DOUBLE*	elevation;
+	char*		terrain;
+	TVector3d*	nmls;
+	GLubyte*	vnc_array;
+	CMappedFile	package;
+	vector<TCollidable>	CollArr;
+	vector<TItem>		NocollArr;
+	quadsquare*	quadtree;
+	size_t		bytes;
+};
+
 class CCourse {
+	friend class CItemListVisitor;
 private:
 	const TCourse* curr_course;
 	map<string, size_t> CourseIndex;
@@ -130,18 +160,66 @@ private:
 	TVector2d	start_pt;
 	int			base_height_value;
 	bool		mirrored;
+	CMappedFile	package;	// compiled course, the arrays point into it
+	bool		use_package;
+
+	// loading, see StartLoading
+	TCourse*	load_course;
+	SDL_Thread*	loader;
+	bool		load_ok;
+	bool		load_pending;	// started, FinishLoading not yet done
+	bool		load_reload;
+	bool		load_mirror;
+	bool		load_cached;
+	bool		load_treemap;	// g_game.force_treemap when the load was started
+	SDL_atomic_t load_progress;
+	SDL_atomic_t load_done;
 
 	void		FreeTerrainTextures ();
 	void		FreeObjectTextures ();
-	void		CalcNormals ();
+	void		CalcNormals (TVector3d *out, int numthreads = 0) const;
+	void		CalcNormalsReference (TVector3d *out) const;
 	void		MakeCourseNormals ();
 	bool		LoadElevMap ();
 	void		LoadItemList ();
+	void		AddItem (const CSPLine& line);
 	bool		LoadAndConvertObjectMap ();
 	bool		LoadTerrainMap ();
 	int			GetTerrain (unsigned char pixel[]) const;
+	void		LoadObjectTexture (size_t type);
+	void		BindGlArrays ();
+
+	bool		LoadCourseFiles ();
+	void		LoadCourseData ();
+	void		LoadCourseTextures ();
+	static int	LoadThread (void *course);
+	void		WaitLoader ();
+
+	bool		GetPackageStamps (Sint64 stamps[]) const;
+	bool		LoadPackage ();
+	bool		SavePackage () const;
 
 	void		MirrorCourseData ();
+
+	// course list previews, decoded one at a time on a thread
+	vector<size_t> preview_queue;
+	size_t		preview_idx;
+	CImage*		preview_image;
+	SDL_Thread*	preview_loader;
+	SDL_atomic_t preview_done;
+	bool		preview_ok;
+	static int	PreviewThread (void *course);
+	void		UpdatePreviews ();
+	void		FreePreviews ();
+	bool		LoadCourseIndex (map<string, string>& index) const;
+	void		SaveCourseIndex (const map<string, string>& index) const;
+
+	list<TCourseState*> cache;	// most recently used first
+	void		StashCourse ();
+	bool		RestoreCourse (TCourse* course);
+	void		TrimCache (size_t budget);
+	static void	FreeCourseState (TCourseState* state);
+	ETR_DOUBLE	DataX (ETR_DOUBLE x) const { return mirrored ? curr_course->size.x - x : x; }
 public:
 	CCourse ();
 	~CCourse();
@@ -163,12 +241,22 @@ public:
 	size_t GetCourseIdx(const TCourse* course) const;
 	bool LoadCourseList ();
 	void FreeCourseList ();
+	TTexture* GetPreview (size_t idx);
+	void WrapDescription (size_t idx);
 	bool LoadCourse(TCourse* course);
+	void StartLoading (TCourse* course, bool threaded = true);
+	bool LoadingDone () { return SDL_AtomicGet (&load_done) != 0; }
+	int LoadingProgress () { return SDL_AtomicGet (&load_progress); }
+	bool FinishLoading ();
+	void Prefetch (TCourse* course);
+	void FreeCourseCache () { TrimCache (0); }
 	bool LoadTerrainTypes ();
 	bool LoadObjectTypes ();
 	void MakeStandardPolyhedrons ();
 	GLubyte* GetGLArrays() const { return vnc_array; }
 	void FillGlArrays();
+	void CompilePackages ();
+	void BenchmarkNormals ();
 
 	const TVector2d& GetDimensions() const { return curr_course->size; }
 	const TVector2d& GetPlayDimensions() const { return curr_course->play_size; }
@@ -180,12 +268,16 @@ public:
 	const TVector2d& GetStartPoint () const { return start_pt; }
 	const TPolyhedron& GetPoly (size_t type) const;
 	void MirrorCourse ();
+	bool IsMirrored () const { return mirrored; }
+	TVector3d ToCourseData (const TVector3d& pt) const;
 
+	// these two work on the stored (unmirrored) course
 	void GetIndicesForPoint (ETR_DOUBLE x, ETR_DOUBLE z, int *x0, int *y0, int *x1, int *y1) const;
 	void FindBarycentricCoords (ETR_DOUBLE x, ETR_DOUBLE z,
 	                            TVector2i *idx0, TVector2i *idx1, TVector2i *idx2, ETR_DOUBLE *u, ETR_DOUBLE *v) const;
 	TVector3d FindCourseNormal (ETR_DOUBLE x, ETR_DOUBLE z) const;
 	ETR_DOUBLE FindYCoord (ETR_DOUBLE x, ETR_DOUBLE z) const;
+	ETR_DOUBLE CalcYCoord (ETR_DOUBLE x, ETR_DOUBLE z) const;
 	void GetSurfaceType (ETR_DOUBLE x, ETR_DOUBLE z, ETR_DOUBLE weights[]) const;
 	int GetTerrainIdx (ETR_DOUBLE x, ETR_DOUBLE z, ETR_DOUBLE level) const;
 	TPlane GetLocalCoursePlane (TVector3d pt) const;
@@ -50,8 +50,21 @@ void RenderCourse () {
 	glTexEnvf (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 	set_material (colWhite, colBlack, 1.0);
 	const CControl *ctrl = g_game.player->ctrl;
-	UpdateQuadtree (ctrl->viewpos, param.course_detail_level);
-	RenderQuadtree ();
+	UpdateQuadtree (Course.ToCourseData (ctrl->viewpos), param.course_detail_level);
+
+	// mirrored courses are drawn from the same arrays, the model matrix
+	// does the mirroring and turns the triangle winding around
+	if (Course.IsMirrored ()) {
+		glPushMatrix ();
+		glTranslatef (Course.GetDimensions().x, 0, 0);
+		glScalef (-1, 1, 1);
+		glFrontFace (GL_CW);
+		RenderQuadtree ();
+		glFrontFace (GL_CCW);
+		glPopMatrix ();
+	} else {
+		RenderQuadtree ();
+	}
 }
 
 // --------------------------------------------------------------------
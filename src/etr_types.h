@@ -46,6 +46,22 @@ enum TToolMode {
 	LEARN,
 };
 
+// what main() does, set from the command line in InitGame
+enum TRunMode {
+	RUN_GAME,
+	RUN_CHAR_TOOL,			// --char
+	RUN_OGL_TEST,			// 9
+	RUN_BENCHMARK,			// --benchmark, --replay
+	RUN_BENCHMARK_PARSE,	// --benchmark-parse
+	RUN_BENCHMARK_NORMALS,	// --benchmark-normals
+	RUN_BENCHMARK_POSE,		// --benchmark-pose
+	RUN_BENCHMARK_AFFINE,	// --benchmark-affine
+	RUN_BENCHMARK_INSTANCES,	// --benchmark-instances
+	RUN_BENCHMARK_SIMD,		// --benchmark-simd
+	RUN_COMPILE_COURSES,	// --compile-courses
+	RUN_COMPILE_CHARS		// --compile-chars
+};
+
 enum TGameType {
 	PRACTICING,
 	CUPRACING
@@ -71,7 +87,7 @@ struct TGameData {
 	bool force_treemap;
 	int treesize;
 	int treevar;
-	int argument;
+	TRunMode argument;
 	bool finish;
 	bool use_keyframe;
 	ETR_DOUBLE finish_brake;
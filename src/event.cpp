@@ -181,6 +181,7 @@ void CEvent::Loop () {
 
 	check_gl_error();
 	ScopedRenderMode rm(GUI);
+	if (curr_race < ecup->races.size()) Course.Prefetch (ecup->races[curr_race]->course);
 	Music.Update ();
 	ClearRenderContext ();
 	SetupGuiDisplay ();
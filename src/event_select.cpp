@@ -28,6 +28,7 @@ GNU General Public License for more details.
 #include "textures.h"
 #include "game_ctrl.h"
 #include "translation.h"
+#include "course.h"
 #include "event.h"
 #include "game_type_select.h"
 #include "winsys.h"
@@ -120,6 +121,10 @@ void CEventSelect::Loop () {
 
 	check_gl_error();
 	ScopedRenderMode rm(GUI);
+	if (Events.IsUnlocked (event->GetValue(), cup->GetValue())) {
+		const TCup *selected = EventList[event->GetValue()].cups[cup->GetValue()];
+		if (!selected->races.empty()) Course.Prefetch (selected->races[0]->course);
+	}
 	Music.Update ();
 	ClearRenderContext ();
 	SetupGuiDisplay ();
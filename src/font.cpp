@@ -108,9 +108,18 @@ void CFont::Clear () {
 			delete it->second;
 			it++;
 		}
+		delete fonts[i]->atlas;
 	}
 	fonts.clear();
 	fontindex.clear();
+	ClearLayouts();
+}
+
+void CFont::ClearLayouts () {
+	for (map<TTextKey, TCachedLayout>::iterator it = layouts.begin(); it != layouts.end(); ++it)
+		delete it->second.layout;
+	layouts.clear();
+	layout_use.clear();
 }
 
 // --------------------------------------------------------------------
@@ -142,6 +151,12 @@ wstring CFont::UnicodeStr (const char *s) {
 	return res;
 }
 
+// FTFont::FaceSize takes whole pixel sizes, so all sizes with the same
+// integer part share one FTFont instead of rasterizing the font again
+static float FaceSizeKey (float size) {
+	return (float)(unsigned int)size;
+}
+
 // --------------------------------------------------------------------
 //					public
 // --------------------------------------------------------------------
@@ -155,12 +170,19 @@ int CFont::LoadFont (const string& name, const char *path,float size) {
 		newfont = new fontinfo;
 		newfont->fontpath=path;
 		newfont->fontname=name;
+#ifdef USE_GLES1
+		newfont->atlas = new FTGlyphAtlas;
+#else
+		newfont->atlas = NULL;
+#endif
 		fonts.push_back(newfont);
 		fontindex[name] = fonts.size()-1;
 	}
 	int pos = GetFontIdx(name);
+	ClearLayouts();
+	size = FaceSizeKey(size);
 #ifdef USE_GLES1
-	newfont->fonts[size] = new FTGLTextureFont (path);
+	newfont->fonts[size] = new FTGLTextureFont (path, newfont->atlas);
 #else
 	newfont->fonts[size] = new FTGLPixmapFont (path);
 #endif
@@ -198,10 +220,51 @@ bool CFont::LoadFontlist () {
 }
 FTFont* CFont::GetFont(const size_t findex,const float size)
 {
-	if (fonts[findex]->fonts.count(size) == 0)
-		LoadFont(fonts[findex]->fontname, fonts[findex]->fontpath.c_str(),size);
-	return fonts[findex]->fonts[size];
+	float key = FaceSizeKey(size);
+	if (fonts[findex]->fonts.count(key) == 0)
+		LoadFont(fonts[findex]->fontname, fonts[findex]->fontpath.c_str(),key);
+	return fonts[findex]->fonts[key];
+}
+// The menus and the hud draw the same strings in every frame, so the
+// glyph quads of a string are laid out once and kept. When the cache
+// is full the least recently used layout is dropped, so strings that
+// change in every frame (e.g. the race time) only replace each other.
+const FTTextLayout* CFont::GetLayout (const wstring& text, size_t font, float size) {
+	TTextKey key(font, size, text);
+	map<TTextKey, TCachedLayout>::iterator it = layouts.find(key);
+	if (it != layouts.end()) {
+		layout_use.splice(layout_use.begin(), layout_use, it->second.use);
+		// the glyph atlas has changed since the layout was made
+		FTTextLayout* layout = it->second.layout;
+		if (layout->Generation() != FTGlyphAtlas::Generation())
+			GetFont(font, size)->Layout(text.c_str(), *layout);
+		return layout;
+	}
+
+	if (layouts.size() >= MAX_TEXT_LAYOUTS) {
+		map<TTextKey, TCachedLayout>::iterator oldest = layouts.find(layout_use.back());
+		delete oldest->second.layout;
+		layouts.erase(oldest);
+		layout_use.pop_back();
+	}
+	TCachedLayout& entry = layouts[key];
+	entry.layout = new FTTextLayout;
+	entry.use = layout_use.insert(layout_use.begin(), key);
+	GetFont(font, size)->Layout(text.c_str(), *entry.layout);
+	return entry.layout;
+}
+
+const FTTextLayout* CFont::GetLayout (const wchar_t* text, size_t font, float size) {
+	return GetLayout(wstring(text), font, size);
+}
+
+const FTTextLayout* CFont::GetLayout (const char* text, size_t font, float size) {
+	wstring res;
+	for (const unsigned char* c = (const unsigned char*)text; *c; ++c)
+		res += (wchar_t)*c;
+	return GetLayout(res, font, size);
 }
+
 size_t CFont::GetFontIdx (const string &name) const {
 	return fontindex.at(name);
 }
@@ -250,12 +313,12 @@ void CFont::DrawText(float x, float y, const T* text, size_t font, float size) {
 	if (font >= fonts.size()) return;
 
 	glPushMatrix();
-	FTFont* cf = GetFont(font,size);
+	const FTTextLayout* layout = GetLayout(text, font, size);
 	glColor(curr_col);
 
 	float left;
 	if (x >= 0) left = x;
-	else left = (Winsys.resolution.width - GetTextWidth(text)) / 2;
+	else left = (Winsys.resolution.width - layout->Width()) / 2;
 	if (left < 0) left = 0;
 
 #ifdef USE_GLES1
@@ -271,7 +334,11 @@ void CFont::DrawText(float x, float y, const T* text, size_t font, float size) {
 		glRasterPos2i ((int)left, (int)y);
 	}
 #endif
-	cf->Render (text);
+#ifdef USE_GLES1
+	layout->Render();
+#else
+	GetFont(font,size)->Render (text);
+#endif
 	glPopMatrix();
 }
 template void CFont::DrawText<char>(float x, float y, const char* text, size_t font, float size); // instanciate
@@ -391,6 +458,10 @@ float CFont::CenterX (const char *text) {
 	return (Winsys.resolution.width - GetTextWidth (text)) / 2.0;
 }
 
+void CFont::NewFrame () {
+	FTGlyphAtlas::NewFrame();
+}
+
 vector<string> CFont::MakeLineList (const char *source, float width) {
 	vector<string> wordlist;
 	MakeWordList(wordlist, source);
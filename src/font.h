@@ -21,6 +21,7 @@ GNU General Public License for more details.
 
 #include "bh.h"
 #include <vector>
+#include <list>
 #include <map>
 
 // --------------------------------------------------------------------
@@ -28,19 +29,43 @@ GNU General Public License for more details.
 // --------------------------------------------------------------------
 
 #define MAX_FONTS 36
+#define MAX_TEXT_LAYOUTS 256
 
 class FTFont;
+class FTTextLayout;
+class FTGlyphAtlas;
 
 struct fontinfo {
 	string fontpath;
 	string fontname;
 	map<float,FTFont*> fonts;
+	FTGlyphAtlas* atlas;		// shared by all sizes
+};
+
+// key of a cached, pre-laid-out string
+struct TTextKey {
+	size_t font;
+	float size;
+	wstring text;
+	TTextKey(size_t f, float s, const wstring& t) : font(f), size(s), text(t) {}
+	bool operator<(const TTextKey& k) const {
+		if (font != k.font) return font < k.font;
+		if (size != k.size) return size < k.size;
+		return text < k.text;
+	}
+};
+
+struct TCachedLayout {
+	FTTextLayout* layout;
+	list<TTextKey>::iterator use;	// position in CFont::layout_use
 };
 
 class CFont {
 private:
 	vector<fontinfo*> fonts;
 	map<string, size_t> fontindex;
+	map<TTextKey, TCachedLayout> layouts;
+	list<TTextKey> layout_use;		// most recently used first
 	Orientation forientation;
 
 	int    curr_font;
@@ -54,6 +79,10 @@ private:
 	void GetTextSize(const char *text, float &x, float &y, size_t font, float size);
 	void GetTextSize(const wchar_t *text, float &x, float &y, size_t font, float size);
 	FTFont* GetFont(const size_t findex,const float size);
+	const FTTextLayout* GetLayout(const wstring& text, size_t font, float size);
+	const FTTextLayout* GetLayout(const char* text, size_t font, float size);
+	const FTTextLayout* GetLayout(const wchar_t* text, size_t font, float size);
+	void ClearLayouts();
 public:
 	CFont ();
 	~CFont ();
@@ -97,6 +126,7 @@ public:
 	float GetTextWidth (const wchar_t *text, const string &fontname, float size);
 
 	float CenterX        (const char *text);
+	void  NewFrame       ();
 	void  SetOrientation (Orientation orientation) { forientation = orientation; }
 
 	vector<string> MakeLineList (const char *source, float width);
@@ -190,6 +190,34 @@ void FTFont::Render (const wchar_t* string) {
 	}
 }
 
+// If the glyph atlas grows or evicts glyphs while the layout is built,
+// the texture coordinates of the glyphs placed before are stale. The
+// second pass finds all glyphs resident.
+void FTFont::Layout (const wchar_t* string, FTTextLayout& layout) {
+	for (int pass = 0; pass < 2; pass++) {
+		unsigned int generation = FTGlyphAtlas::Generation();
+		layout.Clear();
+		layout.SetGeneration (generation);
+		FTBBox totalBBox;
+		FTPoint penPosition;
+		bool first = true;
+
+		for (const wchar_t* c = string; *c; ++c) {
+			if (!CheckGlyph (*c)) continue;
+			FTBBox tempBBox = glyphList->BBox (*c);
+			tempBBox.Move (penPosition);
+			if (first) totalBBox = tempBBox;
+			else totalBBox += tempBBox;
+			first = false;
+
+			glyphList->Layout (*c, penPosition, layout);
+			penPosition.X (penPosition.X() + glyphList->Advance (*c, *(c + 1)));
+		}
+		layout.SetBBox (totalBBox);
+		if (generation == FTGlyphAtlas::Generation()) break;
+	}
+}
+
 bool FTFont::CheckGlyph (const unsigned int characterCode) {
 	if (NULL == glyphList->Glyph (characterCode)) {
 		unsigned int glyphIndex = glyphList->FontIndex (characterCode);
@@ -509,64 +537,290 @@ FTPoint FTGlyphContainer::Render (const unsigned int characterCode,
 	return kernAdvance;
 }
 
+void FTGlyphContainer::Layout (const unsigned int characterCode,
+								const FTPoint& penPosition, FTTextLayout& layout) {
+	glyphs[charMap->GlyphListIndex (characterCode)]->Layout (penPosition, layout);
+}
+
 // --------------------------------------------------------------------
-//					FTTextureGlyph
+//					FTGlyphAtlas
 // --------------------------------------------------------------------
 
-GLint FTTextureGlyph::activeTextureID = 0;
+#define ATLAS_WIDTH 1024
+#define ATLAS_INIT_HEIGHT 128
+#define ATLAS_MAX_HEIGHT 1024
+#define ATLAS_PADDING 2
 
-FTTextureGlyph::FTTextureGlyph (FT_GlyphSlot glyph, int id, int xOffset,
-								int yOffset, GLsizei width, GLsizei height)
-	: FTGlyph (glyph), destWidth(0), destHeight(0), glTextureID(id) {
-	err = FT_Render_Glyph (glyph, FT_RENDER_MODE_NORMAL);
-	if (err || glyph->format != ft_glyph_format_bitmap) return;
-	
-	FT_Bitmap bitmap = glyph->bitmap;
-	destWidth  = bitmap.width;
-	destHeight = bitmap.rows;
-	
-	if (destWidth && destHeight) {
-#ifndef USE_GLES1
-		glPushClientAttrib (GL_CLIENT_PIXEL_STORE_BIT);
-		glPixelStorei (GL_UNPACK_LSB_FIRST, GL_FALSE);
-		glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+GLuint FTGlyphAtlas::activeTextureID = 0;
+unsigned int FTGlyphAtlas::frame = 0;
+unsigned int FTGlyphAtlas::generation = 0;
+FTAtlasStats FTGlyphAtlas::stats;
+
+FTGlyphAtlas::FTGlyphAtlas()
+	: textureID(0), width(0), height(0), maxHeight(0), pixels(0) {}
+
+FTGlyphAtlas::~FTGlyphAtlas() {
+	if (textureID) {
+		glDeleteTextures (1, &textureID);
+		if (activeTextureID == textureID) activeTextureID = 0;
+		stats.bytes -= width * height;
+	}
+	delete [] pixels;
+}
+
+void FTGlyphAtlas::BindTexture (GLuint id) {
+	if (activeTextureID != id) {
+		glBindTexture (GL_TEXTURE_2D, id);
+		activeTextureID = id;
+		stats.binds++;
+	}
+}
+
+// For Create, Grow and Insert. Other textures can be bound before the
+// next text is drawn, so the binding is not remembered.
+void FTGlyphAtlas::BindForUpload () const {
+	glBindTexture (GL_TEXTURE_2D, textureID);
+	activeTextureID = 0;
+}
+
+void FTGlyphAtlas::NewFrame() {
+	frame++;
+	stats.lastFrameBinds = stats.binds;
+	stats.binds = 0;
+}
+
+bool FTGlyphAtlas::CreateTexture() {
+	GLint maxTexSize = 0;
+	glGetIntegerv (GL_MAX_TEXTURE_SIZE, &maxTexSize);
+	if (maxTexSize <= 0) return false;
+
+	width = min (ATLAS_WIDTH, (int)maxTexSize);
+	height = min (ATLAS_INIT_HEIGHT, (int)maxTexSize);
+	maxHeight = min (ATLAS_MAX_HEIGHT, (int)maxTexSize);
+	pixels = new unsigned char[width * height];
+	memset (pixels, 0, width * height);
+
+	glGenTextures (1, &textureID);
+	BindForUpload ();
+#ifdef USE_GLES1
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+#else
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 #endif
-		glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
-		
-		glBindTexture (GL_TEXTURE_2D, glTextureID);
-		glTexSubImage2D (GL_TEXTURE_2D, 0, xOffset, yOffset,
-						 destWidth, destHeight, GL_ALPHA, GL_UNSIGNED_BYTE, bitmap.buffer);
-		
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexImage2D (GL_TEXTURE_2D, 0, GL_ALPHA, width, height, 0,
+				  GL_ALPHA, GL_UNSIGNED_BYTE, pixels);
+	stats.bytes += width * height;
+	return true;
+}
+
+// The texture coordinates depend on the height, so the texture is
+// uploaded completely from the local copy and all layouts become stale.
+bool FTGlyphAtlas::Grow (int minHeight) {
+	GLsizei newHeight = height;
+	while (newHeight < minHeight && newHeight < maxHeight) newHeight *= 2;
+	if (newHeight < minHeight) return false;
+
+	unsigned char* newPixels = new unsigned char[width * newHeight];
+	memcpy (newPixels, pixels, width * height);
+	memset (newPixels + width * height, 0, width * (newHeight - height));
+	delete [] pixels;
+	pixels = newPixels;
+	stats.bytes += width * (newHeight - height);
+	height = newHeight;
+
+	BindForUpload ();
+	glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D (GL_TEXTURE_2D, 0, GL_ALPHA, width, height, 0,
+				  GL_ALPHA, GL_UNSIGNED_BYTE, pixels);
+	generation++;
+	return true;
+}
+
+void FTGlyphAtlas::Upload (int y, int rows) {
+	BindForUpload ();
+	glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D (GL_TEXTURE_2D, 0, 0, y, width, rows,
+					 GL_ALPHA, GL_UNSIGNED_BYTE, pixels + y * width);
+}
+
+int FTGlyphAtlas::NewShelf (int h) {
+	int top = ATLAS_PADDING;
+	for (size_t i = 0; i < shelves.size(); i++)
+		top = max (top, shelves[i].y + shelves[i].height + ATLAS_PADDING);
+	if (top + h + ATLAS_PADDING > height && !Grow (top + h + ATLAS_PADDING)) return -1;
+
+	Shelf shelf;
+	shelf.y = top;
+	shelf.height = h;
+	shelf.x = ATLAS_PADDING;
+	shelf.serial = 0;
+	shelf.lastUse = frame;
+	shelves.push_back (shelf);
+	return (int)shelves.size() - 1;
+}
+
+// Evicts the least recently used run of adjacent shelves that is high
+// enough for h and merges it into the first shelf of the run; the other
+// shelves keep their index but get height 0. Shelves used in the current
+// frame are never evicted, the glyphs of a layout that is just being
+// built must stay valid.
+int FTGlyphAtlas::EvictShelf (int h) {
+	int first = -1, last = -1;
+	unsigned int firstAge = 0;
+	for (size_t i = 0; i < shelves.size(); i++) {
+		unsigned int age = 0;
+		for (size_t j = i; j < shelves.size() && shelves[j].lastUse != frame; j++) {
+			age = max (age, shelves[j].lastUse);
+			if (shelves[j].y + shelves[j].height - shelves[i].y < h) continue;
+			if (first < 0 || age < firstAge) {
+				first = (int)i;
+				last = (int)j;
+				firstAge = age;
+			}
+			break;
+		}
+	}
+	if (first < 0) return -1;
+
+	for (int i = first; i <= last; i++) {
+		Shelf& s = shelves[i];
+		if (s.height > 0) stats.evictions++;
+		s.serial++;
+		if (i > first) {
+			s.height = 0;
+			s.x = width;
+		}
+	}
+	Shelf& s = shelves[first];
+	s.height = shelves[last].y + shelves[last].height - s.y;
+	s.x = ATLAS_PADDING;
+	memset (pixels + s.y * width, 0, width * s.height);
+	Upload (s.y, s.height);
+	generation++;
+	return first;
+}
+
+bool FTGlyphAtlas::Insert (const FT_Bitmap& bitmap, FTAtlasSlot& slot) {
+	int w = bitmap.width;
+	int h = bitmap.rows;
+	if (!textureID && !CreateTexture()) return false;
+	if (w + 2 * ATLAS_PADDING > width) return false;
+
+	// best fitting shelf with enough room, shelves much higher than
+	// the glyph are left for larger glyphs
+	int found = -1;
+	for (size_t i = 0; i < shelves.size(); i++) {
+		const Shelf& s = shelves[i];
+		if (s.height < h || s.height > h + h / 4 + 2) continue;
+		if (s.x + w + ATLAS_PADDING > width) continue;
+		if (found < 0 || s.height < shelves[found].height) found = (int)i;
+	}
+	if (found < 0) found = NewShelf (h);
+	if (found < 0) found = EvictShelf (h);
+	if (found < 0) {
+		generation++;	// the caller's layout is incomplete, rebuild it next time
+		return false;
+	}
+
+	Shelf& s = shelves[found];
+	slot.shelf = found;
+	slot.serial = s.serial;
+	slot.x = s.x;
+	slot.y = s.y;
+	slot.w = w;
+	slot.h = h;
+	s.x += w + ATLAS_PADDING;
+	s.lastUse = frame;
+
+	for (int row = 0; row < h; row++)
+		memcpy (pixels + (slot.y + row) * width + slot.x, bitmap.buffer + row * bitmap.pitch, w);
+
 #ifndef USE_GLES1
-		glPopClientAttrib();
+	glPushClientAttrib (GL_CLIENT_PIXEL_STORE_BIT);
+	glPixelStorei (GL_UNPACK_LSB_FIRST, GL_FALSE);
+	glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
 #endif
+	glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+	BindForUpload ();
+	if (bitmap.pitch == w) {
+		glTexSubImage2D (GL_TEXTURE_2D, 0, slot.x, slot.y, w, h,
+						 GL_ALPHA, GL_UNSIGNED_BYTE, bitmap.buffer);
+	} else {
+		Upload (slot.y, h);
 	}
+#ifndef USE_GLES1
+	glPopClientAttrib();
+#endif
+	stats.rasterizations++;
+	return true;
+}
+
+bool FTGlyphAtlas::Touch (const FTAtlasSlot& slot) {
+	if (slot.shelf < 0 || slot.shelf >= (int)shelves.size()) return false;
+	Shelf& s = shelves[slot.shelf];
+	if (s.serial != slot.serial) return false;
+	s.lastUse = frame;
+	return true;
+}
+
+// --------------------------------------------------------------------
+//					FTTextureGlyph
+// --------------------------------------------------------------------
 
-	uv[0].X (static_cast<float>(xOffset) / static_cast<float>(width));
-	uv[0].Y (static_cast<float>(yOffset) / static_cast<float>(height));
-	uv[1].X (static_cast<float> (xOffset + destWidth) / static_cast<float>(width));
-	uv[1].Y (static_cast<float> (yOffset + destHeight) / static_cast<float>(height));
+FTTextureGlyph::FTTextureGlyph (FT_GlyphSlot glyph, FTFace* f,
+								unsigned int index, FTGlyphAtlas* a)
+	: FTGlyph (glyph), destWidth(0), destHeight(0), face(f), glyphIndex(index), atlas(a) {
+	Rasterize (glyph);
+}
+
+FTTextureGlyph::~FTTextureGlyph() {}
 
+bool FTTextureGlyph::Rasterize (FT_GlyphSlot glyph) {
+	err = FT_Render_Glyph (glyph, FT_RENDER_MODE_NORMAL);
+	if (err || glyph->format != ft_glyph_format_bitmap) return false;
+
+	destWidth  = glyph->bitmap.width;
+	destHeight = glyph->bitmap.rows;
 	pos.X (glyph->bitmap_left);
 	pos.Y (glyph->bitmap_top);
+
+	if (!destWidth || !destHeight) return false;
+	return atlas->Insert (glyph->bitmap, slot);
 }
 
-FTTextureGlyph::~FTTextureGlyph() {}
+// the glyph is rasterized again if its shelf has been evicted
+bool FTTextureGlyph::MakeResident() {
+	if (!destWidth || !destHeight) return false;
+	if (atlas->Touch (slot)) return true;
 
-const FTPoint& FTTextureGlyph::Render (const FTPoint& pen) {
-	if (activeTextureID != glTextureID) {
-		glBindTexture (GL_TEXTURE_2D, (GLuint)glTextureID);
-		activeTextureID = glTextureID;
-	}
+	FT_GlyphSlot glyph = face->Glyph (glyphIndex, FT_LOAD_NO_HINTING);
+	if (glyph == NULL) return false;
+	return Rasterize (glyph);
+}
+
+void FTTextureGlyph::TexCoords (GLfloat* tex) const {
+	GLfloat u0 = static_cast<float>(slot.x) / static_cast<float>(atlas->Width());
+	GLfloat v0 = static_cast<float>(slot.y) / static_cast<float>(atlas->Height());
+	GLfloat u1 = static_cast<float>(slot.x + slot.w) / static_cast<float>(atlas->Width());
+	GLfloat v1 = static_cast<float>(slot.y + slot.h) / static_cast<float>(atlas->Height());
+
+	tex[0] = u0; tex[1] = v0;
+	tex[2] = u0; tex[3] = v1;
+	tex[4] = u1; tex[5] = v1;
+	tex[6] = u1; tex[7] = v0;
+}
 
+const FTPoint& FTTextureGlyph::Render (const FTPoint& pen) {
 	glTranslatef (pen.X(),  pen.Y(), 0.0f);
+	if (!MakeResident()) return advance;
+	atlas->Bind();
 
-	const GLfloat tex[] = {
-		uv[0].X(), uv[0].Y(),
-		uv[0].X(), uv[1].Y(),
-		uv[1].X(), uv[1].Y(),
-		uv[1].X(), uv[0].Y(),
-	};
+	GLfloat tex[8];
+	TexCoords (tex);
 	const GLfloat vtx[] = {
 		pos.X(), pos.Y(),
 		pos.X(), pos.Y() - destHeight,
@@ -585,135 +839,107 @@ const FTPoint& FTTextureGlyph::Render (const FTPoint& pen) {
 	return advance;
 }
 
-inline GLuint NextPowerOf2 (GLuint in) {
-	in -= 1;
+void FTTextureGlyph::Layout (const FTPoint& pen, FTTextLayout& layout) {
+	if (!MakeResident()) return;
 
-	in |= in >> 16;
-	in |= in >> 8;
-	in |= in >> 4;
-	in |= in >> 2;
-	in |= in >> 1;
-	return in + 1;
+	GLfloat tex[8];
+	TexCoords (tex);
+	const GLfloat vtx[] = {
+		pen.X() + pos.X(), pen.Y() + pos.Y(),
+		pen.X() + pos.X(), pen.Y() + pos.Y() - destHeight,
+		pen.X() + pos.X() + destWidth, pen.Y() + pos.Y() - destHeight,
+		pen.X() + pos.X() + destWidth, pen.Y() + pos.Y()
+	};
+	layout.AddQuad (atlas->TextureID(), vtx, tex);
+}
+
+// --------------------------------------------------------------------
+//					FTTextLayout
+// --------------------------------------------------------------------
+
+void FTTextLayout::Clear() {
+	batches.clear();
+	bBox = FTBBox();
+}
+
+void FTTextLayout::AddQuad (GLuint textureID, const GLfloat* vtx, const GLfloat* tex) {
+	size_t b = 0;
+	while (b < batches.size() && batches[b].textureID != textureID) b++;
+	if (b == batches.size()) {
+		batches.push_back (Batch());
+		batches[b].textureID = textureID;
+	}
+
+	// two triangles (0,1,2) and (0,2,3) instead of a fan, so that
+	// all quads of a batch fit into a single draw call
+	static const int corners[6] = {0, 1, 2, 0, 2, 3};
+	vector<GLfloat>& v = batches[b].vertices;
+	for (int i = 0; i < 6; i++) {
+		v.push_back (vtx[corners[i]*2]);
+		v.push_back (vtx[corners[i]*2+1]);
+		v.push_back (tex[corners[i]*2]);
+		v.push_back (tex[corners[i]*2+1]);
+	}
+}
+
+void FTTextLayout::Render() const {
+	if (batches.empty()) return;
+#ifdef USE_GLES1
+	glPushAttrib (GL_COLOR_BUFFER_BIT);
+#else
+	glPushAttrib (GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+#endif
+	glEnable(GL_BLEND);
+	glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	// any texture may have been bound since the last text was drawn
+	FTTextureGlyph::ResetActiveTexture();
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	for (size_t b = 0; b < batches.size(); b++) {
+		const vector<GLfloat>& v = batches[b].vertices;
+		FTGlyphAtlas::BindTexture (batches[b].textureID);
+		glVertexPointer(2, GL_FLOAT, 4*sizeof(GLfloat), &v[0]);
+		glTexCoordPointer(2, GL_FLOAT, 4*sizeof(GLfloat), &v[2]);
+		glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(v.size() / 4));
+	}
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	FTTextureGlyph::ResetActiveTexture();
+	glPopAttrib();
 }
 
 // --------------------------------------------------------------------
 //					FTGLTextureFont
 // --------------------------------------------------------------------
 
-FTGLTextureFont::FTGLTextureFont (const char* fontFilePath)
+FTGLTextureFont::FTGLTextureFont (const char* fontFilePath, FTGlyphAtlas* sharedAtlas)
 	:   FTFont (fontFilePath),
-	  maximumGLTextureSize(0),
-	  textureWidth(0),
-	  textureHeight(0),
-	  glyphHeight(0),
-	  glyphWidth(0),
-	  padding(3),
-	  xOffset(0),
-	  yOffset(0)
+	  atlas(sharedAtlas),
+	  ownAtlas(sharedAtlas == NULL)
 {
-	remGlyphs = numGlyphs = face.GlyphCount();
+	if (ownAtlas) atlas = new FTGlyphAtlas;
 }
 
 FTGLTextureFont::FTGLTextureFont (const unsigned char *pBufferBytes, size_t bufferSizeInBytes)
 	:   FTFont (pBufferBytes, bufferSizeInBytes),
-	  maximumGLTextureSize(0),
-	  textureWidth(0),
-	  textureHeight(0),
-	  glyphHeight(0),
-	  glyphWidth(0),
-	  padding(3),
-	  xOffset(0),
-	  yOffset(0)
-{
-	remGlyphs = numGlyphs = face.GlyphCount();
-}
+	  atlas(new FTGlyphAtlas),
+	  ownAtlas(true)
+{}
 
 FTGLTextureFont::~FTGLTextureFont() {
-	glDeleteTextures ((GLsizei)textureIDList.size(), (const GLuint*)&textureIDList[0]);
+	if (ownAtlas) delete atlas;
 }
 
 FTGlyph* FTGLTextureFont::MakeGlyph (unsigned int glyphIndex) {
 	FT_GlyphSlot ftGlyph = face.Glyph (glyphIndex, FT_LOAD_NO_HINTING);
-	
-	if (ftGlyph) {
-		glyphHeight = static_cast<int> (charSize.Height());
-		glyphWidth = static_cast<int> (charSize.Width());
-
-		if (textureIDList.empty()) {
-			textureIDList.push_back (CreateTexture());
-			xOffset = yOffset = padding;
-		}
-
-		if (xOffset >  (textureWidth - glyphWidth)) {
-			xOffset = padding;
-			yOffset += glyphHeight;
-			if (yOffset >  (textureHeight - glyphHeight)) {
-				textureIDList.push_back (CreateTexture());
-				yOffset = padding;
-			}
-		}
-
-		FTTextureGlyph* tempGlyph =
-				new FTTextureGlyph (ftGlyph, textureIDList[textureIDList.size() - 1],
-				xOffset, yOffset, textureWidth, textureHeight);
-		xOffset += static_cast<int> (tempGlyph->BBox().upperX - tempGlyph->BBox().lowerX + padding);
 
-		--remGlyphs;
-		return tempGlyph;
-	}
+	if (ftGlyph) return new FTTextureGlyph (ftGlyph, &face, glyphIndex, atlas);
 	err = face.Error();
 	return NULL;
 }
 
-void FTGLTextureFont::CalculateTextureSize() {
-	if (!maximumGLTextureSize) {
-		glGetIntegerv (GL_MAX_TEXTURE_SIZE, (GLint*)&maximumGLTextureSize);
-	}
-	
-	textureWidth = NextPowerOf2 ((remGlyphs * glyphWidth) +  (padding * 2));
-	textureWidth = textureWidth > maximumGLTextureSize ? maximumGLTextureSize : textureWidth;
-	int h = static_cast<int> ((textureWidth -  (padding * 2)) / glyphWidth);
-	textureHeight = NextPowerOf2 (( (numGlyphs / h) + 1) * glyphHeight);
-	textureHeight = textureHeight > maximumGLTextureSize ? maximumGLTextureSize : textureHeight;
-}
-
-GLuint FTGLTextureFont::CreateTexture() {
-	CalculateTextureSize();
-
-	int totalMemory = textureWidth * textureHeight;
-	unsigned char* textureMemory = new unsigned char[totalMemory];
-	memset (textureMemory, 0, totalMemory);
-
-	GLuint textID;
-	glGenTextures (1, (GLuint*)&textID);
-
-	glBindTexture (GL_TEXTURE_2D, textID);
-#ifdef USE_GLES1
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-#else
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-#endif
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-	glTexImage2D (GL_TEXTURE_2D, 0, GL_ALPHA, textureWidth, textureHeight, 0,
-				  GL_ALPHA, GL_UNSIGNED_BYTE, textureMemory);
-
-	delete [] textureMemory;
-	return textID;
-}
-
-bool FTGLTextureFont::FaceSize (const unsigned int size, const unsigned int res) {
-	if (!textureIDList.empty()) {
-		glDeleteTextures ((GLsizei)textureIDList.size(), (const GLuint*)&textureIDList[0]);
-		textureIDList.clear();
-		remGlyphs = numGlyphs = face.GlyphCount();
-	}
-	return FTFont::FaceSize (size, res);
-}
-
 void FTGLTextureFont::Render (const char* string) {
 #ifdef USE_GLES1
 	glPushAttrib (GL_COLOR_BUFFER_BIT);
@@ -20,6 +20,7 @@ module.
 #define FTFONT_H
 
 #include "bh.h"
+#include <vector>
 
 #include <ft2build.h>
 #include FT_OUTLINE_H
@@ -477,6 +478,105 @@ class FTGL_EXPORT FTBBox {
     private:
 };
 
+// --------------------------------------------------------------------
+//			FTGlyphAtlas
+// --------------------------------------------------------------------
+
+// One alpha texture shared by all sizes of a font file. Glyphs are
+// packed into shelves (rows); the texture grows in height when a new
+// shelf doesn't fit. When the maximum size is reached, the least
+// recently used shelf is cleared and its glyphs are rasterized again
+// on their next use.
+
+struct FTAtlasSlot {
+    int shelf;
+    unsigned int serial;
+    int x, y, w, h;
+    FTAtlasSlot() : shelf(-1), serial(0), x(0), y(0), w(0), h(0) {}
+};
+
+struct FTAtlasStats {
+    unsigned int rasterizations;
+    unsigned int evictions;
+    unsigned int binds;				// texture binds in the current frame
+    unsigned int lastFrameBinds;	// texture binds in the previous frame
+    size_t bytes;					// memory of all atlas textures
+    FTAtlasStats() : rasterizations(0), evictions(0), binds(0), lastFrameBinds(0), bytes(0) {}
+};
+
+class FTGL_EXPORT FTGlyphAtlas {
+    public:
+        FTGlyphAtlas();
+        ~FTGlyphAtlas();
+        bool Insert(const FT_Bitmap& bitmap, FTAtlasSlot& slot);
+        bool Touch(const FTAtlasSlot& slot);
+        void Bind() const { BindTexture(textureID);}
+        GLuint TextureID() const { return textureID;}
+        GLsizei Width() const { return width;}
+        GLsizei Height() const { return height;}
+
+        static void BindTexture(GLuint id);
+        static void ResetActiveTexture() { activeTextureID = 0;}
+        static void NewFrame();
+        static unsigned int Generation() { return generation;}
+        static const FTAtlasStats& Stats() { return stats;}
+    private:
+        FTGlyphAtlas(const FTGlyphAtlas&);
+        FTGlyphAtlas& operator=(const FTGlyphAtlas&);
+        struct Shelf {
+            int y, height, x;
+            unsigned int serial;
+            unsigned int lastUse;
+        };
+        bool CreateTexture();
+        bool Grow(int minHeight);
+        int NewShelf(int h);
+        int EvictShelf(int h);
+        void Upload(int y, int rows);
+        void BindForUpload() const;
+
+        GLuint textureID;
+        GLsizei width;
+        GLsizei height;
+        GLsizei maxHeight;
+        unsigned char* pixels;
+        vector<Shelf> shelves;
+
+        static GLuint activeTextureID;
+        static unsigned int frame;
+        static unsigned int generation;
+        static FTAtlasStats stats;
+};
+
+// --------------------------------------------------------------------
+//			FTTextLayout
+// --------------------------------------------------------------------
+
+// A string whose glyph quads are already positioned. The quads are
+// collected per glyph texture, so a whole string is drawn with one
+// glDrawArrays call per texture (usually exactly one).
+
+class FTGL_EXPORT FTTextLayout {
+    public:
+        FTTextLayout() : generation(0) {}
+        void Clear();
+        void AddQuad(GLuint textureID, const GLfloat* vtx, const GLfloat* tex);
+        void Render() const;
+        void SetGeneration(unsigned int gen) { generation = gen;}
+        unsigned int Generation() const { return generation;}
+        void SetBBox(const FTBBox& box) { bBox = box;}
+        const FTBBox& BBox() const { return bBox;}
+        float Width() const { return bBox.upperX - bBox.lowerX;}
+    private:
+        struct Batch {
+            GLuint textureID;
+            vector<GLfloat> vertices;	// x, y, u, v per vertex
+        };
+        vector<Batch> batches;
+        FTBBox bBox;
+        unsigned int generation;
+};
+
 // --------------------------------------------------------------------
 //			FTGlyph
 // --------------------------------------------------------------------
@@ -486,6 +586,7 @@ class FTGL_EXPORT FTGlyph {
         FTGlyph(FT_GlyphSlot glyph);
         virtual ~FTGlyph();
         virtual const FTPoint& Render(const FTPoint& pen) = 0;
+        virtual void Layout(const FTPoint& pen, FTTextLayout& layout) {}
         const FTPoint& Advance() const { return advance;}
         const FTBBox& BBox() const { return bBox;}
         FT_Error Error() const { return err;}
@@ -535,6 +636,8 @@ class FTGL_EXPORT FTGlyphContainer {
         float Advance(const unsigned int characterCode, const unsigned int nextCharacterCode);
         FTPoint Render(const unsigned int characterCode,
 			const unsigned int nextCharacterCode, FTPoint penPosition);
+        void Layout(const unsigned int characterCode, const FTPoint& penPosition,
+			FTTextLayout& layout);
         FT_Error Error() const { return err;}
 
     private:
@@ -550,18 +653,23 @@ class FTGL_EXPORT FTGlyphContainer {
 
 class FTGL_EXPORT FTTextureGlyph : public FTGlyph {
     public:
-        FTTextureGlyph(FT_GlyphSlot glyph, int id, int xOffset, int yOffset,
-			GLsizei width, GLsizei height);
+        FTTextureGlyph(FT_GlyphSlot glyph, FTFace* face, unsigned int glyphIndex,
+			FTGlyphAtlas* atlas);
         virtual ~FTTextureGlyph();
         virtual const FTPoint& Render(const FTPoint& pen);
-        static void ResetActiveTexture() { activeTextureID = 0;}
+        virtual void Layout(const FTPoint& pen, FTTextLayout& layout);
+        static void ResetActiveTexture() { FTGlyphAtlas::ResetActiveTexture();}
     private:
+        bool Rasterize(FT_GlyphSlot glyph);
+        bool MakeResident();
+        void TexCoords(GLfloat* tex) const;
         int destWidth;
         int destHeight;
         FTPoint pos;
-        FTPoint uv[2];
-        int glTextureID;
-        static GLint activeTextureID;
+        FTFace* face;
+        unsigned int glyphIndex;
+        FTGlyphAtlas* atlas;
+        FTAtlasSlot slot;
 };
 
 // --------------------------------------------------------------------
@@ -593,6 +701,7 @@ class FTGL_EXPORT FTFont {
         float Advance (const char* string);
         virtual void Render (const char* string);
         virtual void Render (const wchar_t* string);
+        void Layout (const wchar_t* string, FTTextLayout& layout);
         FT_Error Error() const { return err;}
 
     protected:
@@ -610,29 +719,21 @@ class FTGL_EXPORT FTFont {
 //			FTTextureFont
 // --------------------------------------------------------------------
 
+// The glyphs are kept in an FTGlyphAtlas. If no atlas is passed, the
+// font creates its own one; otherwise the atlas is shared with other
+// fonts (e.g. other sizes of the same font file) and owned by the caller.
+
 class FTGL_EXPORT FTGLTextureFont : public FTFont {
     public:
-        FTGLTextureFont(const char* fontFilePath);
+        FTGLTextureFont(const char* fontFilePath, FTGlyphAtlas* sharedAtlas = NULL);
         FTGLTextureFont(const unsigned char *pBufferBytes, size_t bufferSizeInBytes);
         virtual ~FTGLTextureFont();
-        virtual bool FaceSize(const unsigned int size, const unsigned int res = 72);
         virtual void Render(const char* string);
         virtual void Render(const wchar_t* string);
     private:
         inline virtual FTGlyph* MakeGlyph(unsigned int glyphIndex);
-        inline void CalculateTextureSize();
-        inline GLuint CreateTexture();
-        GLsizei maximumGLTextureSize;
-        GLsizei textureWidth;
-        GLsizei textureHeight;
-        FTVector<GLuint> textureIDList;
-        int glyphHeight;
-        int glyphWidth;
-        unsigned int padding;
-        unsigned int numGlyphs;
-        unsigned int remGlyphs;
-        int xOffset;
-        int yOffset;
+        FTGlyphAtlas* atlas;
+        bool ownAtlas;
 };
 
 #ifndef USE_GLES1
@@ -81,10 +81,13 @@ void LoadConfigFile () {
 		param.tux_sphere_divisions = SPIntN (line, "tux_sphere_divisions", 10);
 		param.tux_shadow_sphere_divisions = SPIntN (line, "tux_shadow_sphere_div", 3);
 		param.course_detail_level = SPIntN (line, "course_detail_level", 75);
+		param.course_cache_size = SPIntN (line, "course_cache_size", 128);
+		param.texture_memory = SPIntN (line, "texture_memory", 256);
 
 		param.use_papercut_font = SPIntN (line, "use_papercut_font", 1);
 		param.ice_cursor = SPBoolN (line, "ice_cursor", true);
 		param.full_skybox = SPBoolN (line, "full_skybox", false);
+		param.ghost_racer = SPBoolN (line, "ghost_racer", true);
 		param.audio_freq = SPIntN (line, "audio_freq", 22050);
 		param.audio_buffer_size = SPIntN (line, "audio_buffer_size", 512);
 		param.use_quad_scale = SPBoolN (line, "use_quad_scale", false);
@@ -116,12 +119,15 @@ void SetConfigDefaults () {
 	param.tux_sphere_divisions = 10;
 	param.tux_shadow_sphere_divisions = 3;
 	param.course_detail_level = 75;
+	param.course_cache_size = 128;
+	param.texture_memory = 256;
 	param.audio_freq = 22050;
 	param.audio_buffer_size = 512;
 
 	param.use_papercut_font = 1;
 	param.ice_cursor = true;
 	param.full_skybox = false;
+	param.ghost_racer = true;
 	param.use_quad_scale = false;
 
 	param.menu_music = "start_1";
@@ -249,6 +255,17 @@ void SaveConfigFile () {
 	AddIntItem (liste, "course_detail_level", param.course_detail_level);
 	liste.AddLine();
 
+	AddComment (liste, "Course cache size in MB");
+	AddComment (liste, "Courses that were loaded before are kept in memory up to");
+	AddComment (liste, "this size, so going back to them needs no loading. 0 = off");
+	AddIntItem (liste, "course_cache_size", param.course_cache_size);
+	liste.AddLine();
+
+	AddComment (liste, "Textures that were not used for the longest time are");
+	AddComment (liste, "unloaded if they need more than this many MB. 0 = no limit");
+	AddIntItem (liste, "texture_memory", param.texture_memory);
+	liste.AddLine();
+
 	AddComment (liste, "Font type [0...2]");
 	AddComment (liste, "0 = always arial-like font,");
 	AddComment (liste, "1 = papercut font on the menu screens");
@@ -268,6 +285,12 @@ void SaveConfigFile () {
 	AddIntItem (liste, "full_skybox", param.full_skybox);
 	liste.AddLine();
 
+	AddComment (liste, "Ghost racer [0...1]");
+	AddComment (liste, "1 = race against a translucent replay of your fastest");
+	AddComment (liste, "finished run on the course");
+	AddIntItem (liste, "ghost_racer", param.ghost_racer);
+	liste.AddLine();
+
 	AddComment (liste, "Audio frequency");
 	AddComment (liste, "Typical values are 11025, 22050 ...");
 	AddIntItem (liste, "audio_freq", param.audio_freq);
@@ -61,12 +61,15 @@ struct TParam {
 	int		tux_sphere_divisions;
 	int		tux_shadow_sphere_divisions;
 	int		course_detail_level; // only for quadtree
+	int		course_cache_size;	// MB of loaded courses kept for reuse
+	int		texture_memory;		// MB of managed textures kept on the GPU, 0 = no limit
 	int		audio_freq;
 	int		audio_buffer_size;
 
 	int		use_papercut_font;
 	bool	ice_cursor;
 	bool	full_skybox;
+	bool	ghost_racer;			// race against the best run of the course
 	bool	use_quad_scale;			// scaling type for menus
 
 	string  menu_music;
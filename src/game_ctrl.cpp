@@ -26,6 +26,9 @@ GNU General Public License for more details.
 #include "textures.h"
 #include "tux.h"
 #include "physics.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
 
 // --------------------------------------------------------------------
 //				administration of events and cups
@@ -313,6 +316,10 @@ CCharacter::~CCharacter() {
 	}
 }
 
+// Only the list is read at startup. The shape and the keyframes of a
+// character are loaded when it is selected and then kept, previews
+// when the character selection shows them.
+
 void CCharacter::LoadCharacterList () {
 	CSPList list (MAX_CHARACTERS);
 
@@ -328,36 +335,125 @@ void CCharacter::LoadCharacterList () {
 		CharList[i].dir = SPStrN (line, "dir");
 		string typestr = SPStrN (line, "type", "unknown");
 		CharList[i].type = SPIntN (char_type_index, typestr, -1);
+		CharList[i].preview = NULL;
+		CharList[i].shape = NULL;
+		CharList[i].finishframesok = false;
+		CharList[i].loaded = false;
+	}
+}
+
+static const char *frame_files[NUM_FRAME_TYPES] = {
+	"start.lst", "finish.lst", "wonrace.lst", "lostrace.lst"
+};
+
+TCharacter* CCharacter::GetCharacter (size_t idx) {
+	if (idx >= CharList.size()) return NULL;
+	TCharacter* ch = &CharList[idx];
+	if (ch->loaded) return ch;
+	ch->loaded = true;
+
+	string charpath = param.char_dir + SEP + ch->dir;
+	if (!DirExists (charpath.c_str())) return ch;
+
+	ch->shape = new CCharShape;
+	if (ch->shape->Load (charpath, "shape.lst", false) == false) {
+		delete ch->shape;
+		ch->shape = NULL;
+		Message ("could not load character shape");
+	}
+
+	ch->frames[START].Load (charpath, frame_files[START]);
+	ch->finishframesok = true;
+	for (int i=FINISH; i<NUM_FRAME_TYPES; i++) {
+		ch->frames[i].Load (charpath, frame_files[i]);
+		if (ch->frames[i].loaded == false) ch->finishframesok = false;
+	}
+	return ch;
+}
+
+static bool SameFrames (const CKeyframe& a, const CKeyframe& b) {
+	if (a.numFrames() != b.numFrames()) return false;
+	for (size_t i=0; i<a.numFrames(); i++)
+		if (memcmp (a.GetFrame(i), b.GetFrame(i), sizeof(TKeyframe)) != 0) return false;
+	return true;
+}
+
+// A compiled file that doesn't load like its text file is deleted, so
+// the game keeps using the text file
+static void RejectCompiled (const string& dir, const string& filename, const char *msg) {
+	string pakfile = dir + SEP + CompiledName (filename);
+	Message (msg, dir + SEP + filename);
+	remove (pakfile.c_str());
+}
 
+// Writes shape.pak and the .pak files of the keyframes for every
+// character in characters.lst, loads them back and compares the result
+// with the text files. Used by "etr --compile-chars". False if a
+// character could not be compiled or a compiled file differs.
+bool CCharacter::CompileCharacters () {
+	bool all_ok = true;
+	ETR_DOUBLE lst_total = 0, pak_total = 0;
+	for (size_t i=0; i<CharList.size(); i++) {
 		string charpath = param.char_dir + SEP + CharList[i].dir;
-		if (DirExists (charpath.c_str())) {
-			string previewfile = charpath + SEP "preview.png";
-
-			TCharacter* ch = &CharList[i];
-			ch->preview = new TTexture();
-			if (!ch->preview->LoadMipmap(previewfile, false)) {
-				Message ("could not load previewfile of character");
-//				texid = Tex.TexID (NO_PREVIEW);
+		if (!DirExists (charpath.c_str())) continue;
+
+		CCharShape text_shape, pak_shape;
+		CKeyframe text_frames[NUM_FRAME_TYPES], pak_frames[NUM_FRAME_TYPES];
+		text_shape.useCompiled = false;
+		for (int f=0; f<NUM_FRAME_TYPES; f++) text_frames[f].useCompiled = false;
+
+		CTimer timer;
+		bool ok = text_shape.Load (charpath, "shape.lst", false);
+		for (int f=0; f<NUM_FRAME_TYPES; f++) text_frames[f].Load (charpath, frame_files[f]);
+		double lst_ms = timer.Milliseconds ();
+		if (!ok || !text_shape.SaveCompiled (charpath, "shape.lst")) {
+			Message ("could not compile character", CharList[i].dir);
+			all_ok = false;
+			continue;
+		}
+		for (int f=0; f<NUM_FRAME_TYPES; f++) {
+			if (text_frames[f].loaded && !text_frames[f].SaveCompiled (charpath, frame_files[f])) {
+				Message ("could not compile keyframes", charpath + SEP + frame_files[f]);
+				all_ok = false;
 			}
+		}
 
+		timer.Start ();
+		pak_shape.Load (charpath, "shape.lst", false);
+		for (int f=0; f<NUM_FRAME_TYPES; f++) pak_frames[f].Load (charpath, frame_files[f]);
+		double pak_ms = timer.Milliseconds ();
 
-			ch->shape = new CCharShape;
-			if (ch->shape->Load (charpath, "shape.lst", false) == false) {
-				delete ch->shape;
-				ch->shape = NULL;
-				Message ("could not load character shape");
+		if (!text_shape.SameShape (pak_shape)) {
+			RejectCompiled (charpath, "shape.lst", "compiled shape differs from");
+			all_ok = false;
+		}
+		for (int f=0; f<NUM_FRAME_TYPES; f++) {
+			if (text_frames[f].loaded != pak_frames[f].loaded || !SameFrames (text_frames[f], pak_frames[f])) {
+				RejectCompiled (charpath, frame_files[f], "compiled keyframes differ from");
+				all_ok = false;
 			}
+		}
+
+		lst_total += lst_ms;
+		pak_total += pak_ms;
+		cout << CharList[i].dir << ": lst " << lst_ms << " ms, pak " << pak_ms << " ms\n";
+	}
+	cout << "all characters: lst " << lst_total << " ms, pak " << pak_total << " ms\n";
+	return all_ok;
+}
 
-			ch->frames[0].Load (charpath, "start.lst");
-			ch->finishframesok = true;
-			ch->frames[1].Load (charpath, "finish.lst");
-			if (ch->frames[1].loaded == false) ch->finishframesok = false;
-			ch->frames[2].Load (charpath, "wonrace.lst");
-			if (ch->frames[2].loaded == false) ch->finishframesok = false;
-			ch->frames[3].Load (charpath, "lostrace.lst");
-			if (ch->frames[3].loaded == false) ch->finishframesok = false;
+TTexture* CCharacter::GetPreview (size_t idx) {
+	if (idx >= CharList.size()) return NULL;
+	TCharacter* ch = &CharList[idx];
+	if (ch->preview == NULL) {
+		string previewfile = param.char_dir + SEP + ch->dir + SEP "preview.png";
+		ch->preview = new TTexture();
+		if (!ch->preview->LoadMipmap(previewfile, false)) {
+			Message ("could not load previewfile of character");
+//			texid = Tex.TexID (NO_PREVIEW);
 		}
 	}
+	return ch->preview;
 }
 
 void CCharacter::FreeCharacterPreviews() {
@@ -155,10 +155,11 @@ struct TCharacter {
 	int type;
 	string name;
 	string dir;
-	TTexture* preview;
-	CCharShape *shape;
+	TTexture* preview;		// loaded on demand, see CCharacter::GetPreview
+	CCharShape *shape;		// shape and frames are loaded by CCharacter::GetCharacter
 	CKeyframe frames[NUM_FRAME_TYPES];
 	bool finishframesok;
+	bool loaded;
 
 	CKeyframe* GetKeyframe(TFrameType type);
 };
@@ -170,7 +171,10 @@ public:
 	~CCharacter();
 
 	void LoadCharacterList ();
+	TCharacter* GetCharacter (size_t idx);
+	TTexture* GetPreview (size_t idx);
 	void FreeCharacterPreviews ();
+	bool CompileCharacters ();
 };
 
 extern CCharacter Char;
@@ -0,0 +1,293 @@
+/* --------------------------------------------------------------------
+EXTREME TUXRACER
+
+Copyright (C) 2010 Extreme Tuxracer Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+---------------------------------------------------------------------*/
+
+#ifdef HAVE_CONFIG_H
+#include <etr_config.h>
+#endif
+
+#include "ghost.h"
+#include "course.h"
+#include "game_ctrl.h"
+#include "physics.h"
+#include <cstring>
+#include <fstream>
+
+#define GHOST_MAGIC 0x47525445	// "ETRG"
+#define GHOST_VERSION 1
+#define GHOST_NAME_LEN 64
+#define GHOST_ALPHA 0.4
+
+#define GHOST_POS_SCALE 1000.0		// mm
+#define GHOST_ROT_SCALE 16384.0		// quaternion components
+#define GHOST_ANGLE_SCALE 10.0		// 0.1 degrees
+
+struct TGhostHeader {
+	unsigned int magic;
+	unsigned int version;
+	unsigned int rate;
+	unsigned int channels;
+	unsigned int num_samples;
+	unsigned int stream_size;
+	float time;
+	char char_dir[GHOST_NAME_LEN];
+};
+
+CGhost Ghost;
+
+CGhost::CGhost () {
+	recSamples = 0;
+	recording = false;
+	playPos = 0;
+	playSamples = 0;
+	playIdx = 0;
+	bestTime = 0;
+	shape = NULL;
+	visible = false;
+}
+
+// --------------------------------------------------------------------
+//				stream
+// --------------------------------------------------------------------
+
+// zigzag varint: small differences of either sign take one byte
+static void PutDelta (vector<unsigned char>& out, int delta) {
+	unsigned int v = delta < 0 ? ((unsigned int)(-(delta + 1)) << 1) | 1 : (unsigned int)delta << 1;
+	while (v >= 0x80) {
+		out.push_back ((unsigned char)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back ((unsigned char)v);
+}
+
+static bool GetDelta (const vector<unsigned char>& in, size_t& pos, int& delta) {
+	unsigned int v = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		if (pos >= in.size()) return false;
+		unsigned char b = in[pos++];
+		v |= (unsigned int)(b & 0x7f) << shift;
+		if ((b & 0x80) == 0) {
+			delta = (v & 1) ? -(int)(v >> 1) - 1 : (int)(v >> 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+static int QuantizeValue (ETR_DOUBLE val, ETR_DOUBLE scale) {
+	return (int)floor (val * scale + 0.5);
+}
+
+void CGhost::Quantize (const CCharShape *src, int q[]) const {
+	TCharInstance cur;
+	src->GetInstance (cur);
+	const TAffine& root = cur.root;
+	TQuaternion rot = MakeQuaternionFromMatrix (root.GetMatrix ());
+	// q and -q are the same rotation, the one closer to the last sample
+	// keeps the differences small
+	ETR_DOUBLE dot = rot.x * recLast[3] + rot.y * recLast[4] + rot.z * recLast[5] + rot.w * recLast[6];
+	if (dot < 0) rot = TQuaternion (-rot.x, -rot.y, -rot.z, -rot.w);
+
+	q[0] = QuantizeValue (root[0][3], GHOST_POS_SCALE);
+	q[1] = QuantizeValue (root[1][3], GHOST_POS_SCALE);
+	q[2] = QuantizeValue (root[2][3], GHOST_POS_SCALE);
+	q[3] = QuantizeValue (rot.x, GHOST_ROT_SCALE);
+	q[4] = QuantizeValue (rot.y, GHOST_ROT_SCALE);
+	q[5] = QuantizeValue (rot.z, GHOST_ROT_SCALE);
+	q[6] = QuantizeValue (rot.w, GHOST_ROT_SCALE);
+	const TCharPose& pose = cur.pose;
+	for (int j=0; j<NUM_JOINTS; j++) {
+		q[7 + j*3] = QuantizeValue (pose.rot[j].x, GHOST_ANGLE_SCALE);
+		q[8 + j*3] = QuantizeValue (pose.rot[j].y, GHOST_ANGLE_SCALE);
+		q[9 + j*3] = QuantizeValue (pose.rot[j].z, GHOST_ANGLE_SCALE);
+	}
+}
+
+// Adds the next differences to q
+bool CGhost::ReadSample (int q[]) {
+	for (int c=0; c<GHOST_CHANNELS; c++) {
+		int delta;
+		if (!GetDelta (play, playPos, delta)) return false;
+		q[c] += delta;
+	}
+	return true;
+}
+
+static ETR_DOUBLE Lerp (int a, int b, ETR_DOUBLE frac, ETR_DOUBLE scale) {
+	return (a + (b - a) * frac) / scale;
+}
+
+void CGhost::ApplySample (ETR_DOUBLE frac) {
+	TQuaternion q1 (playPrev[3], playPrev[4], playPrev[5], playPrev[6]);
+	TQuaternion q2 (playNext[3], playNext[4], playNext[5], playNext[6]);
+	q1.Norm();
+	q2.Norm();
+	TQuaternion rot = InterpolateQuaternions (q1, q2, frac);
+	rot.Norm();
+
+	inst.root = TAffine (MakeMatrixFromQuaternion (rot));
+	inst.root[0][3] = Lerp (playPrev[0], playNext[0], frac, GHOST_POS_SCALE);
+	inst.root[1][3] = Lerp (playPrev[1], playNext[1], frac, GHOST_POS_SCALE);
+	inst.root[2][3] = Lerp (playPrev[2], playNext[2], frac, GHOST_POS_SCALE);
+
+	for (int j=0; j<NUM_JOINTS; j++) {
+		inst.pose.rot[j].x = Lerp (playPrev[7 + j*3], playNext[7 + j*3], frac, GHOST_ANGLE_SCALE);
+		inst.pose.rot[j].y = Lerp (playPrev[8 + j*3], playNext[8 + j*3], frac, GHOST_ANGLE_SCALE);
+		inst.pose.rot[j].z = Lerp (playPrev[9 + j*3], playNext[9 + j*3], frac, GHOST_ANGLE_SCALE);
+	}
+}
+
+// --------------------------------------------------------------------
+//				files
+// --------------------------------------------------------------------
+
+string CGhost::FileName () const {
+	string name = g_game.course->dir;
+	if (g_game.mirrorred) name += "_mirrored";
+	return param.config_dir + SEP + name + ".ghost";
+}
+
+bool CGhost::Load () {
+	string filename = FileName ();
+	if (!FileExists (filename)) return false;
+
+	CMappedFile file;
+	if (!file.Open (filename)) return false;
+	const TGhostHeader* hdr = (const TGhostHeader*)file.Data();
+	if (file.Size() < sizeof(TGhostHeader)
+	        || hdr->magic != GHOST_MAGIC
+	        || hdr->version != GHOST_VERSION
+	        || hdr->rate != GHOST_RATE
+	        || hdr->channels != GHOST_CHANNELS
+	        || file.Size() != sizeof(TGhostHeader) + hdr->stream_size
+	        || memchr (hdr->char_dir, 0, GHOST_NAME_LEN) == NULL) {
+		Message ("ghost run of an older version", filename);
+		return false;
+	}
+	const unsigned char *data = file.Data() + sizeof(TGhostHeader);
+	play.assign (data, data + hdr->stream_size);
+	playSamples = hdr->num_samples;
+	bestTime = hdr->time;
+
+	// the ghost draws the shape of the character list, only its
+	// instance is its own
+	shape = NULL;
+	for (size_t i=0; i<Char.CharList.size(); i++) {
+		if (Char.CharList[i].dir != hdr->char_dir) continue;
+		TCharacter *ch = Char.GetCharacter (i);
+		if (ch != NULL) shape = ch->shape;
+		break;
+	}
+	return shape != NULL;
+}
+
+bool CGhost::Save () const {
+	const string& dir = g_game.character->dir;
+	if (dir.size() >= GHOST_NAME_LEN) return false;
+
+	TGhostHeader hdr;
+	memset (&hdr, 0, sizeof(hdr));
+	hdr.magic = GHOST_MAGIC;
+	hdr.version = GHOST_VERSION;
+	hdr.rate = GHOST_RATE;
+	hdr.channels = GHOST_CHANNELS;
+	hdr.num_samples = recSamples;
+	hdr.stream_size = rec.size();
+	hdr.time = g_game.time;
+	strcpy (hdr.char_dir, dir.c_str());
+
+	string filename = FileName ();
+	ofstream file (filename.c_str(), ios::out | ios::binary);
+	if (file) {
+		file.write ((const char*)&hdr, sizeof(hdr));
+		if (!rec.empty())
+			file.write ((const char*)&rec[0], rec.size());
+	}
+	if (!file) {
+		Message ("could not write ghost run", filename);
+		return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------
+//				race
+// --------------------------------------------------------------------
+
+// Called when a race starts, after the intro.
+void CGhost::StartRace () {
+	rec.clear();
+	memset (recLast, 0, sizeof(recLast));
+	recSamples = 0;
+	recording = true;
+
+	play.clear();
+	playPos = 0;
+	playSamples = 0;
+	playIdx = 0;
+	bestTime = 0;
+	visible = false;
+	if (!param.ghost_racer || !Load () || playSamples < 2) return;
+
+	memset (playPrev, 0, sizeof(playPrev));
+	if (!ReadSample (playPrev)) return;
+	memcpy (playNext, playPrev, sizeof(playNext));
+	if (!ReadSample (playNext)) return;
+	visible = true;
+}
+
+// After the player has moved. Records the samples that are due and
+// moves the ghost to the race time.
+void CGhost::Update () {
+	if (recording && !g_game.finish) {
+		while (recSamples <= g_game.time * GHOST_RATE) {
+			int q[GHOST_CHANNELS];
+			Quantize (g_game.character->shape, q);
+			for (int c=0; c<GHOST_CHANNELS; c++) PutDelta (rec, q[c] - recLast[c]);
+			memcpy (recLast, q, sizeof(recLast));
+			recSamples++;
+		}
+	}
+
+	if (!visible) return;
+	ETR_DOUBLE t = g_game.time * GHOST_RATE;
+	while (t >= playIdx + 1) {
+		// the ghost has reached the finish
+		if (playIdx + 2 >= playSamples) {
+			visible = false;
+			return;
+		}
+		memcpy (playPrev, playNext, sizeof(playPrev));
+		if (!ReadSample (playNext)) {
+			visible = false;
+			return;
+		}
+		playIdx++;
+	}
+	ApplySample (t - playIdx);
+}
+
+void CGhost::Draw () {
+	if (visible && shape != NULL) shape->DrawInstances (&inst, 1, GHOST_ALPHA);
+}
+
+// Keeps the run if the race was finished faster than the ghost.
+void CGhost::FinishRace (bool finished) {
+	if (!recording) return;
+	recording = false;
+	visible = false;
+	if (finished && recSamples > 1 && (bestTime <= 0 || g_game.time < bestTime)) Save ();
+	rec.clear();
+}
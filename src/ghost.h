@@ -0,0 +1,74 @@
+/* --------------------------------------------------------------------
+EXTREME TUXRACER
+
+Copyright (C) 2010 Extreme Tuxracer Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+---------------------------------------------------------------------*/
+
+// The ghost racer: every race records the position, orientation and
+// pose of Tux GHOST_RATE times per second. The fastest finished run of
+// each course is kept in the config directory next to the highscore
+// list and raced against as a translucent second character. Playback
+// only interpolates between two samples, there is no physics for it.
+//
+// The samples are quantized to integers and each value is stored as
+// the varint of its difference to the previous sample, so a sample
+// mostly takes one byte per value.
+
+#ifndef GHOST_H
+#define GHOST_H
+
+#include "bh.h"
+#include "tux.h"
+#include <vector>
+
+#define GHOST_RATE 20
+#define GHOST_CHANNELS (3 + 4 + 3 * NUM_JOINTS)	// position, rotation, pose
+
+class CGhost {
+private:
+	// recording of the current race
+	vector<unsigned char> rec;
+	int recLast[GHOST_CHANNELS];
+	size_t recSamples;
+	bool recording;
+
+	// playback of the best run
+	vector<unsigned char> play;
+	size_t playPos;			// read position in play
+	size_t playSamples;
+	size_t playIdx;			// sample number of playPrev
+	int playPrev[GHOST_CHANNELS];
+	int playNext[GHOST_CHANNELS];
+	ETR_DOUBLE bestTime;	// 0 if there is no run yet
+	CCharShape *shape;		// of the character list, shared with the players
+	TCharInstance inst;
+	bool visible;
+
+	string FileName () const;
+	void Quantize (const CCharShape *src, int q[]) const;
+	bool ReadSample (int q[]);
+	void ApplySample (ETR_DOUBLE frac);
+	bool Load ();
+	bool Save () const;
+public:
+	CGhost ();
+
+	void StartRace ();
+	void Update ();
+	void Draw ();
+	void FinishRace (bool finished);
+};
+
+extern CGhost Ghost;
+
+#endif
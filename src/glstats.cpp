@@ -0,0 +1,216 @@
+/* --------------------------------------------------------------------
+EXTREME TUXRACER
+
+Copyright (C) 2010 Extreme Tuxracer Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+---------------------------------------------------------------------*/
+
+#ifdef HAVE_CONFIG_H
+#include <etr_config.h>
+#endif
+
+// the wrappers call the real entry points
+#define GLSTATS_IMPL
+#include "bh.h"
+
+#ifdef USE_GLSTATS
+
+#include "ogl.h"
+#include "font.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+// slot 0 collects the calls made before the first render mode is set
+#define NUM_SLOTS (NUM_RENDER_MODES + 1)
+
+static const char *modenames[NUM_SLOTS] = {
+	"none", "GUI", "GAUGE_BARS", "TEXFONT", "COURSE", "TREES", "PARTICLES",
+	"TUX", "TUX_SHADOW", "SKY", "FOG_PLANE", "TRACK_MARKS"
+};
+
+static TGLCallStats current[NUM_SLOTS];
+static TGLCallStats last[NUM_SLOTS];
+static size_t slot = 0;
+static unsigned int frame = 0;
+static bool visible = false;
+static bool forward_calls = true;
+static std::ofstream dumpfile;
+
+void GLStatsNewFrame () {
+	if (dumpfile.is_open()) {
+		for (size_t i = 0; i < NUM_SLOTS; i++) {
+			const TGLCallStats& s = current[i];
+			if (s.draws == 0 && s.states == 0 && s.binds == 0) continue;
+			dumpfile << frame << ',' << modenames[i] << ',' << s.draws << ','
+			         << s.primitives << ',' << s.vertices << ',' << s.states << ','
+			         << s.binds << '\n';
+		}
+	}
+	memcpy (last, current, sizeof(current));
+	memset (current, 0, sizeof(current));
+	frame++;
+}
+
+void GLStatsSetMode (int mode) {
+	if (mode >= 0 && mode < NUM_RENDER_MODES) slot = mode + 1;
+	else slot = 0;
+}
+
+// without forwarding the wrappers only count, see the null backend in winsys.cpp
+void GLStatsSetForward (bool f) {
+	forward_calls = f;
+}
+
+const TGLCallStats& GLStatsLastFrame (int mode) {
+	if (mode >= 0 && mode < NUM_RENDER_MODES) return last[mode + 1];
+	return last[0];
+}
+
+void GLStatsToggleVisible () {
+	visible = !visible;
+}
+
+void GLStatsToggleDump (const string& filename) {
+	if (dumpfile.is_open()) {
+		dumpfile.close ();
+		Message ("gl statistics written to", filename);
+		return;
+	}
+	dumpfile.open (filename.c_str());
+	if (!dumpfile) {
+		Message ("could not write gl statistics", filename);
+		return;
+	}
+	dumpfile << "frame,mode,draws,primitives,vertices,states,binds\n";
+}
+
+void GLStatsDraw () {
+	if (!visible) return;
+
+	const float size = 14;
+	float y = 60;
+	char line[128];
+
+	TGLCallStats total;
+	memset (&total, 0, sizeof(total));
+	FT.SetColor (colWhite);
+	FT.DrawText (300, y, "mode  draws / prims / verts / states / binds", "normal", size);
+	for (size_t i = 0; i < NUM_SLOTS; i++) {
+		const TGLCallStats& s = last[i];
+		if (s.draws == 0 && s.states == 0 && s.binds == 0) continue;
+		y += size + 2;
+		snprintf (line, sizeof(line), "%s  %u / %u / %u / %u / %u", modenames[i],
+		          s.draws, s.primitives, s.vertices, s.states, s.binds);
+		FT.DrawText (300, y, line, "normal", size);
+		total.draws += s.draws;
+		total.primitives += s.primitives;
+		total.vertices += s.vertices;
+		total.states += s.states;
+		total.binds += s.binds;
+	}
+	y += size + 2;
+	snprintf (line, sizeof(line), "total  %u / %u / %u / %u / %u",
+	          total.draws, total.primitives, total.vertices, total.states, total.binds);
+	FT.DrawText (300, y, line, "normal", size);
+}
+
+// --------------------------------------------------------------------
+//				wrappers
+// --------------------------------------------------------------------
+
+static unsigned int Primitives (GLenum mode, GLsizei count) {
+	switch (mode) {
+		case GL_POINTS: return count;
+		case GL_LINES: return count / 2;
+		case GL_LINE_STRIP: return count > 1 ? count - 1 : 0;
+		case GL_LINE_LOOP: return count;
+		case GL_TRIANGLES: return count / 3;
+		case GL_TRIANGLE_STRIP:
+		case GL_TRIANGLE_FAN: return count > 2 ? count - 2 : 0;
+		default: return 0;
+	}
+}
+
+static void CountDraw (GLenum mode, GLsizei count) {
+	TGLCallStats& s = current[slot];
+	s.draws++;
+	s.vertices += count;
+	s.primitives += Primitives (mode, count);
+}
+
+void glsDrawArrays (GLenum mode, GLint first, GLsizei count) {
+	CountDraw (mode, count);
+	if (forward_calls) glDrawArrays (mode, first, count);
+}
+
+void glsDrawElements (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices) {
+	CountDraw (mode, count);
+	if (forward_calls) glDrawElements (mode, count, type, indices);
+}
+
+void glsBindTexture (GLenum target, GLuint texture) {
+	current[slot].binds++;
+	if (forward_calls) glBindTexture (target, texture);
+}
+
+void glsBindBuffer (GLenum target, GLuint buffer) {
+	current[slot].binds++;
+	if (forward_calls) glBindBuffer (target, buffer);
+}
+
+void glsEnable (GLenum cap) {
+	current[slot].states++;
+	if (forward_calls) glEnable (cap);
+}
+
+void glsDisable (GLenum cap) {
+	current[slot].states++;
+	if (forward_calls) glDisable (cap);
+}
+
+void glsEnableClientState (GLenum array) {
+	current[slot].states++;
+	if (forward_calls) glEnableClientState (array);
+}
+
+void glsDisableClientState (GLenum array) {
+	current[slot].states++;
+	if (forward_calls) glDisableClientState (array);
+}
+
+void glsBlendFunc (GLenum sfactor, GLenum dfactor) {
+	current[slot].states++;
+	if (forward_calls) glBlendFunc (sfactor, dfactor);
+}
+
+void glsDepthMask (GLboolean flag) {
+	current[slot].states++;
+	if (forward_calls) glDepthMask (flag);
+}
+
+void glsDepthFunc (GLenum func) {
+	current[slot].states++;
+	if (forward_calls) glDepthFunc (func);
+}
+
+void glsShadeModel (GLenum mode) {
+	current[slot].states++;
+	if (forward_calls) glShadeModel (mode);
+}
+
+void glsAlphaFunc (GLenum func, GLclampf ref) {
+	current[slot].states++;
+	if (forward_calls) glAlphaFunc (func, ref);
+}
+
+#endif // USE_GLSTATS
@@ -0,0 +1,92 @@
+/* --------------------------------------------------------------------
+EXTREME TUXRACER
+
+Copyright (C) 2010 Extreme Tuxracer Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+---------------------------------------------------------------------*/
+
+// GL call statistics for development. Only built with -DUSE_GLSTATS,
+// otherwise all GLSTATS_ macros expand to nothing.
+//
+// This header is included by bh.h. It redirects the GL entry points
+// below to counting wrappers, which forward to whatever GL library is
+// linked (the real one or a stub). The counts are collected per
+// render mode (see TRenderMode in ogl.h) and per frame. In the race,
+// F11 shows them in the hud and F12 starts/stops writing every frame
+// to glstats.csv in the config directory.
+
+#ifndef GLSTATS_H
+#define GLSTATS_H
+
+#ifdef USE_GLSTATS
+
+#include <string>
+
+struct TGLCallStats {
+	unsigned int draws;
+	unsigned int primitives;
+	unsigned int vertices;
+	unsigned int states;	// enable/disable and other state changes
+	unsigned int binds;		// texture and buffer binds
+};
+
+void GLStatsNewFrame ();
+void GLStatsSetMode (int mode);
+void GLStatsSetForward (bool forward);
+const TGLCallStats& GLStatsLastFrame (int mode);
+void GLStatsToggleVisible ();
+void GLStatsToggleDump (const std::string& filename);
+void GLStatsDraw ();
+
+void glsDrawArrays (GLenum mode, GLint first, GLsizei count);
+void glsDrawElements (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices);
+void glsBindTexture (GLenum target, GLuint texture);
+void glsBindBuffer (GLenum target, GLuint buffer);
+void glsEnable (GLenum cap);
+void glsDisable (GLenum cap);
+void glsEnableClientState (GLenum array);
+void glsDisableClientState (GLenum array);
+void glsBlendFunc (GLenum sfactor, GLenum dfactor);
+void glsDepthMask (GLboolean flag);
+void glsDepthFunc (GLenum func);
+void glsShadeModel (GLenum mode);
+void glsAlphaFunc (GLenum func, GLclampf ref);
+
+#ifndef GLSTATS_IMPL
+#define glDrawArrays glsDrawArrays
+#define glDrawElements glsDrawElements
+#define glBindTexture glsBindTexture
+#define glBindBuffer glsBindBuffer
+#define glEnable glsEnable
+#define glDisable glsDisable
+#define glEnableClientState glsEnableClientState
+#define glDisableClientState glsDisableClientState
+#define glBlendFunc glsBlendFunc
+#define glDepthMask glsDepthMask
+#define glDepthFunc glsDepthFunc
+#define glShadeModel glsShadeModel
+#define glAlphaFunc glsAlphaFunc
+#endif
+
+#define GLSTATS_NEW_FRAME() GLStatsNewFrame ()
+#define GLSTATS_SET_MODE(mode) GLStatsSetMode (mode)
+#define GLSTATS_DRAW() GLStatsDraw ()
+
+#else
+
+#define GLSTATS_NEW_FRAME()
+#define GLSTATS_SET_MODE(mode)
+#define GLSTATS_DRAW()
+
+#endif // USE_GLSTATS
+
+#endif
@@ -28,6 +28,7 @@ GNU General Public License for more details.
 #include "course.h"
 #include "physics.h"
 #include "winsys.h"
+#include "profiler.h"
 
 
 #define GAUGE_IMG_SIZE 128
@@ -480,4 +481,6 @@ void DrawHud (const CControl *ctrl) {
 	DrawFps ();
 	DrawCoursePosition (ctrl);
 	DrawWind (Wind.Angle (), Wind.Speed (), ctrl);
+	PROFILE_DRAW ();
+	GLSTATS_DRAW ();
 }
@@ -30,6 +30,7 @@ GNU General Public License for more details.
 #include "game_ctrl.h"
 #include "physics.h"
 #include <cstring>
+#include <fstream>
 
 static const int numJoints = 19;
 
@@ -57,6 +58,7 @@ CKeyframe::CKeyframe () {
 	keytime = 0;
 	active = false;
 	loaded = false;
+	useCompiled = true;
 	heightcorr = 0;
 	keyidx = 0;
 }
@@ -67,8 +69,8 @@ ETR_DOUBLE CKeyframe::interp (ETR_DOUBLE frac, ETR_DOUBLE v1, ETR_DOUBLE v2) {
 
 void CKeyframe::Init (const TVector3d& ref_position, ETR_DOUBLE height_correction) {
 	if (!loaded) return;
-	g_game.character->shape->ResetNode("head");
-	g_game.character->shape->ResetNode("neck");
+	g_game.character->shape->ResetJoint (JOINT_HEAD);
+	g_game.character->shape->ResetJoint (JOINT_NECK);
 	refpos = ref_position;
 	heightcorr = height_correction;
 	active = true;
@@ -78,8 +80,8 @@ void CKeyframe::Init (const TVector3d& ref_position, ETR_DOUBLE height_correctio
 
 void CKeyframe::Init (const TVector3d& ref_position, ETR_DOUBLE height_correction, CCharShape *shape) {
 	if (!loaded) return;
-	shape->ResetNode ("head");
-	shape->ResetNode ("neck");
+	shape->ResetJoint (JOINT_HEAD);
+	shape->ResetJoint (JOINT_NECK);
 	refpos = ref_position;
 	heightcorr = height_correction;
 	active = true;
@@ -90,8 +92,8 @@ void CKeyframe::Init (const TVector3d& ref_position, ETR_DOUBLE height_correctio
 
 void CKeyframe::InitTest (const TVector3d& ref_position, CCharShape *shape) {
 	if (!loaded) return;
-	shape->ResetNode ("head");
-	shape->ResetNode ("neck");
+	shape->ResetJoint (JOINT_HEAD);
+	shape->ResetJoint (JOINT_NECK);
 	refpos = ref_position;
 	heightcorr = 0.0;
 	active = true;
@@ -107,40 +109,133 @@ void CKeyframe::Reset () {
 	frames.clear();
 }
 
+class CKeyframeVisitor : public CSPVisitor {
+	vector<TKeyframe>& frames;
+	CSPLine line;
+public:
+	CKeyframeVisitor (vector<TKeyframe>& f) : frames(f) {}
+	void Visit (const char *s, size_t len) {
+		line.Parse (s, len);
+		frames.push_back (TKeyframe());
+		TKeyframe& frame = frames.back();
+		frame.val[0] = line.Float ("time", 0);
+		TVector3d posit = line.Vector3 ("pos");
+		frame.val[1] = posit.x;
+		frame.val[2] = posit.y;
+		frame.val[3] = posit.z;
+		frame.val[4] = line.Float ("yaw", 0);
+		frame.val[5] = line.Float ("pitch", 0);
+		frame.val[6] = line.Float ("roll", 0);
+		frame.val[7] = line.Float ("neck", 0);
+		frame.val[8] = line.Float ("head", 0);
+		TVector2d pp = line.Vector2 ("sh");
+		frame.val[9] = pp.x;
+		frame.val[10] = pp.y;
+		pp = line.Vector2 ("arm");
+		frame.val[11] = pp.x;
+		frame.val[12] = pp.y;
+		pp = line.Vector2 ("hip");
+		frame.val[13] = pp.x;
+		frame.val[14] = pp.y;
+		pp = line.Vector2 ("knee");
+		frame.val[15] = pp.x;
+		frame.val[16] = pp.y;
+		pp = line.Vector2 ("ankle");
+		frame.val[17] = pp.x;
+		frame.val[18] = pp.y;
+	}
+};
+
+// --------------------------------------------------------------------
+//				compiled keyframes
+// --------------------------------------------------------------------
+// "start.lst" is compiled to "start.pak": a header followed by the
+// frames as they are in memory, so loading is a single read. The file
+// is only used if it was written from the current text file by a build
+// with the same ETR_DOUBLE and MAX_FRAME_VALUES. The header has only
+// fixed-width fields, with the stamps 8-byte aligned, so it has the same
+// layout on 32 and 64 bit systems.
+
+#define FRAMES_MAGIC 0x4b525445	// "ETRK"
+#define FRAMES_VERSION 2
+
+struct TFramesHeader {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 header_size;
+	Uint32 real_size;
+	Uint32 num_values;
+	Uint32 num_frames;
+	Sint64 stamps[2];		// mtime and size of the text file
+};
+
+static bool FillFramesHeader (TFramesHeader& hdr, const string& textfile) {
+	memset (&hdr, 0, sizeof(hdr));
+	hdr.magic = FRAMES_MAGIC;
+	hdr.version = FRAMES_VERSION;
+	hdr.header_size = sizeof(TFramesHeader);
+	hdr.real_size = sizeof(ETR_DOUBLE);
+	hdr.num_values = MAX_FRAME_VALUES;
+	return FileStat (textfile, &hdr.stamps[0], &hdr.stamps[1]);
+}
+
+bool CKeyframe::LoadCompiled (const string& dir, const string& filename) {
+	string pakfile = dir + SEP + CompiledName (filename);
+	if (!FileExists (pakfile)) return false;
+
+	TFramesHeader expected;
+	if (!FillFramesHeader (expected, dir + SEP + filename)) return false;
+
+	CMappedFile file;
+	if (!file.Open (pakfile)) return false;
+	const TFramesHeader* hdr = (const TFramesHeader*)file.Data();
+	if (file.Size() < sizeof(TFramesHeader)
+	        || hdr->magic != expected.magic
+	        || hdr->version != expected.version
+	        || hdr->header_size != expected.header_size
+	        || hdr->real_size != expected.real_size
+	        || hdr->num_values != expected.num_values
+	        || memcmp (hdr->stamps, expected.stamps, sizeof(expected.stamps)) != 0
+	        || file.Size() != sizeof(TFramesHeader) + hdr->num_frames * sizeof(TKeyframe)) {
+		Message ("compiled keyframes are out of date", pakfile);
+		return false;
+	}
+
+	const TKeyframe* data = (const TKeyframe*)(file.Data() + sizeof(TFramesHeader));
+	frames.assign (data, data + hdr->num_frames);
+	return true;
+}
+
+bool CKeyframe::SaveCompiled (const string& dir, const string& filename) const {
+	TFramesHeader hdr;
+	if (!FillFramesHeader (hdr, dir + SEP + filename)) return false;
+	hdr.num_frames = frames.size();
+
+	string pakfile = dir + SEP + CompiledName (filename);
+	ofstream file (pakfile.c_str(), ios::out | ios::binary);
+	if (file) {
+		file.write ((const char*)&hdr, sizeof(hdr));
+		if (!frames.empty())
+			file.write ((const char*)&frames[0], frames.size() * sizeof(TKeyframe));
+	}
+	if (!file) {
+		Message ("could not write compiled keyframes", pakfile);
+		return false;
+	}
+	return true;
+}
+
 bool CKeyframe::Load (const string& dir, const string& filename) {
 	if (loaded && loadedfile == filename) return true;
-	CSPList list (1000);
-
-	if (list.Load (dir, filename)) {
-		frames.resize(list.Count());
-		for (size_t i=0; i<list.Count(); i++) {
-			const string& line = list.Line(i);
-			frames[i].val[0] = SPFloatN (line, "time", 0);
-			TVector3d posit = SPVector3d(line, "pos");
-			frames[i].val[1] = posit.x;
-			frames[i].val[2] = posit.y;
-			frames[i].val[3] = posit.z;
-			frames[i].val[4] = SPFloatN (line, "yaw", 0);
-			frames[i].val[5] = SPFloatN (line, "pitch", 0);
-			frames[i].val[6] = SPFloatN (line, "roll", 0);
-			frames[i].val[7] = SPFloatN (line, "neck", 0);
-			frames[i].val[8] = SPFloatN (line, "head", 0);
-			TVector2d pp = SPVector2d(line, "sh");
-			frames[i].val[9] = pp.x;
-			frames[i].val[10] = pp.y;
-			pp = SPVector2d(line, "arm");
-			frames[i].val[11] = pp.x;
-			frames[i].val[12] = pp.y;
-			pp = SPVector2d(line, "hip");
-			frames[i].val[13] = pp.x;
-			frames[i].val[14] = pp.y;
-			pp = SPVector2d(line, "knee");
-			frames[i].val[15] = pp.x;
-			frames[i].val[16] = pp.y;
-			pp = SPVector2d(line, "ankle");
-			frames[i].val[17] = pp.x;
-			frames[i].val[18] = pp.y;
-		}
+
+	frames.clear();
+	if (useCompiled && LoadCompiled (dir, filename)) {
+		loaded = true;
+		loadedfile = filename;
+		return true;
+	}
+	CKeyframeVisitor visitor (frames);
+	if (CSPList::Stream (dir, filename, visitor)) {
 		loaded = true;
 		loadedfile = filename;
 		return true;
@@ -154,56 +249,31 @@ bool CKeyframe::Load (const string& dir, const string& filename) {
 // there are more possibilities for rotating the parts of the body,
 // that will be implemented later
 
-void CKeyframe::InterpolateKeyframe (size_t idx, ETR_DOUBLE frac, CCharShape *shape) {
-	ETR_DOUBLE vv;
-	vv = interp (frac, frames[idx].val[4], frames[idx+1].val[4]);
-	shape->RotateNode ("root", 2, vv);
-
-	vv = interp (frac, frames[idx].val[5], frames[idx+1].val[5]);
-	shape->RotateNode ("root", 1, vv);
-
-	vv = interp (frac, frames[idx].val[6], frames[idx+1].val[6]);
-	shape->RotateNode ("root", 3, vv);
-
-	vv = interp (frac, frames[idx].val[7], frames[idx+1].val[7]);
-	shape->RotateNode ("neck", 3, vv);
-
-	vv = interp (frac, frames[idx].val[8], frames[idx+1].val[8]);
-	shape->RotateNode ("head", 2, vv);
-
-	vv = interp (frac, frames[idx].val[9], frames[idx+1].val[9]);
-	shape->RotateNode ("left_shldr", 3, vv);
-
-	vv = interp (frac, frames[idx].val[10], frames[idx+1].val[10]);
-	shape->RotateNode ("right_shldr", 3, vv);
-
-	vv = interp (frac, frames[idx].val[11], frames[idx+1].val[11]);
-	shape->RotateNode ("left_shldr", 2, vv);
-
-	vv = interp (frac, frames[idx].val[12], frames[idx+1].val[12]);
-	shape->RotateNode ("right_shldr", 2, vv);
-
-	vv = interp (frac, frames[idx].val[13], frames[idx+1].val[13]);
-	shape->RotateNode ("left_hip", 3, vv);
-
-	vv = interp (frac, frames[idx].val[14], frames[idx+1].val[14]);
-	shape->RotateNode ("right_hip", 3, vv);
-
-	vv = interp (frac, frames[idx].val[15], frames[idx+1].val[15]);
-	shape->RotateNode ("left_knee", 3, vv);
-
-	vv = interp (frac, frames[idx].val[16], frames[idx+1].val[16]);
-	shape->RotateNode ("right_knee", 3, vv);
-
-	vv = interp (frac, frames[idx].val[17], frames[idx+1].val[17]);
-	shape->RotateNode ("left_ankle", 3, vv);
+void CKeyframe::FramePose (const TKeyframe& k1, const TKeyframe& k2, ETR_DOUBLE frac, TCharPose& pose) {
+	pose.rot[JOINT_ROOT].y = interp (frac, k1.val[4], k2.val[4]);
+	pose.rot[JOINT_ROOT].x = interp (frac, k1.val[5], k2.val[5]);
+	pose.rot[JOINT_ROOT].z = interp (frac, k1.val[6], k2.val[6]);
+	pose.rot[JOINT_NECK].z = interp (frac, k1.val[7], k2.val[7]);
+	pose.rot[JOINT_HEAD].y = interp (frac, k1.val[8], k2.val[8]);
+	pose.rot[JOINT_LEFT_SHLDR].z = interp (frac, k1.val[9], k2.val[9]);
+	pose.rot[JOINT_RIGHT_SHLDR].z = interp (frac, k1.val[10], k2.val[10]);
+	pose.rot[JOINT_LEFT_SHLDR].y = interp (frac, k1.val[11], k2.val[11]);
+	pose.rot[JOINT_RIGHT_SHLDR].y = interp (frac, k1.val[12], k2.val[12]);
+	pose.rot[JOINT_LEFT_HIP].z = interp (frac, k1.val[13], k2.val[13]);
+	pose.rot[JOINT_RIGHT_HIP].z = interp (frac, k1.val[14], k2.val[14]);
+	pose.rot[JOINT_LEFT_KNEE].z = interp (frac, k1.val[15], k2.val[15]);
+	pose.rot[JOINT_RIGHT_KNEE].z = interp (frac, k1.val[16], k2.val[16]);
+	pose.rot[JOINT_LEFT_ANKLE].z = interp (frac, k1.val[17], k2.val[17]);
+	pose.rot[JOINT_RIGHT_ANKLE].z = interp (frac, k1.val[18], k2.val[18]);
+}
 
-	vv = interp (frac, frames[idx].val[18], frames[idx+1].val[18]);
-	shape->RotateNode ("right_ankle", 3, vv);
+void CKeyframe::InterpolateKeyframe (size_t idx, ETR_DOUBLE frac, CCharShape *shape) {
+	TCharPose pose;
+	FramePose (frames[idx], frames[idx+1], frac, pose);
+	shape->SetPose (pose);
 }
 
 void CKeyframe::CalcKeyframe (size_t idx, CCharShape *shape, const TVector3d& refpos) {
-	ETR_DOUBLE vv;
 	TVector3d pos;
 
 	pos.x = frames[idx].val[1] + refpos.x;
@@ -211,53 +281,11 @@ void CKeyframe::CalcKeyframe (size_t idx, CCharShape *shape, const TVector3d& re
 	pos.y = refpos.y;
 
 	shape->ResetRoot ();
-	shape->ResetJoints ();
 	shape->TranslateNode (0, pos);
 
-	vv = frames[idx].val[4];
-	shape->RotateNode ("root", 2, vv);
-
-	vv = frames[idx].val[5];
-	shape->RotateNode ("root", 1, vv);
-
-	vv = frames[idx].val[6];
-	shape->RotateNode ("root", 3, vv);
-
-	vv = frames[idx].val[7];
-	shape->RotateNode ("neck", 3, vv);
-
-	vv = frames[idx].val[8];
-	shape->RotateNode ("head", 2, vv);
-
-	vv = frames[idx].val[9];
-	shape->RotateNode ("left_shldr", 3, vv);
-
-	vv = frames[idx].val[10];
-	shape->RotateNode ("right_shldr", 3, vv);
-
-	vv = frames[idx].val[11];
-	shape->RotateNode ("left_shldr", 2, vv);
-
-	vv = frames[idx].val[12];
-	shape->RotateNode ("right_shldr", 2, vv);
-
-	vv = frames[idx].val[13];
-	shape->RotateNode ("left_hip", 3, vv);
-
-	vv = frames[idx].val[14];
-	shape->RotateNode ("right_hip", 3, vv);
-
-	vv = frames[idx].val[15];
-	shape->RotateNode ("left_knee", 3, vv);
-
-	vv = frames[idx].val[16];
-	shape->RotateNode ("right_knee", 3, vv);
-
-	vv = frames[idx].val[17];
-	shape->RotateNode ("left_ankle", 3, vv);
-
-	vv = frames[idx].val[18];
-	shape->RotateNode ("right_ankle", 3, vv);
+	TCharPose pose;
+	FramePose (frames[idx], frames[idx], 1.0, pose);
+	shape->SetPose (pose);
 }
 
 void CKeyframe::Update () {
@@ -288,7 +316,6 @@ void CKeyframe::Update () {
 	pos.y += Course.FindYCoord (pos.x, pos.z);
 
 	shape->ResetRoot ();
-	shape->ResetJoints ();
 
 	g_game.player->ctrl->cpos = pos;
 	ETR_DOUBLE disp_y = pos.y + TUX_Y_CORR + heightcorr;
@@ -322,7 +349,6 @@ void CKeyframe::UpdateTest (ETR_DOUBLE timestep, CCharShape *shape) {
 	pos.y = interp (frac, frames[keyidx].val[2], frames[keyidx+1].val[2]);
 
 	shape->ResetRoot ();
-	shape->ResetJoints ();
 	shape->TranslateNode (0, pos);
 	InterpolateKeyframe (keyidx, frac, shape);
 }
@@ -337,6 +363,11 @@ TKeyframe *CKeyframe::GetFrame (size_t idx) {
 	return &frames[idx];
 }
 
+const TKeyframe *CKeyframe::GetFrame (size_t idx) const {
+	if (idx >= frames.size()) return NULL;
+	return &frames[idx];
+}
+
 const string& CKeyframe::GetJointName (size_t idx) {
 	if (idx >= numJoints) return emptyString;
 	return jointnames[idx];
@@ -24,6 +24,7 @@ GNU General Public License for more details.
 #define MAX_FRAME_VALUES 32
 
 class CCharShape;
+struct TCharPose;
 
 struct TKeyframe {
 	ETR_DOUBLE val[MAX_FRAME_VALUES];
@@ -40,7 +41,9 @@ private:
 	size_t keyidx;
 
 	ETR_DOUBLE interp (ETR_DOUBLE frac, ETR_DOUBLE v1, ETR_DOUBLE v2);
+	void FramePose (const TKeyframe& k1, const TKeyframe& k2, ETR_DOUBLE frac, TCharPose& pose);
 	void InterpolateKeyframe (size_t idx, ETR_DOUBLE frac, CCharShape *shape);
+	bool LoadCompiled (const string& dir, const string& filename);
 
 	// test and editing
 	void ResetFrame2 (TKeyframe *frame);
@@ -48,6 +51,7 @@ public:
 	CKeyframe ();
 	bool loaded;
 	bool active;
+	bool useCompiled;	// try the .pak file before the text file
 
 	void Init (const TVector3d& ref_position, ETR_DOUBLE height_correction);
 	void Init (const TVector3d& ref_position, ETR_DOUBLE height_correction, CCharShape *shape);
@@ -56,10 +60,12 @@ public:
 	void Update ();
 	void UpdateTest (ETR_DOUBLE timestep, CCharShape *shape);
 	bool Load (const string& dir, const string& filename);
+	bool SaveCompiled (const string& dir, const string& filename) const;
 	void CalcKeyframe (size_t idx, CCharShape *shape, const TVector3d& refpos);
 
 	// test and editing
 	TKeyframe *GetFrame (size_t idx);
+	const TKeyframe *GetFrame (size_t idx) const;
 	static const string& GetHighlightName (size_t idx);
 	static const string& GetJointName (size_t idx);
 	static int GetNumJoints ();
@@ -34,10 +34,19 @@ GNU General Public License for more details.
 
 CLoading Loading;
 
+// The course data is loaded on a worker thread while the loading screen
+// keeps animating, textures and gl state are done here afterwards.
+enum {
+	LOAD_START,
+	LOAD_DATA,
+	LOAD_FINISHED
+};
+
 // ====================================================================
 void CLoading::Enter() {
 	Winsys.ShowCursor (false);
 	Music.Play ("loading", -1);
+	stage = LOAD_START;
 }
 
 void CLoading::Loop() {
@@ -67,14 +76,33 @@ void CLoading::Loop() {
 	FT.DrawString (CENTER, AutoYPosN (60), msg);
 	FT.SetColor (colWhite);
 	FT.DrawString (CENTER, AutoYPosN (70), Trans.Text (30));
+
+	int barw = ww / 3;
+	int barh = FT.AutoDistanceN (2);
+	int bary = AutoYPosN (80);
+	int progress = stage == LOAD_START ? 0 : Course.LoadingProgress ();
+	DrawFrameX (-1, bary, barw, barh, 2, colBackgr, colWhite, 1.0);
+	if (progress > 0)
+		DrawFrameX ((ww - barw) / 2, bary, barw * progress / 100, barh, 0, colDYell, colDYell, 1.0);
 	Winsys.SwapBuffers ();
 
-	Course.LoadCourse (g_game.course);
-	g_game.location_id = Course.GetEnv ();
-	Env.LoadEnvironment (g_game.location_id, g_game.light_id);
-	State::manager.RequestEnterState (Intro);
+	switch (stage) {
+		case LOAD_START:	// the loading screen is visible now
+			Course.StartLoading (g_game.course);
+			stage = LOAD_DATA;
+			break;
+		case LOAD_DATA:
+			if (!Course.LoadingDone ()) break;
+			Course.FinishLoading ();
+			g_game.location_id = Course.GetEnv ();
+			Env.LoadEnvironment (g_game.location_id, g_game.light_id);
+			stage = LOAD_FINISHED;
+			State::manager.RequestEnterState (Intro);
+			break;
+	}
 }
 
 void CLoading::Exit() {
+	if (stage == LOAD_DATA) Course.FinishLoading ();	// quit while loading
 	Music.Halt ();
 }
@@ -22,10 +22,13 @@ GNU General Public License for more details.
 #define LOADING_H
 
 class CLoading : public State {
+	int stage;
+
 	void Enter();
 	void Loop();
 	void Exit();
 public:
+	CLoading() : stage(0) {}
 };
 
 extern CLoading Loading;
@@ -28,21 +28,81 @@ GNU General Public License for more details.
 #include "tools.h"
 #include "ogl_test.h"
 #include "winsys.h"
+#include "benchmark.h"
+#include "course.h"
+#include "env.h"
+#include "game_ctrl.h"
+#include "replay.h"
 #include <iostream>
 #include <ctime>
 
 TGameData g_game;
 
+// "window", "offscreen" or "null" after --benchmark and --replay. The
+// null backend only counts the gl calls, which needs the wrappers of
+// glstats.h.
+static void SetVideoBackend (const string& backend) {
+	if (backend == "window") Winsys.SetBackend (VIDEO_WINDOW);
+	else if (backend == "null") {
+#ifdef USE_GLSTATS
+		Winsys.SetBackend (VIDEO_NULL);
+#else
+		Message ("the null backend needs a build with -DUSE_GLSTATS");
+		exit (1);
+#endif
+	} else Winsys.SetBackend (VIDEO_OFFSCREEN);
+}
+
 void InitGame (int argc, char **argv) {
 	g_game.toolmode = NONE;
-	g_game.argument = 0;
-	if (argc == 4) {
+	g_game.argument = RUN_GAME;
+	if (argc == 4 && string (argv[1]) == "--replay") {
+		g_game.argument = RUN_BENCHMARK;
+		Benchmark.SetReplay (argv[2]);
+		SetVideoBackend (argv[3]);
+	} else if (argc == 4) {
 		string group_arg = argv[1];
-		if (group_arg == "--char") g_game.argument = 4;
+		if (group_arg == "--char") g_game.argument = RUN_CHAR_TOOL;
 		Tools.SetParameter(argv[2], argv[3]);
-	} else if (argc == 2) {
+	} else if (argc == 3 && string (argv[1]) == "--record") {
+		Replay.SetRecordFile (argv[2]);
+	} else if (argc == 3 && string (argv[1]) == "--replay") {
+		g_game.argument = RUN_BENCHMARK;
+		Benchmark.SetReplay (argv[2]);
+		Winsys.SetBackend (VIDEO_OFFSCREEN);
+	} else if (argc == 2 || argc == 3) {
 		string group_arg = argv[1];
-		if (group_arg == "9") g_game.argument = 9;
+		if (group_arg == "9") g_game.argument = RUN_OGL_TEST;
+		else if (group_arg == "--benchmark-parse") {
+			g_game.argument = RUN_BENCHMARK_PARSE;
+			Winsys.SetBackend (VIDEO_OFFSCREEN);
+		} else if (group_arg == "--compile-courses") {
+			g_game.argument = RUN_COMPILE_COURSES;
+			Winsys.SetBackend (VIDEO_OFFSCREEN);
+		} else if (group_arg == "--compile-chars") {
+			g_game.argument = RUN_COMPILE_CHARS;
+			Winsys.SetBackend (VIDEO_OFFSCREEN);
+		} else if (group_arg == "--benchmark-normals") {
+			g_game.argument = RUN_BENCHMARK_NORMALS;
+			Winsys.SetBackend (VIDEO_OFFSCREEN);
+		} else if (group_arg == "--benchmark-pose") {
+			g_game.argument = RUN_BENCHMARK_POSE;
+			Winsys.SetBackend (VIDEO_OFFSCREEN);
+		} else if (group_arg == "--benchmark-affine") {
+			g_game.argument = RUN_BENCHMARK_AFFINE;
+			Winsys.SetBackend (VIDEO_OFFSCREEN);
+		} else if (group_arg == "--benchmark-simd") {
+			g_game.argument = RUN_BENCHMARK_SIMD;
+			Winsys.SetBackend (VIDEO_OFFSCREEN);
+		} else if (group_arg == "--benchmark-instances") {
+			g_game.argument = RUN_BENCHMARK_INSTANCES;
+			if (argc == 3 && string (argv[2]) == "window") Winsys.SetBackend (VIDEO_WINDOW);
+			else Winsys.SetBackend (VIDEO_OFFSCREEN);
+		} else if (group_arg == "--benchmark") {
+			// headless by default, the benchmark is meant for machines without a GPU
+			g_game.argument = RUN_BENCHMARK;
+			SetVideoBackend (argc == 3 ? argv[2] : "offscreen");
+		}
 	}
 
 	g_game.player = NULL;
@@ -93,21 +153,63 @@ int main( int argc, char **argv ) {
 	Music.LoadMusicList ();
 	Music.SetVolume (param.music_volume);
 
+	int result = 0;
 	switch (g_game.argument) {
-		case 0:
+		case RUN_GAME:
 			State::manager.Run(SplashScreen);
 			break;
-		case 4:
+		case RUN_CHAR_TOOL:
 			g_game.toolmode = TUXSHAPE;
 			State::manager.Run(Tools);
 			break;
-		case 9:
+		case RUN_BENCHMARK_PARSE:
+			BenchmarkParser ();
+			break;
+		case RUN_COMPILE_COURSES:
+			// writes course.pak for every course, see CCourse::LoadPackage
+			Sound.LoadSoundList ();
+			Course.LoadObjectTypes ();
+			Course.LoadTerrainTypes ();
+			Env.LoadEnvironmentList ();
+			Course.LoadCourseList ();
+			Course.CompilePackages ();
+			break;
+		case RUN_BENCHMARK_NORMALS:
+			// compares CCourse::CalcNormals with the reference version
+			Sound.LoadSoundList ();
+			Course.LoadObjectTypes ();
+			Course.LoadTerrainTypes ();
+			Env.LoadEnvironmentList ();
+			Course.LoadCourseList ();
+			Course.BenchmarkNormals ();
+			break;
+		case RUN_BENCHMARK:
+			State::manager.Run(Benchmark);
+			break;
+		case RUN_OGL_TEST:
 			State::manager.Run(OglTest);
 			break;
+		case RUN_BENCHMARK_POSE:
+			BenchmarkPose ();
+			break;
+		case RUN_BENCHMARK_AFFINE:
+			if (!BenchmarkAffine ()) result = 1;
+			break;
+		case RUN_COMPILE_CHARS:
+			// writes shape.pak and the keyframe .pak files of every character
+			Char.LoadCharacterList ();
+			if (!Char.CompileCharacters ()) result = 1;
+			break;
+		case RUN_BENCHMARK_INSTANCES:
+			BenchmarkInstances ();
+			break;
+		case RUN_BENCHMARK_SIMD:
+			if (!BenchmarkSimd ()) result = 1;
+			break;
 	}
 
 	Winsys.Quit();
 	DeleteGlobalVBO();
 
-	return 0;
+	return result;
 }
@@ -21,6 +21,7 @@ GNU General Public License for more details.
 #endif
 
 #include "mathlib.h"
+#include "simd.h"
 #include <cstdlib>
 #include <algorithm>
 
@@ -33,7 +34,7 @@ TVector3d ProjectToPlane (const TVector3d& nml, const TVector3d& v) {
 }
 
 
-TVector3d TransformVector(const TMatrix<4, 4>& mat, const TVector3d& v) {
+TVector3d TransformVectorScalar(const TMatrix<4, 4>& mat, const TVector3d& v) {
 	TVector3d r;
 	r.x = v.x * mat[0][0] + v.y * mat[1][0] + v.z * mat[2][0];
 	r.y = v.x * mat[0][1] + v.y * mat[1][1] + v.z * mat[2][1];
@@ -49,7 +50,7 @@ TVector3d TransformNormal(const TVector3d& n, const TMatrix<4, 4>& mat) {
 	return r;
 }
 
-TVector3d TransformPoint(const TMatrix<4, 4>& mat, const TVector3d& p) {
+TVector3d TransformPointScalar(const TMatrix<4, 4>& mat, const TVector3d& p) {
 	TVector3d r;
 	r.x = p.x * mat[0][0] + p.y * mat[1][0] + p.z * mat[2][0];
 	r.y = p.x * mat[0][1] + p.y * mat[1][1] + p.z * mat[2][1];
@@ -60,6 +61,50 @@ TVector3d TransformPoint(const TMatrix<4, 4>& mat, const TVector3d& p) {
 	return r;
 }
 
+TVector3d TransformVector(const TAffine& mat, const TVector3d& v) {
+	return TVector3d(
+	           mat[0][0] * v.x + mat[0][1] * v.y + mat[0][2] * v.z,
+	           mat[1][0] * v.x + mat[1][1] * v.y + mat[1][2] * v.z,
+	           mat[2][0] * v.x + mat[2][1] * v.y + mat[2][2] * v.z);
+}
+
+TVector3d TransformPoint(const TAffine& mat, const TVector3d& p) {
+	return TVector3d(
+	           mat[0][0] * p.x + mat[0][1] * p.y + mat[0][2] * p.z + mat[0][3],
+	           mat[1][0] * p.x + mat[1][1] * p.y + mat[1][2] * p.z + mat[1][3],
+	           mat[2][0] * p.x + mat[2][1] * p.y + mat[2][2] * p.z + mat[2][3]);
+}
+
+#ifdef ETR_SIMD
+// The rows of TMatrix<4, 4> are the images of the axes. TAffine keeps
+// the scalar code: its rows are dot products, and neither gathering the
+// columns nor a transpose of the row products was faster.
+TVector3d TransformVector(const TMatrix<4, 4>& mat, const TVector3d& v) {
+	TSimd4 r = Simd4Add (Simd4Add (
+	               Simd4Mul (Simd4Splat (v.x), Simd4Load (mat[0])),
+	               Simd4Mul (Simd4Splat (v.y), Simd4Load (mat[1]))),
+	           Simd4Mul (Simd4Splat (v.z), Simd4Load (mat[2])));
+	return Simd4Vector3 (r);
+}
+
+TVector3d TransformPoint(const TMatrix<4, 4>& mat, const TVector3d& p) {
+	TSimd4 r = Simd4Add (Simd4Add (Simd4Add (
+	               Simd4Mul (Simd4Splat (p.x), Simd4Load (mat[0])),
+	               Simd4Mul (Simd4Splat (p.y), Simd4Load (mat[1]))),
+	           Simd4Mul (Simd4Splat (p.z), Simd4Load (mat[2]))),
+	           Simd4Load (mat[3]));
+	return Simd4Vector3 (r);
+}
+#else
+TVector3d TransformVector(const TMatrix<4, 4>& mat, const TVector3d& v) {
+	return TransformVectorScalar (mat, v);
+}
+
+TVector3d TransformPoint(const TMatrix<4, 4>& mat, const TVector3d& p) {
+	return TransformPointScalar (mat, p);
+}
+#endif
+
 bool IntersectPlanes (const TPlane& s1, const TPlane& s2, const TPlane& s3, TVector3d *p) {
 	ETR_DOUBLE A[3][4];
 	ETR_DOUBLE x[3];
@@ -151,7 +196,7 @@ TMatrix<4, 4> RotateAboutVectorMatrix(const TVector3d& u, ETR_DOUBLE angle) {
 	return mat;
 }
 
-TQuaternion MultiplyQuaternions (const TQuaternion& q, const TQuaternion& r) {
+TQuaternion MultiplyQuaternionsScalar (const TQuaternion& q, const TQuaternion& r) {
 	TQuaternion res;
 	res.x = q.y * r.z - q.z * r.y + r.w * q.x + q.w * r.x;
 	res.y = q.z * r.x - q.x * r.z + r.w * q.y + q.w * r.y;
@@ -160,6 +205,33 @@ TQuaternion MultiplyQuaternions (const TQuaternion& q, const TQuaternion& r) {
 	return res;
 }
 
+#ifdef ETR_SIMD
+// The components of TVector4 lie one after the other, so a quaternion
+// is loaded as it is.
+static inline TSimd4 LoadQuaternion (const TQuaternion& q) {
+	return Simd4Load (&q.x);
+}
+
+// The lanes of the four products line up with the terms of the scalar
+// version; w subtracts its last two terms as negated products.
+static inline TSimd4 MultiplyQuaternions4 (TSimd4 q, TSimd4 r) {
+	const TSimd4 sign = Simd4Set (1, 1, 1, -1);
+	TSimd4 a = Simd4Mul (Simd4Swizzle (q, 1, 2, 0, 3), Simd4Swizzle (r, 2, 0, 1, 3));
+	TSimd4 b = Simd4Mul (Simd4Swizzle (q, 2, 0, 1, 0), Simd4Swizzle (r, 1, 2, 0, 0));
+	TSimd4 c = Simd4Mul (Simd4Mul (Simd4Swizzle (r, 3, 3, 3, 1), Simd4Swizzle (q, 0, 1, 2, 1)), sign);
+	TSimd4 d = Simd4Mul (Simd4Mul (Simd4Swizzle (q, 3, 3, 3, 2), Simd4Swizzle (r, 0, 1, 2, 2)), sign);
+	return Simd4Add (Simd4Add (Simd4Sub (a, b), c), d);
+}
+
+TQuaternion MultiplyQuaternions (const TQuaternion& q, const TQuaternion& r) {
+	return Simd4Vector4 (MultiplyQuaternions4 (LoadQuaternion (q), LoadQuaternion (r)));
+}
+#else
+TQuaternion MultiplyQuaternions (const TQuaternion& q, const TQuaternion& r) {
+	return MultiplyQuaternionsScalar (q, r);
+}
+#endif
+
 TQuaternion ConjugateQuaternion (const TQuaternion& q) {
 	TQuaternion res(
 	    -1 * q.x,
@@ -170,7 +242,7 @@ TQuaternion ConjugateQuaternion (const TQuaternion& q) {
 	return res;
 }
 
-TMatrix<4, 4> MakeMatrixFromQuaternion(const TQuaternion& q) {
+TMatrix<4, 4> MakeMatrixFromQuaternionScalar(const TQuaternion& q) {
 	TMatrix<4, 4> mat;
 	mat[0][0] = 1.0 - 2.0 *  (q.y * q.y + q.z * q.z);
 	mat[1][0] =       2.0 *  (q.x * q.y - q.w * q.z);
@@ -190,6 +262,38 @@ TMatrix<4, 4> MakeMatrixFromQuaternion(const TQuaternion& q) {
 	return mat;
 }
 
+#ifdef ETR_SIMD
+// Row i is base + sign * 2 * (a * b + c * d), the sign of the second
+// product is folded into d. The lanes 3 are multiplied by 0.
+static inline TSimd4 QuaternionRow (TSimd4 a, TSimd4 b, TSimd4 c, TSimd4 d, TSimd4 base, TSimd4 sign) {
+	TSimd4 t = Simd4Mul (Simd4Splat (2.0), Simd4Add (Simd4Mul (a, b), Simd4Mul (c, d)));
+	return Simd4Add (base, Simd4Mul (sign, t));
+}
+
+TMatrix<4, 4> MakeMatrixFromQuaternion(const TQuaternion& q) {
+	TMatrix<4, 4> mat;
+	TSimd4 v = LoadQuaternion (q);
+	Simd4Store (mat[0], QuaternionRow (
+	                Simd4Swizzle (v, 1, 0, 0, 3), Simd4Swizzle (v, 1, 1, 2, 3), Simd4Swizzle (v, 2, 3, 3, 3),
+	                Simd4Mul (Simd4Swizzle (v, 2, 2, 1, 3), Simd4Set (1, 1, -1, 0)),
+	                Simd4Set (1, 0, 0, 0), Simd4Set (-1, 1, 1, 0)));
+	Simd4Store (mat[1], QuaternionRow (
+	                Simd4Swizzle (v, 0, 0, 1, 3), Simd4Swizzle (v, 1, 0, 2, 3), Simd4Swizzle (v, 3, 2, 3, 3),
+	                Simd4Mul (Simd4Swizzle (v, 2, 2, 0, 3), Simd4Set (-1, 1, 1, 0)),
+	                Simd4Set (0, 1, 0, 0), Simd4Set (1, -1, 1, 0)));
+	Simd4Store (mat[2], QuaternionRow (
+	                Simd4Swizzle (v, 0, 1, 0, 3), Simd4Swizzle (v, 2, 2, 0, 3), Simd4Swizzle (v, 3, 3, 1, 3),
+	                Simd4Mul (Simd4Swizzle (v, 1, 0, 1, 3), Simd4Set (1, -1, 1, 0)),
+	                Simd4Set (0, 0, 1, 0), Simd4Set (1, 1, -1, 0)));
+	Simd4Store (mat[3], Simd4Set (0, 0, 0, 1));
+	return mat;
+}
+#else
+TMatrix<4, 4> MakeMatrixFromQuaternion(const TQuaternion& q) {
+	return MakeMatrixFromQuaternionScalar (q);
+}
+#endif
+
 TQuaternion MakeQuaternionFromMatrix(const TMatrix<4, 4>& m) {
 	TQuaternion res;
 	ETR_DOUBLE  tr, s, q[4];
@@ -276,16 +380,27 @@ TQuaternion InterpolateQuaternions (const TQuaternion& q, TQuaternion r, ETR_DOU
 	return scale0 * q + scale1 * r;
 }
 
-TVector3d RotateVector (const TQuaternion& q, const TVector3d& v) {
+TVector3d RotateVectorScalar (const TQuaternion& q, const TVector3d& v) {
 	TQuaternion p(v.x, v.y, v.z, 1.0);
 
 	TQuaternion qs(-q.x, -q.y, -q.z, q.w);
 
-	TQuaternion res_q = MultiplyQuaternions (q, MultiplyQuaternions (p, qs));
+	TQuaternion res_q = MultiplyQuaternionsScalar (q, MultiplyQuaternionsScalar (p, qs));
 
 	return res_q;
 }
 
+TVector3d RotateVector (const TQuaternion& q, const TVector3d& v) {
+#ifdef ETR_SIMD
+	TSimd4 p = Simd4Set (v.x, v.y, v.z, 1.0);
+	TSimd4 qv = LoadQuaternion (q);
+	TSimd4 qs = Simd4Mul (qv, Simd4Set (-1, -1, -1, 1));
+	return Simd4Vector3 (MultiplyQuaternions4 (qv, MultiplyQuaternions4 (p, qs)));
+#else
+	return RotateVectorScalar (q, v);
+#endif
+}
+
 // --------------------------------------------------------------------
 //				 Gauss
 // --------------------------------------------------------------------
@@ -436,6 +551,11 @@ void TransPolyhedron (const TMatrix<4, 4>& mat, TPolyhedron& ph) {
 		ph.vertices[i] = TransformPoint (mat, ph.vertices[i]);
 }
 
+void TransPolyhedron (const TAffine& mat, TPolyhedron& ph) {
+	for (size_t i = 0; i < ph.vertices.size(); i++)
+		ph.vertices[i] = TransformPoint (mat, ph.vertices[i]);
+}
+
 // --------------------------------------------------------------------
 //					ode solver
 // --------------------------------------------------------------------
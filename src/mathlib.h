@@ -50,6 +50,8 @@ TVector3d	ProjectToPlane(const TVector3d& nml, const TVector3d& v);
 TVector3d	TransformVector(const TMatrix<4, 4>& mat, const TVector3d& v);
 TVector3d	TransformNormal(const TVector3d& n, const TMatrix<4, 4>& mat);	// not used ?
 TVector3d	TransformPoint(const TMatrix<4, 4>& mat, const TVector3d& p);
+TVector3d	TransformVector(const TAffine& mat, const TVector3d& v);
+TVector3d	TransformPoint(const TAffine& mat, const TVector3d& p);
 bool		IntersectPlanes (const TPlane& s1, const TPlane& s2, const TPlane& s3, TVector3d *p);
 ETR_DOUBLE		DistanceToPlane (const TPlane& plane, const TVector3d& pt);
 
@@ -63,10 +65,20 @@ TQuaternion MakeRotationQuaternion (const TVector3d& s, const TVector3d& t);
 TQuaternion InterpolateQuaternions (const TQuaternion& q, TQuaternion r, ETR_DOUBLE t);
 TVector3d	RotateVector (const TQuaternion& q, const TVector3d& v);
 
+// The element by element versions of the functions that have SSE or
+// NEON code (see simd.h), for the checks of "etr --benchmark-simd".
+// MultiplyAffineScalar is in matrices.h.
+TVector3d	TransformVectorScalar(const TMatrix<4, 4>& mat, const TVector3d& v);
+TVector3d	TransformPointScalar(const TMatrix<4, 4>& mat, const TVector3d& p);
+TQuaternion MultiplyQuaternionsScalar (const TQuaternion& q, const TQuaternion& r);
+TMatrix<4, 4> MakeMatrixFromQuaternionScalar(const TQuaternion& q);
+TVector3d	RotateVectorScalar (const TQuaternion& q, const TVector3d& v);
+
 bool		IntersectPolygon (const TPolygon& p, vector<TVector3d>& v);
 bool		IntersectPolyhedron (TPolyhedron& p);
 TVector3d	MakeNormal (const TPolygon& p, const TVector3d *v);
 void		TransPolyhedron(const TMatrix<4, 4>& mat, TPolyhedron& ph);
+void		TransPolyhedron(const TAffine& mat, TPolyhedron& ph);
 
 // --------------------------------------------------------------------
 //				ode solver
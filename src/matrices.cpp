@@ -20,6 +20,7 @@ GNU General Public License for more details.
 
 #include "common.h"
 #include "matrices.h"
+#include "simd.h"
 #include <algorithm>
 
 
@@ -154,3 +155,202 @@ TMatrix<4, 4> operator*<4, 4>(const TMatrix<4, 4>& l, const TMatrix<4, 4>& r) {
 
 	return ret;
 }
+
+// --------------------------------------------------------------------
+//				TAffine
+// --------------------------------------------------------------------
+
+TAffine::TAffine(const TMatrix<4, 4>& mat) {
+	for (int row = 0; row < 3; row++)
+		for (int col = 0; col < 4; col++)
+			_data[row][col] = mat[col][row];
+}
+
+const TAffine& TAffine::getIdentity() {
+	static bool b = false;
+	static TAffine mat;
+	if (!b) {
+		mat.SetIdentity();
+		b = true;
+	}
+	return mat;
+}
+
+void TAffine::SetIdentity() {
+	for (int row = 0; row < 3; row++)
+		for (int col = 0; col < 4; col++)
+			_data[row][col] = (row == col);
+}
+
+// the two rows and columns that a rotation about the axis changes,
+// in the order that gives the same sign as TMatrix::SetRotationMatrix
+static bool RotationPlane(char axis, int& i, int& j) {
+	switch (axis) {
+		case 'x': i = 1; j = 2; return true;
+		case 'y': i = 2; j = 0; return true;
+		case 'z': i = 0; j = 1; return true;
+	}
+	return false;
+}
+
+void TAffine::SetRotation(ETR_DOUBLE angle, char axis) {
+	SetIdentity();
+	int i, j;
+	if (!RotationPlane(axis, i, j)) return;
+	ETR_DOUBLE sinv = sin(ANGLES_TO_RADIANS(angle));
+	ETR_DOUBLE cosv = cos(ANGLES_TO_RADIANS(angle));
+	_data[i][i] = cosv;
+	_data[i][j] = -sinv;
+	_data[j][i] = sinv;
+	_data[j][j] = cosv;
+}
+
+void TAffine::SetTranslation(ETR_DOUBLE _x, ETR_DOUBLE _y, ETR_DOUBLE _z) {
+	SetIdentity();
+	_data[0][3] = _x;
+	_data[1][3] = _y;
+	_data[2][3] = _z;
+}
+
+// only the columns i and j of the linear part change
+void TAffine::Rotate(ETR_DOUBLE angle, char axis) {
+	int i, j;
+	if (!RotationPlane(axis, i, j)) return;
+	ETR_DOUBLE sinv = sin(ANGLES_TO_RADIANS(angle));
+	ETR_DOUBLE cosv = cos(ANGLES_TO_RADIANS(angle));
+	for (int row = 0; row < 3; row++) {
+		ETR_DOUBLE a = _data[row][i];
+		ETR_DOUBLE b = _data[row][j];
+		_data[row][i] = a * cosv + b * sinv;
+		_data[row][j] = b * cosv - a * sinv;
+	}
+}
+
+// only the rows i and j change, including the translation
+void TAffine::PreRotate(ETR_DOUBLE angle, char axis) {
+	int i, j;
+	if (!RotationPlane(axis, i, j)) return;
+	ETR_DOUBLE sinv = sin(ANGLES_TO_RADIANS(angle));
+	ETR_DOUBLE cosv = cos(ANGLES_TO_RADIANS(angle));
+	for (int col = 0; col < 4; col++) {
+		ETR_DOUBLE a = _data[i][col];
+		ETR_DOUBLE b = _data[j][col];
+		_data[i][col] = a * cosv - b * sinv;
+		_data[j][col] = a * sinv + b * cosv;
+	}
+}
+
+void TAffine::Translate(ETR_DOUBLE _x, ETR_DOUBLE _y, ETR_DOUBLE _z) {
+	for (int row = 0; row < 3; row++)
+		_data[row][3] += _data[row][0] * _x + _data[row][1] * _y + _data[row][2] * _z;
+}
+
+void TAffine::PreTranslate(ETR_DOUBLE _x, ETR_DOUBLE _y, ETR_DOUBLE _z) {
+	_data[0][3] += _x;
+	_data[1][3] += _y;
+	_data[2][3] += _z;
+}
+
+void TAffine::Scale(ETR_DOUBLE _x, ETR_DOUBLE _y, ETR_DOUBLE _z) {
+	for (int row = 0; row < 3; row++) {
+		_data[row][0] *= _x;
+		_data[row][1] *= _y;
+		_data[row][2] *= _z;
+	}
+}
+
+void TAffine::PreScale(ETR_DOUBLE _x, ETR_DOUBLE _y, ETR_DOUBLE _z) {
+	for (int col = 0; col < 4; col++) {
+		_data[0][col] *= _x;
+		_data[1][col] *= _y;
+		_data[2][col] *= _z;
+	}
+}
+
+// closed form: the inverse of the linear part is its adjugate divided
+// by the determinant, the translation is moved back through it
+TAffine TAffine::GetInverse() const {
+	TAffine r;
+	const ETR_DOUBLE (*m)[4] = _data;
+	r._data[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+	r._data[0][1] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+	r._data[0][2] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+	r._data[1][0] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+	r._data[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+	r._data[1][2] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+	r._data[2][0] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+	r._data[2][1] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+	r._data[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+	ETR_DOUBLE det = m[0][0] * r._data[0][0] + m[0][1] * r._data[1][0] + m[0][2] * r._data[2][0];
+	if (det == 0) return getIdentity();
+	ETR_DOUBLE invdet = 1.0 / det;
+	for (int row = 0; row < 3; row++) {
+		for (int col = 0; col < 3; col++)
+			r._data[row][col] *= invdet;
+		r._data[row][3] = -(r._data[row][0] * m[0][3] + r._data[row][1] * m[1][3] + r._data[row][2] * m[2][3]);
+	}
+	return r;
+}
+
+TAffine TAffine::GetRigidInverse() const {
+	TAffine r;
+	for (int row = 0; row < 3; row++) {
+		for (int col = 0; col < 3; col++)
+			r._data[row][col] = _data[col][row];
+		r._data[row][3] = -(_data[0][row] * _data[0][3] + _data[1][row] * _data[1][3] + _data[2][row] * _data[2][3]);
+	}
+	return r;
+}
+
+TMatrix<4, 4> TAffine::GetMatrix() const {
+	TMatrix<4, 4> mat;
+	for (int col = 0; col < 4; col++) {
+		for (int row = 0; row < 3; row++)
+			mat[col][row] = _data[row][col];
+		mat[col][3] = (col == 3);
+	}
+	return mat;
+}
+
+void TAffine::GetGLMatrix(ETR_DOUBLE m[16]) const {
+	for (int col = 0; col < 4; col++) {
+		m[col*4] = _data[0][col];
+		m[col*4+1] = _data[1][col];
+		m[col*4+2] = _data[2][col];
+		m[col*4+3] = (col == 3);
+	}
+}
+
+TAffine MultiplyAffineScalar(const TAffine& l, const TAffine& r) {
+	TAffine ret;
+	for (int row = 0; row < 3; row++) {
+		const ETR_DOUBLE *lr = l[row];
+		for (int col = 0; col < 4; col++)
+			ret[row][col] = lr[0] * r[0][col] + lr[1] * r[1][col] + lr[2] * r[2][col];
+		ret[row][3] += lr[3];
+	}
+	return ret;
+}
+
+// A row of the product is a combination of the rows of r, which are
+// four floats each. Adding 0 to the first three columns changes nothing.
+TAffine operator*(const TAffine& l, const TAffine& r) {
+#ifdef ETR_SIMD
+	TAffine ret;
+	TSimd4 r0 = Simd4Load (r[0]);
+	TSimd4 r1 = Simd4Load (r[1]);
+	TSimd4 r2 = Simd4Load (r[2]);
+	for (int row = 0; row < 3; row++) {
+		const ETR_DOUBLE *lr = l[row];
+		TSimd4 sum = Simd4Add (Simd4Add (
+		                 Simd4Mul (Simd4Splat (lr[0]), r0),
+		                 Simd4Mul (Simd4Splat (lr[1]), r1)),
+		             Simd4Mul (Simd4Splat (lr[2]), r2));
+		Simd4Store (ret[row], Simd4Add (sum, Simd4Set (0, 0, 0, lr[3])));
+	}
+	return ret;
+#else
+	return MultiplyAffineScalar (l, r);
+#endif
+}
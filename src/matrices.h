@@ -43,4 +43,41 @@ public:
 template<int x, int y>
 TMatrix<x, y> operator*(const TMatrix<x, y>& l, const TMatrix<x, y>& r);
 
+// Affine transformation: a 3x3 linear part and a translation, the last
+// row (0 0 0 1) is implicit. The rows are stored with the translation
+// in the 4th column, so a point is transformed with three 4-component
+// dot products. Element [row][col] equals TMatrix<4, 4> [col][row].
+class TAffine {
+	ETR_DOUBLE _data[3][4];
+public:
+	TAffine() {}
+	explicit TAffine(const TMatrix<4, 4>& mat);
+
+	ETR_DOUBLE* operator[](int row) { return _data[row]; }
+	const ETR_DOUBLE* operator[](int row) const { return _data[row]; }
+
+	void SetIdentity();
+	void SetRotation(ETR_DOUBLE angle, char axis);
+	void SetTranslation(ETR_DOUBLE _x, ETR_DOUBLE _y, ETR_DOUBLE _z);
+
+	// this = this * op, cheaper than building op and multiplying
+	void Rotate(ETR_DOUBLE angle, char axis);
+	void Translate(ETR_DOUBLE _x, ETR_DOUBLE _y, ETR_DOUBLE _z);
+	void Scale(ETR_DOUBLE _x, ETR_DOUBLE _y, ETR_DOUBLE _z);
+	// this = op * this
+	void PreRotate(ETR_DOUBLE angle, char axis);
+	void PreTranslate(ETR_DOUBLE _x, ETR_DOUBLE _y, ETR_DOUBLE _z);
+	void PreScale(ETR_DOUBLE _x, ETR_DOUBLE _y, ETR_DOUBLE _z);
+
+	TAffine GetInverse() const;
+	TAffine GetRigidInverse() const;	// only for rotation + translation
+	TMatrix<4, 4> GetMatrix() const;
+	void GetGLMatrix(ETR_DOUBLE m[16]) const;	// column major for glMultMatrix
+
+	static const TAffine& getIdentity();
+};
+
+TAffine operator*(const TAffine& l, const TAffine& r);
+TAffine MultiplyAffineScalar(const TAffine& l, const TAffine& r);	// without SSE/NEON
+
 #endif
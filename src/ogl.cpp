@@ -399,6 +399,7 @@ void Reshape (int w, int h) {
 TRenderMode currentMode = RM_UNINITIALIZED;
 void set_gl_options (TRenderMode mode) {
 	currentMode = mode;
+	GLSTATS_SET_MODE (mode);
 	switch (mode) {
 		case GUI:
 			glEnable (GL_TEXTURE_2D);
@@ -746,3 +747,9 @@ void glTexCoord2(const TVector2d& vec) {
 void glMultMatrix(const TMatrix<4, 4>& mat) {
 	glMultMatrixd((const ETR_DOUBLE*)mat.data());
 }
+
+void glMultMatrix(const TAffine& mat) {
+	ETR_DOUBLE m[16];
+	mat.GetGLMatrix(m);
+	glMultMatrixd(m);
+}
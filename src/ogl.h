@@ -35,6 +35,7 @@ enum TRenderMode {
 	SKY,
 	FOG_PLANE,
 	TRACK_MARKS,
+	NUM_RENDER_MODES,
 	RM_UNINITIALIZED = -1
 };
 
@@ -96,6 +97,7 @@ void glVertex3(const TVector3d& vec);
 void glTexCoord2(const TVector2d& vec);
 
 void glMultMatrix(const TMatrix<4, 4>& mat);
+void glMultMatrix(const TAffine& mat);
 
 
 #endif
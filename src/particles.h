@@ -215,6 +215,7 @@ public:
 	float Angle () const { return WAngle; }
 	float Speed () const { return WSpeed; }
 	const TVector3d& WindDrift () const { return WVector; }
+	void SetDrift (const TVector3d& drift) { WVector = drift; }	// for replays
 };
 
 extern CWind Wind;
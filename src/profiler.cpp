@@ -0,0 +1,171 @@
+/* --------------------------------------------------------------------
+EXTREME TUXRACER
+
+Copyright (C) 2010 Extreme Tuxracer Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+---------------------------------------------------------------------*/
+
+#ifdef HAVE_CONFIG_H
+#include <etr_config.h>
+#endif
+
+#include "profiler.h"
+
+#ifdef USE_PROFILER
+
+#include "font.h"
+#include "ft_font.h"
+#include "winsys.h"
+#include "textures.h"
+#include "tux.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+CProfiler Profiler;
+
+CProfiler::CProfiler () {
+	numStages = 0;
+	frame = 0;
+	numFrames = 0;
+	depth = 0;
+	visible = false;
+}
+
+double CProfiler::Now () {
+	struct timeval tv;
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec * 0.001;
+}
+
+size_t CProfiler::RegisterStage (const char *name) {
+	for (size_t i = 0; i < numStages; i++)
+		if (strcmp (stages[i].name, name) == 0) return i;
+	if (numStages >= PROF_MAX_STAGES) return PROF_MAX_STAGES;
+
+	stages[numStages].name = name;
+	stages[numStages].depth = -1;
+	for (size_t f = 0; f < PROF_HISTORY; f++) samples[f][numStages] = -1;
+	return numStages++;
+}
+
+void CProfiler::Begin (size_t stage) {
+	if (depth < PROF_MAX_STAGES) {
+		stack[depth] = stage;
+		startTime[depth] = Now ();
+	}
+	if (stage < numStages && stages[stage].depth < 0)
+		stages[stage].depth = (int)depth;
+	depth++;
+}
+
+void CProfiler::End () {
+	if (depth == 0) return;
+	depth--;
+	if (depth >= PROF_MAX_STAGES) return;
+
+	size_t stage = stack[depth];
+	if (stage >= numStages) return;
+	float elapsed = (float)(Now () - startTime[depth]);
+	float& sample = samples[frame][stage];
+	if (sample < 0) sample = elapsed;
+	else sample += elapsed;
+}
+
+void CProfiler::NewFrame () {
+	frame = (frame + 1) % PROF_HISTORY;
+	if (numFrames < PROF_HISTORY - 1) numFrames++;
+	for (size_t i = 0; i < numStages; i++) samples[frame][i] = -1;
+}
+
+// the statistics are taken from the completed frames only
+bool CProfiler::GetStats (size_t stage, float &min, float &avg, float &max) const {
+	size_t count = 0;
+	float sum = 0;
+	for (size_t i = 1; i <= numFrames; i++) {
+		float val = samples[(frame + PROF_HISTORY - i) % PROF_HISTORY][stage];
+		if (val < 0) continue;
+		if (count == 0 || val < min) min = val;
+		if (count == 0 || val > max) max = val;
+		sum += val;
+		count++;
+	}
+	if (count == 0) return false;
+	avg = sum / count;
+	return true;
+}
+
+void CProfiler::Draw () const {
+	if (!visible) return;
+
+	const float size = 14;
+	float y = 60;
+	char line[128];
+
+	FT.SetColor (colWhite);
+	FT.DrawText (10, y, "stage  min / avg / max [ms]", "normal", size);
+	for (size_t i = 0; i < numStages; i++) {
+		float min, avg, max;
+		if (!GetStats (i, min, avg, max)) continue;
+		y += size + 2;
+		snprintf (line, sizeof(line), "%*s%s  %.2f / %.2f / %.2f",
+		          stages[i].depth * 2, "", stages[i].name, min, avg, max);
+		FT.DrawText (10, y, line, "normal", size);
+	}
+
+	const FTAtlasStats& glyphs = FTGlyphAtlas::Stats ();
+	y += size + 2;
+	snprintf (line, sizeof(line), "glyphs: %u rasterized, %u evicted, %u KB, %u binds",
+	          glyphs.rasterizations, glyphs.evictions,
+	          (unsigned int)(glyphs.bytes / 1024), glyphs.lastFrameBinds);
+	FT.DrawText (10, y, line, "normal", size);
+
+	const TTextureStats& tex = Tex.Stats ();
+	y += size + 2;
+	snprintf (line, sizeof(line), "textures: %u / %u resident, %u KB (peak %u KB), %u loads, %u evicted",
+	          tex.resident, tex.managed, (unsigned int)(tex.residentBytes / 1024),
+	          (unsigned int)(tex.peakBytes / 1024), tex.loads, tex.evictions);
+	FT.DrawText (10, y, line, "normal", size);
+
+	const TCharDrawStats& tux = CCharShape::DrawStats ();
+	y += size + 2;
+	snprintf (line, sizeof(line), "character (F4): %u draws %s, %u nodes, %u materials, %u vertices",
+	          tux.draws, CCharShape::flattenMesh ? "flattened" : "per node",
+	          tux.nodes, tux.materials, tux.vertices);
+	FT.DrawText (10, y, line, "normal", size);
+}
+
+bool CProfiler::DumpCSV (const string& filename) const {
+	std::ofstream file (filename.c_str());
+	if (!file) {
+		Message ("could not write profile", filename);
+		return false;
+	}
+
+	file << "frame";
+	for (size_t i = 0; i < numStages; i++) file << ',' << stages[i].name;
+	file << '\n';
+
+	for (size_t f = numFrames; f > 0; f--) {
+		file << numFrames - f;
+		for (size_t i = 0; i < numStages; i++) {
+			file << ',';
+			float val = samples[(frame + PROF_HISTORY - f) % PROF_HISTORY][i];
+			if (val >= 0) file << val;
+		}
+		file << '\n';
+	}
+	Message ("profile written to", filename);
+	return true;
+}
+
+#endif // USE_PROFILER
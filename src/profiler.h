@@ -0,0 +1,92 @@
+/* --------------------------------------------------------------------
+EXTREME TUXRACER
+
+Copyright (C) 2010 Extreme Tuxracer Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+---------------------------------------------------------------------*/
+
+// Frame profiler for development. It is only built with -DUSE_PROFILER,
+// otherwise all PROFILE_ macros expand to nothing.
+//
+// PROFILE_SCOPE ("name") measures the time until the end of the
+// enclosing block. Scopes can be nested. The times of the last
+// PROF_HISTORY frames are kept in a ring buffer; the racing mode shows
+// min/avg/max per stage with F9 and writes the buffer to a csv file
+// with F10.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "bh.h"
+
+#ifdef USE_PROFILER
+
+#define PROF_MAX_STAGES 32
+#define PROF_HISTORY 120
+
+class CProfiler {
+private:
+	struct TStage {
+		const char *name;
+		int depth;			// nesting level, -1 if not entered yet
+	};
+	TStage stages[PROF_MAX_STAGES];
+	size_t numStages;
+
+	float samples[PROF_HISTORY][PROF_MAX_STAGES];	// ms, < 0 if not entered
+	size_t frame;		// position of the current frame in the ring buffer
+	size_t numFrames;	// completed frames in the ring buffer
+
+	size_t stack[PROF_MAX_STAGES];
+	double startTime[PROF_MAX_STAGES];
+	size_t depth;
+	bool visible;
+
+	static double Now ();
+public:
+	CProfiler ();
+
+	size_t RegisterStage (const char *name);
+	void Begin (size_t stage);
+	void End ();
+	void NewFrame ();
+
+	bool GetStats (size_t stage, float &min, float &avg, float &max) const;
+	void ToggleVisible () { visible = !visible; }
+	void Draw () const;
+	bool DumpCSV (const string& filename) const;
+};
+
+extern CProfiler Profiler;
+
+struct ScopedProfile {
+	ScopedProfile (size_t stage) { Profiler.Begin (stage); }
+	~ScopedProfile () { Profiler.End (); }
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) \
+	static const size_t PROFILE_CONCAT(prof_stage_, __LINE__) = Profiler.RegisterStage (name); \
+	ScopedProfile PROFILE_CONCAT(prof_scope_, __LINE__) (PROFILE_CONCAT(prof_stage_, __LINE__))
+#define PROFILE_NEW_FRAME() Profiler.NewFrame ()
+#define PROFILE_DRAW() Profiler.Draw ()
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_NEW_FRAME()
+#define PROFILE_DRAW()
+
+#endif // USE_PROFILER
+
+#endif
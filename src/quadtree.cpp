@@ -859,6 +859,14 @@ clip_result_t quadsquare::ClipSquare (const quadcornerdata& cd) {
 		max.z = tmp;
 	}
 
+	// the frustum is in world coordinates, see RenderCourse
+	if (Course.IsMirrored ()) {
+		ETR_DOUBLE width = Course.GetDimensions().x;
+		ETR_DOUBLE tmp = min.x;
+		min.x = width - max.x;
+		max.x = width - tmp;
+	}
+
 	clip_result_t clip_result = clip_aabb_to_view_frustum(min, max);
 
 	if (clip_result == NotVisible || clip_result == SomeClip) {
@@ -1021,20 +1029,24 @@ void quadsquare::SetupCornerData(quadcornerdata* q, const quadcornerdata& cd, in
 int quadsquare::RowSize;
 int quadsquare::NumRows;
 
-void quadsquare::AddHeightMap(const quadcornerdata& cd, const HeightMapInfo& hm) {
-	RowSize = hm.RowWidth;
-	NumRows = hm.ZSize;
+void quadsquare::SetHeightMapSize (int rowsize, int numrows) {
+	RowSize = rowsize;
+	NumRows = numrows;
 
-	if (cd.Parent == NULL) {
-		if (VertexArrayIndices != NULL) {
-			delete VertexArrayIndices;
-		}
+	delete[] VertexArrayIndices;
 #ifdef USE_GLES1
-		VertexArrayIndices = new GLushort[6 * RowSize * NumRows];
+	VertexArrayIndices = new GLushort[6 * RowSize * NumRows];
 #else
-		VertexArrayIndices = new GLuint[6 * RowSize * NumRows];
+	VertexArrayIndices = new GLuint[6 * RowSize * NumRows];
 #endif
+}
+
+void quadsquare::AddHeightMap(const quadcornerdata& cd, const HeightMapInfo& hm) {
+	if (cd.Parent == NULL) {
+		SetHeightMapSize (hm.RowWidth, hm.ZSize);
 	}
+	RowSize = hm.RowWidth;
+	NumRows = hm.ZSize;
 	int	BlockSize = 2 << cd.Level;
 	if (cd.xorg > hm.XOrigin + ((hm.XSize + 2) << hm.Scale) ||
 		cd.xorg + BlockSize < hm.XOrigin - (1 << hm.Scale) ||
@@ -1131,6 +1143,19 @@ static int get_root_level (int nx, int nz) {
 	return max (xlev, zlev);
 }
 
+static void InitRootCornerData (int nx, int nz) {
+	root_corner_data.Square = (quadsquare*)NULL;
+	root_corner_data.ChildIndex = 0;
+	root_corner_data.Level = get_root_level (nx, nz);
+	root_corner_data.xorg = 0;
+	root_corner_data.zorg = 0;
+
+	for (int i=0; i<4; i++) {
+		root_corner_data.Verts[i].Y = 0;
+		root_corner_data.Verts[i].Y = 0;
+	}
+}
+
 void InitQuadtree (ETR_DOUBLE *elevation, int nx, int nz,
 				   ETR_DOUBLE scalex, ETR_DOUBLE scalez, const TVector3d& view_pos, ETR_DOUBLE detail) {
 #ifdef USE_GLES1
@@ -1146,17 +1171,7 @@ void InitQuadtree (ETR_DOUBLE *elevation, int nx, int nz,
 	hm.RowWidth = hm.XSize;
 	hm.Scale = 0;
 
-	root_corner_data.Square = (quadsquare*)NULL;
-	root_corner_data.ChildIndex = 0;
-	root_corner_data.Level = get_root_level (nx, nz);
-	root_corner_data.xorg = 0;
-	root_corner_data.zorg = 0;
-
-	for (int i=0; i<4; i++) {
-		root_corner_data.Verts[i].Y = 0;
-		root_corner_data.Verts[i].Y = 0;
-	}
-
+	InitRootCornerData (nx, nz);
 	root = new quadsquare (&root_corner_data);
 	root->AddHeightMap (root_corner_data, hm);
 	root->SetScale (scalex, scalez);
@@ -1224,3 +1239,34 @@ void RenderQuadtree() {
 	glDisableClientState (GL_NORMAL_ARRAY);
 	glDisableClientState (GL_COLOR_ARRAY);
 }
+
+// The tree itself only depends on the elevation, everything else the
+// quadtree keeps in statics is set up again when a tree is attached.
+
+quadsquare* DetachQuadtree () {
+	quadsquare *tree = root;
+	root = (quadsquare*) NULL;
+	return tree;
+}
+
+void AttachQuadtree (quadsquare *tree, int nx, int nz, ETR_DOUBLE scalex, ETR_DOUBLE scalez) {
+	ResetQuadtree ();
+#ifdef USE_GLES1
+	currvertexstartindex = 0;
+#endif
+	InitRootCornerData (nx, nz);
+	root = tree;
+	if (root == NULL) return;
+	quadsquare::SetHeightMapSize (nx, nz);
+	root->SetScale (scalex, scalez);
+	root->SetTerrain (Course.terrain);
+}
+
+void DeleteQuadtree (quadsquare *tree) {
+	delete tree;
+}
+
+size_t QuadtreeBytes (quadsquare *tree) {
+	if (tree == NULL) return 0;
+	return tree->CountNodes () * sizeof (quadsquare);
+}
@@ -89,6 +89,7 @@ struct quadsquare {
 
 	static void DrawTris();
 	static void InitArrayCounters();
+	static void SetHeightMapSize (int rowsize, int numrows);
 
 	quadsquare (quadcornerdata* pcd);
 	~quadsquare();
@@ -143,5 +144,11 @@ void InitQuadtree (ETR_DOUBLE *elevation, int nx, int nz,
 void UpdateQuadtree (const TVector3d& view_pos, float detail);
 void RenderQuadtree();
 
+// for keeping the quadtrees of several loaded courses, see CCourse::StashCourse
+quadsquare* DetachQuadtree ();
+void AttachQuadtree (quadsquare *tree, int nx, int nz, ETR_DOUBLE scalex, ETR_DOUBLE scalez);
+void DeleteQuadtree (quadsquare *tree);
+size_t QuadtreeBytes (quadsquare *tree);
+
 
 #endif
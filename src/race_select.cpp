@@ -186,6 +186,7 @@ void CRaceSelect::Loop() {
 	ClearRenderContext ();
 	SetupGuiDisplay ();
 
+	Course.Prefetch (&CourseList[course->GetValue()]);
 	Music.Update ();
 	if (param.ui_snow) {
 		update_ui_snow ();
@@ -208,10 +209,12 @@ void CRaceSelect::Loop() {
 	FT.SetColor (colDYell);
 	FT.DrawString (area.left+20, frametop, CourseList[course->GetValue()].name);
 
-	if (CourseList[course->GetValue()].preview)
-		CourseList[course->GetValue()].preview->DrawFrame(area.left + 3, prevtop, prevwidth, prevheight, 3, colWhite);
+	TTexture* preview = Course.GetPreview (course->GetValue());
+	if (preview)
+		preview->DrawFrame(area.left + 3, prevtop, prevwidth, prevheight, 3, colWhite);
 
 	DrawFrameX (area.right-boxwidth, prevtop-3, boxwidth, prevheight+6, 3, colBackgr, colWhite, 1.0);
+	Course.WrapDescription (course->GetValue());
 	FT.AutoSizeN (2);
 	FT.SetColor (colWhite);
 	int dist = FT.AutoDistanceN (0);
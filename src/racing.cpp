@@ -37,7 +37,12 @@ GNU General Public License for more details.
 #include "winsys.h"
 #include "physics.h"
 #include "tux.h"
+#include "profiler.h"
+#include "replay.h"
+#include "ghost.h"
+#include "intro.h"
 #include <algorithm>
+#include <cstring>
 
 #define MAX_JUMP_AMT 1.0
 #define ROLL_DECAY 0.2
@@ -57,6 +62,7 @@ static bool key_braking;
 static bool stick_braking;
 static ETR_DOUBLE charge_start_time;
 static bool trick_modifier;
+static bool stick_jump;		// joystick button 0 since the last frame
 
 static bool sky = true;
 static bool fog = true;
@@ -148,6 +154,25 @@ void CRacing::Keyb (unsigned int key, bool special, bool release, int x, int y)
 		case SDLK_F8:
 			if (!release) trees = !trees;
 			break;
+#ifdef USE_PROFILER
+		case SDLK_F4:
+			if (!release) CCharShape::flattenMesh = !CCharShape::flattenMesh;
+			break;
+		case SDLK_F9:
+			if (!release) Profiler.ToggleVisible ();
+			break;
+		case SDLK_F10:
+			if (!release) Profiler.DumpCSV (param.config_dir + SEP + "profile.csv");
+			break;
+#endif
+#ifdef USE_GLSTATS
+		case SDLK_F11:
+			if (!release) GLStatsToggleVisible ();
+			break;
+		case SDLK_F12:
+			if (!release) GLStatsToggleDump (param.config_dir + SEP + "glstats.csv");
+			break;
+#endif
 	}
 }
 
@@ -168,6 +193,7 @@ void CRacing::Jbutt (int button, int state) {
 		//key_charging = state != 0;
 		ctrl->jump_charging = true;
 		charge_start_time = g_game.time - MAX_JUMP_AMT;
+		stick_jump = true;
 	} else if (button == 1) {
 //		key_charging = (bool) state;
 	}
@@ -210,6 +236,7 @@ void CRacing::Enter() {
 	}
 	set_view_mode (ctrl, (TViewMode)param.view_mode);
 	left_turn = right_turn = trick_modifier = false;
+	stick_jump = false;
 
 	ctrl->turn_fact = 0.0;
 	ctrl->turn_animation = 0.0;
@@ -222,6 +249,10 @@ void CRacing::Enter() {
 	newsound = -1;
 
 	if (State::manager.PreviousState() != &Paused) ctrl->Init ();
+	if (State::manager.PreviousState() == &Intro) {
+		Replay.StartRecording ();
+		Ghost.StartRace ();
+	}
 	g_game.raceaborted = false;
 
 	SetSoundVolumes ();
@@ -342,12 +373,68 @@ void CalcTrickControls (CControl *ctrl, bool airborne) {
 	}
 }
 
+// ----------------------- replay -------------------------------------
+
+static void RecordFrame (CControl *ctrl) {
+	TReplayFrame frame;
+	memset (&frame, 0, sizeof(frame));
+	frame.time_step = g_game.time_step;
+	frame.turn = stick_turnfact;
+	frame.wind_x = Wind.WindDrift().x;
+	frame.wind_z = Wind.WindDrift().z;
+	frame.view_mode = ctrl->viewmode;
+	if (left_turn) frame.flags |= REPLAY_LEFT;
+	if (right_turn) frame.flags |= REPLAY_RIGHT;
+	if (stick_turn) frame.flags |= REPLAY_STICK_TURN;
+	if (key_paddling) frame.flags |= REPLAY_KEY_PADDLE;
+	if (stick_paddling) frame.flags |= REPLAY_STICK_PADDLE;
+	if (key_braking) frame.flags |= REPLAY_KEY_BRAKE;
+	if (stick_braking) frame.flags |= REPLAY_STICK_BRAKE;
+	if (key_charging) frame.flags |= REPLAY_KEY_CHARGE;
+	if (stick_charging) frame.flags |= REPLAY_STICK_CHARGE;
+	if (stick_jump) frame.flags |= REPLAY_STICK_JUMP;
+	if (trick_modifier) frame.flags |= REPLAY_TRICK;
+	Replay.Record (frame);
+}
+
+// Sets the input flags as the event handlers did in the recorded race,
+// the controls are then calculated as usual.
+static void PlayFrame (CControl *ctrl, const TReplayFrame& frame) {
+	g_game.time_step = frame.time_step;
+	stick_turnfact = frame.turn;
+	Wind.SetDrift (TVector3d (frame.wind_x, 0, frame.wind_z));
+	if (frame.view_mode != ctrl->viewmode) set_view_mode (ctrl, (TViewMode)frame.view_mode);
+	left_turn = (frame.flags & REPLAY_LEFT) != 0;
+	right_turn = (frame.flags & REPLAY_RIGHT) != 0;
+	stick_turn = (frame.flags & REPLAY_STICK_TURN) != 0;
+	key_paddling = (frame.flags & REPLAY_KEY_PADDLE) != 0;
+	stick_paddling = (frame.flags & REPLAY_STICK_PADDLE) != 0;
+	key_braking = (frame.flags & REPLAY_KEY_BRAKE) != 0;
+	stick_braking = (frame.flags & REPLAY_STICK_BRAKE) != 0;
+	key_charging = (frame.flags & REPLAY_KEY_CHARGE) != 0;
+	stick_charging = (frame.flags & REPLAY_STICK_CHARGE) != 0;
+	trick_modifier = (frame.flags & REPLAY_TRICK) != 0;
+	if (frame.flags & REPLAY_STICK_JUMP) {
+		ctrl->jump_charging = true;
+		charge_start_time = g_game.time - MAX_JUMP_AMT;
+	}
+}
+
 // ====================================================================
 //					loop
 // ====================================================================
 
 void CRacing::Loop () {
+	PROFILE_SCOPE ("racing");
 	CControl *ctrl = g_game.player->ctrl;
+	if (Replay.Playing ()) {
+		const TReplayFrame *frame = Replay.NextFrame ();
+		if (frame != NULL) PlayFrame (ctrl, *frame);
+	} else if (Replay.Recording ()) {
+		RecordFrame (ctrl);
+	}
+	stick_jump = false;
+
 	ETR_DOUBLE ycoord = Course.FindYCoord (ctrl->cpos.x, ctrl->cpos.z);
 	bool airborne = (bool) (ctrl->cpos.y > (ycoord + JUMP_MAX_START_HEIGHT));
 
@@ -361,35 +448,81 @@ void CRacing::Loop () {
 	else CalcFinishControls (ctrl, airborne);
 	PlayTerrainSound (ctrl, airborne);
 //  >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-	ctrl->UpdatePlayerPos (false);
+	{
+		PROFILE_SCOPE ("UpdatePlayerPos");
+		ctrl->UpdatePlayerPos (false);
+	}
+	{
+		PROFILE_SCOPE ("ghost");
+		Ghost.Update ();
+	}
 //  >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
 	if (g_game.finish) IncCameraDistance ();
-	update_view (ctrl, g_game.time_step);
-	UpdateTrackmarks (ctrl);
+	{
+		PROFILE_SCOPE ("update_view");
+		update_view (ctrl, g_game.time_step);
+	}
+	{
+		PROFILE_SCOPE ("UpdateTrackmarks");
+		UpdateTrackmarks (ctrl);
+	}
 
 	SetupViewFrustum (ctrl);
-	if (sky) Env.DrawSkybox (ctrl->viewpos);
-	if (fog) Env.DrawFog ();
-	if (terr) RenderCourse ();
-	DrawTrackmarks ();
-	if (trees) DrawTrees ();
+	{
+		PROFILE_SCOPE ("sky + fog");
+		if (sky) Env.DrawSkybox (ctrl->viewpos);
+		if (fog) Env.DrawFog ();
+	}
+	{
+		PROFILE_SCOPE ("RenderCourse");
+		if (terr) RenderCourse ();
+	}
+	{
+		PROFILE_SCOPE ("DrawTrackmarks");
+		DrawTrackmarks ();
+	}
+	{
+		PROFILE_SCOPE ("DrawTrees");
+		if (trees) DrawTrees ();
+	}
 	if (param.perf_level > 2) {
+		PROFILE_SCOPE ("particles");
 		update_particles ();
 		draw_particles (ctrl);
 	}
-	g_game.character->shape->Draw();
-	UpdateWind ();
-	UpdateSnow (ctrl);
-	DrawSnow (ctrl);
-	DrawHud (ctrl);
+	{
+		PROFILE_SCOPE ("CCharShape::Draw");
+		g_game.character->shape->Draw();
+	}
+	{
+		PROFILE_SCOPE ("ghost");
+		Ghost.Draw ();
+	}
+	{
+		PROFILE_SCOPE ("snow");
+		UpdateWind ();
+		UpdateSnow (ctrl);
+		DrawSnow (ctrl);
+	}
+	{
+		PROFILE_SCOPE ("hud");
+		DrawHud (ctrl);
+	}
 
 	Reshape (Winsys.resolution.width, Winsys.resolution.height);
-	Winsys.SwapBuffers ();
+	{
+		PROFILE_SCOPE ("SwapBuffers");
+		Winsys.SwapBuffers ();
+	}
 	if (g_game.finish == false) g_game.time += g_game.time_step;
 }
 // ---------------------------------- term ------------------
 void CRacing::Exit() {
+	if (State::manager.NextState() != &Paused)
+		Replay.StopRecording (State::manager.NextState() == &GameOver && !g_game.raceaborted);
+	if (State::manager.NextState() != &Paused && State::manager.NextState() != &Reset)
+		Ghost.FinishRace (State::manager.NextState() == &GameOver && !g_game.raceaborted);
 	Sound.HaltAll ();
 	break_track_marks ();
 }
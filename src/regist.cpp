@@ -44,10 +44,10 @@ void QuitRegistration () {
 	Players.AllocControl (player->GetValue());
 	g_game.player = Players.GetPlayer(player->GetValue());
 	g_game.player->character = character->GetValue();
-	g_game.character = &Char.CharList[character->GetValue()];
+	g_game.character = Char.GetCharacter (character->GetValue());
 	g_game.start_character = character->GetValue();
 	g_game.start_player = player->GetValue();
-	//Char.FreeCharacterPreviews(); // From here on, character previews are no longer required
+	Char.FreeCharacterPreviews(); // From here on, character previews are no longer required
 	State::manager.RequestEnterState (GameTypeSelect);
 }
 
@@ -173,8 +173,9 @@ void CRegist::Loop () {
 	FT.SetColor (col);
 	FT.DrawString (area.left + 90,
 	               AutoYPosN(ptop3) + 2, Char.CharList[character->GetValue()].name);
-	if (Char.CharList[character->GetValue()].preview != NULL)
-		Char.CharList[character->GetValue()].preview->DrawFrame(
+	TTexture* preview = Char.GetPreview (character->GetValue());
+	if (preview != NULL)
+		preview->DrawFrame(
 		    area.left - 60,
 		    AutoYPosN (ptop4), texsize, texsize, 3, colWhite);
 
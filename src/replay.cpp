@@ -0,0 +1,153 @@
+/* --------------------------------------------------------------------
+EXTREME TUXRACER
+
+Copyright (C) 2010 Extreme Tuxracer Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+---------------------------------------------------------------------*/
+
+#ifdef HAVE_CONFIG_H
+#include <etr_config.h>
+#endif
+
+#include "replay.h"
+#include "course.h"
+#include "game_ctrl.h"
+#include "physics.h"
+#include <cstring>
+#include <fstream>
+
+#define REPLAY_MAGIC 0x52525445	// "ETRR"
+#define REPLAY_VERSION 1
+#define REPLAY_NAME_LEN 64
+
+// The file is the header followed by the frames, 20 bytes each.
+struct TReplayHeader {
+	unsigned int magic;
+	unsigned int version;
+	unsigned int frame_size;
+	char course_dir[REPLAY_NAME_LEN];
+	char char_dir[REPLAY_NAME_LEN];
+	unsigned int mirrored;
+	unsigned int light_id;
+	int snow_id;
+	int wind_id;
+	double start_x, start_z;
+	unsigned int num_frames;
+};
+
+CReplay Replay;
+
+// Called when a race starts, after the intro.
+void CReplay::StartRecording () {
+	frames.clear();
+	playing = false;
+	recording = !recordfile.empty();
+	if (!recording) return;
+
+	course_dir = g_game.course->dir;
+	char_dir = g_game.character->dir;
+	mirrored = g_game.mirrorred;
+	light_id = g_game.light_id;
+	snow_id = g_game.snow_id;
+	wind_id = g_game.wind_id;
+	start_x = g_game.player->ctrl->cpos.x;
+	start_z = g_game.player->ctrl->cpos.z;
+}
+
+// Only finished races are saved. A reset moves Tux without input, so a
+// race with a reset can't be replayed.
+void CReplay::StopRecording (bool save) {
+	if (!recording) return;
+	recording = false;
+	if (save && Save (recordfile))
+		Message ("race recorded to", recordfile);
+	frames.clear();
+}
+
+bool CReplay::Save (const string& filename) const {
+	if (course_dir.size() >= REPLAY_NAME_LEN || char_dir.size() >= REPLAY_NAME_LEN) {
+		Message ("course or character name too long for the replay");
+		return false;
+	}
+
+	TReplayHeader hdr;
+	memset (&hdr, 0, sizeof(hdr));
+	hdr.magic = REPLAY_MAGIC;
+	hdr.version = REPLAY_VERSION;
+	hdr.frame_size = sizeof(TReplayFrame);
+	strcpy (hdr.course_dir, course_dir.c_str());
+	strcpy (hdr.char_dir, char_dir.c_str());
+	hdr.mirrored = mirrored;
+	hdr.light_id = light_id;
+	hdr.snow_id = snow_id;
+	hdr.wind_id = wind_id;
+	hdr.start_x = start_x;
+	hdr.start_z = start_z;
+	hdr.num_frames = frames.size();
+
+	ofstream file (filename.c_str(), ios::out | ios::binary);
+	if (file) {
+		file.write ((const char*)&hdr, sizeof(hdr));
+		if (!frames.empty())
+			file.write ((const char*)&frames[0], frames.size() * sizeof(TReplayFrame));
+	}
+	if (!file) {
+		Message ("could not write replay", filename);
+		return false;
+	}
+	return true;
+}
+
+bool CReplay::Load (const string& filename) {
+	CMappedFile file;
+	if (!file.Open (filename)) {
+		Message ("could not open replay", filename);
+		return false;
+	}
+	const TReplayHeader* hdr = (const TReplayHeader*)file.Data();
+	if (file.Size() < sizeof(TReplayHeader)
+	        || hdr->magic != REPLAY_MAGIC
+	        || hdr->version != REPLAY_VERSION
+	        || hdr->frame_size != sizeof(TReplayFrame)
+	        || file.Size() != sizeof(TReplayHeader) + hdr->num_frames * sizeof(TReplayFrame)
+	        || memchr (hdr->course_dir, 0, REPLAY_NAME_LEN) == NULL
+	        || memchr (hdr->char_dir, 0, REPLAY_NAME_LEN) == NULL) {
+		Message ("not a replay of this version", filename);
+		return false;
+	}
+
+	course_dir = hdr->course_dir;
+	char_dir = hdr->char_dir;
+	mirrored = hdr->mirrored != 0;
+	light_id = hdr->light_id;
+	snow_id = hdr->snow_id;
+	wind_id = hdr->wind_id;
+	start_x = hdr->start_x;
+	start_z = hdr->start_z;
+
+	const TReplayFrame* data = (const TReplayFrame*)(file.Data() + sizeof(TReplayHeader));
+	frames.assign (data, data + hdr->num_frames);
+	playpos = 0;
+	return true;
+}
+
+// Playing() turns false with the last frame, so the caller can stop
+// before a frame without recorded time step.
+const TReplayFrame *CReplay::NextFrame () {
+	if (playpos >= frames.size()) {
+		playing = false;
+		return NULL;
+	}
+	const TReplayFrame *frame = &frames[playpos++];
+	if (playpos == frames.size()) playing = false;
+	return frame;
+}
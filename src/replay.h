@@ -0,0 +1,88 @@
+/* --------------------------------------------------------------------
+EXTREME TUXRACER
+
+Copyright (C) 2010 Extreme Tuxracer Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+---------------------------------------------------------------------*/
+
+// Recorded race input. "etr --record file" writes the input of every
+// finished race to file, "etr --replay file [window|offscreen|null]"
+// races it again in the benchmark state and writes the frame times to
+// benchmark.csv. A frame holds the input flags of the racing state as
+// the keyboard and joystick left them, the time step, the wind (which
+// is random) and the view mode, so the replay computes exactly the
+// same controls and physics as the recorded race.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "bh.h"
+#include <vector>
+
+#define REPLAY_LEFT			0x0001
+#define REPLAY_RIGHT		0x0002
+#define REPLAY_STICK_TURN	0x0004
+#define REPLAY_KEY_PADDLE	0x0008
+#define REPLAY_STICK_PADDLE	0x0010
+#define REPLAY_KEY_BRAKE	0x0020
+#define REPLAY_STICK_BRAKE	0x0040
+#define REPLAY_KEY_CHARGE	0x0080
+#define REPLAY_STICK_CHARGE	0x0100
+#define REPLAY_STICK_JUMP	0x0200		// joystick button 0
+#define REPLAY_TRICK		0x0400
+
+struct TReplayFrame {
+	float time_step;
+	float turn;				// joystick turn factor
+	float wind_x, wind_z;
+	unsigned short flags;
+	unsigned short view_mode;
+};
+
+class CReplay {
+private:
+	vector<TReplayFrame> frames;
+	string recordfile;
+	bool recording;
+	bool playing;
+	size_t playpos;
+public:
+	CReplay () : recording(false), playing(false), playpos(0), mirrored(false),
+		light_id(0), snow_id(0), wind_id(0), start_x(0), start_z(0) {}
+
+	// race parameters of the recorded race
+	string course_dir;
+	string char_dir;
+	bool mirrored;
+	size_t light_id;
+	int snow_id;
+	int wind_id;
+	ETR_DOUBLE start_x, start_z;	// after the intro
+
+	void SetRecordFile (const string& filename) { recordfile = filename; }
+	void StartRecording ();
+	void StopRecording (bool save);
+	bool Recording () const { return recording; }
+	void Record (const TReplayFrame& frame) { frames.push_back (frame); }
+
+	bool Load (const string& filename);
+	bool Save (const string& filename) const;
+	void StartPlayback () { playing = true; playpos = 0; }
+	void StopPlayback () { playing = false; }
+	bool Playing () const { return playing; }
+	const TReplayFrame *NextFrame ();	// NULL at the end
+	size_t NumFrames () const { return frames.size(); }
+};
+
+extern CReplay Replay;
+
+#endif
@@ -0,0 +1,93 @@
+/* --------------------------------------------------------------------
+EXTREME TUXRACER
+
+Copyright (C) 2013 Extreme Tuxracer Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+---------------------------------------------------------------------*/
+
+// Four floats in one SSE or NEON register, for the hot functions of
+// mathlib and TAffine. The instruction set is picked at compile time;
+// ETR_SIMD is only defined if ETR_DOUBLE is float, with doubles (or
+// with -DNO_SIMD) the scalar versions are used. NEON needs __ARM_NEON,
+// armhf builds without -mfpu=neon get the scalar code. The vector versions do
+// the same operations in the same order as the scalar ones, so they
+// give the same results unless the compiler fuses multiply and add
+// differently; "etr --benchmark-simd" checks that.
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "vectors.h"
+
+#if defined USE_GLES1 && !defined NO_SIMD
+#	if defined __SSE__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 1)
+#		define ETR_SSE
+#	elif defined __ARM_NEON
+#		define ETR_NEON
+#	endif
+#endif
+
+#if defined ETR_SSE
+#include <xmmintrin.h>
+#define ETR_SIMD
+
+typedef __m128 TSimd4;
+
+inline TSimd4 Simd4Load (const float *p) { return _mm_loadu_ps (p); }
+inline void Simd4Store (float *p, TSimd4 v) { _mm_storeu_ps (p, v); }
+inline TSimd4 Simd4Set (float x, float y, float z, float w) { return _mm_setr_ps (x, y, z, w); }
+inline TSimd4 Simd4Splat (float f) { return _mm_set1_ps (f); }
+inline TSimd4 Simd4Add (TSimd4 a, TSimd4 b) { return _mm_add_ps (a, b); }
+inline TSimd4 Simd4Sub (TSimd4 a, TSimd4 b) { return _mm_sub_ps (a, b); }
+inline TSimd4 Simd4Mul (TSimd4 a, TSimd4 b) { return _mm_mul_ps (a, b); }
+// lanes a, b, c, d of v, the arguments have to be constants
+#define Simd4Swizzle(v, a, b, c, d) _mm_shuffle_ps ((v), (v), _MM_SHUFFLE (d, c, b, a))
+
+#elif defined ETR_NEON
+#include <arm_neon.h>
+#define ETR_SIMD
+
+typedef float32x4_t TSimd4;
+
+inline TSimd4 Simd4Load (const float *p) { return vld1q_f32 (p); }
+inline void Simd4Store (float *p, TSimd4 v) { vst1q_f32 (p, v); }
+inline TSimd4 Simd4Set (float x, float y, float z, float w) {
+	const float f[4] = {x, y, z, w};
+	return vld1q_f32 (f);
+}
+inline TSimd4 Simd4Splat (float f) { return vdupq_n_f32 (f); }
+inline TSimd4 Simd4Add (TSimd4 a, TSimd4 b) { return vaddq_f32 (a, b); }
+inline TSimd4 Simd4Sub (TSimd4 a, TSimd4 b) { return vsubq_f32 (a, b); }
+// vmulq, not vmlaq: a separate multiply keeps the rounding of the scalar code
+inline TSimd4 Simd4Mul (TSimd4 a, TSimd4 b) { return vmulq_f32 (a, b); }
+#ifdef __clang__
+#define Simd4Swizzle(v, a, b, c, d) __builtin_shufflevector ((v), (v), a, b, c, d)
+#else
+#define Simd4Swizzle(v, a, b, c, d) __builtin_shuffle ((v), (uint32x4_t) {a, b, c, d})
+#endif
+#endif
+
+#ifdef ETR_SIMD
+inline TVector3d Simd4Vector3 (TSimd4 v) {
+	float f[4];
+	Simd4Store (f, v);
+	return TVector3d (f[0], f[1], f[2]);
+}
+
+inline TVector4d Simd4Vector4 (TSimd4 v) {
+	float f[4];
+	Simd4Store (f, v);
+	return TVector4d (f[0], f[1], f[2], f[3]);
+}
+#endif
+
+#endif
@@ -91,7 +91,7 @@ void CSplashScreen::Loop() {
 	Players.ResetControls();
 	Players.AllocControl(g_game.start_player);
 	g_game.player = Players.GetPlayer(g_game.start_player);
-	g_game.character = &Char.CharList[g_game.start_character];
+	g_game.character = Char.GetCharacter (g_game.start_character);
 
 	State::manager.RequestEnterState (GameTypeSelect);
 
@@ -21,6 +21,10 @@ GNU General Public License for more details.
 #include "spx.h"
 
 #include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <climits>
 #include <iomanip>
 #include <iostream>
 #include <fstream>
@@ -104,159 +108,301 @@ string Bool_StrN(const bool val) {
 	else return "false";
 }
 
-int Str_IntN (const string &s, const int def) {
+// The conversions work on a piece of text given by pointer and length,
+// so they can read values in place. Numbers are copied to a small
+// buffer for strtol/strtod, the text doesn't need a terminating 0.
+
+static inline bool IsSpace (char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// only decimal numbers, like the streams read them (no hex, inf or nan)
+static inline bool IsNumChar (char c) {
+	return (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E';
+}
+
+#define NUM_BUFSIZE 64
+
+static const char *CopyNumber (const char *p, const char *end, char *buf) {
+	while (p < end && IsSpace (*p)) p++;
+	size_t len = 0;
+	while (p + len < end && len < NUM_BUFSIZE-1 && IsNumChar (p[len])) {
+		buf[len] = p[len];
+		len++;
+	}
+	buf[len] = 0;
+	return p;
+}
+
+static bool ParseNum (const char *&p, const char *end, int &val) {
+	char buf[NUM_BUFSIZE];
+	p = CopyNumber (p, end, buf);
+	char *e;
+	errno = 0;
+	long v = strtol (buf, &e, 10);
+	if (e == buf || errno == ERANGE || v > INT_MAX || v < INT_MIN) return false;
+	val = (int)v;
+	p += e - buf;
+	return true;
+}
+
+static bool ParseNum (const char *&p, const char *end, double &val) {
+	char buf[NUM_BUFSIZE];
+	p = CopyNumber (p, end, buf);
+	char *e;
+	double v = strtod (buf, &e);
+	if (e == buf) return false;
+	val = v;
+	p += e - buf;
+	return true;
+}
+
+static bool ParseNum (const char *&p, const char *end, float &val) {
+	double v;
+	if (!ParseNum (p, end, v)) return false;
+	val = (float)v;
+	return true;
+}
+
+template<typename T>
+static bool ParseNums (const char *p, size_t len, T *vals, size_t count) {
+	const char *end = p + len;
+	for (size_t i = 0; i < count; i++)
+		if (!ParseNum (p, end, vals[i])) return false;
+	return true;
+}
+
+static void TrimSpan (const char *&p, size_t &len) {
+	while (len > 0 && (*p == ' ' || *p == '\t')) {
+		p++;
+		len--;
+	}
+	while (len > 0 && (p[len-1] == ' ' || p[len-1] == '\t')) len--;
+}
+
+static int SpanInt (const char *p, size_t len, const int def) {
 	int val;
-	istringstream is(s);
-	is >> val;
-	if (is.fail()) return def;
-	else return val;
+	return ParseNums (p, len, &val, 1) ? val : def;
 }
 
-bool Str_BoolN (const string &s, const bool def) {
-	if (s == "0" || s == "false")
+static float SpanFloat (const char *p, size_t len, const float def) {
+	float val;
+	return ParseNums (p, len, &val, 1) ? val : def;
+}
+
+// like Str_BoolN did, only the exact words are compared; the SP
+// functions trim the value first
+static bool SpanBool (const char *p, size_t len, const bool def) {
+	if ((len == 1 && *p == '0') || (len == 5 && memcmp (p, "false", 5) == 0))
 		return false;
-	if (s == "1" || s == "true")
+	if ((len == 1 && *p == '1') || (len == 4 && memcmp (p, "true", 4) == 0))
 		return true;
-	return Str_IntN(s, (int)def) != 0; // Try to parse as int
+	return SpanInt (p, len, (int)def) != 0; // Try to parse as int
+}
+
+static string SpanStr (const char *p, size_t len, const string& def) {
+	if (len == 0) return def;
+	TrimSpan (p, len);
+	return string (p, len);
+}
+
+template<typename T>
+static TVector2<T> SpanVector2 (const char *p, size_t len, const TVector2<T>& def) {
+	T v[2];
+	return ParseNums (p, len, v, 2) ? TVector2<T>(v[0], v[1]) : def;
+}
+
+template<typename T>
+static TVector3<T> SpanVector3 (const char *p, size_t len, const TVector3<T>& def) {
+	T v[3];
+	return ParseNums (p, len, v, 3) ? TVector3<T>(v[0], v[1], v[2]) : def;
+}
+
+template<typename T>
+static TVector4<T> SpanVector4 (const char *p, size_t len, const TVector4<T>& def) {
+	T v[4];
+	return ParseNums (p, len, v, 4) ? TVector4<T>(v[0], v[1], v[2], v[3]) : def;
+}
+
+static TColor SpanColor (const char *p, size_t len, const TColor& def) {
+	float v[4];
+	return ParseNums (p, len, v, 4) ? TColor(v[0], v[1], v[2], v[3]) : def;
+}
+
+static TColor3 SpanColor3 (const char *p, size_t len, const TColor3& def) {
+	float v[3];
+	return ParseNums (p, len, v, 3) ? TColor3(v[0], v[1], v[2]) : def;
+}
+
+static void SpanArr (const char *p, size_t len, float *arr, size_t count, float def) {
+	if (!ParseNums (p, len, arr, count))
+		for (size_t i=0; i<count; i++) arr[i] = def;
+}
+
+int Str_IntN (const string &s, const int def) {
+	return SpanInt (s.data(), s.size(), def);
+}
+
+bool Str_BoolN (const string &s, const bool def) {
+	return SpanBool (s.data(), s.size(), def);
 }
 
 float Str_FloatN (const string &s, const float def) {
-	float val;
-	istringstream is(s);
-	is >> val;
-	if (is.fail()) return def;
-	else return val;
+	return SpanFloat (s.data(), s.size(), def);
 }
 
 template<typename T>
 TVector2<T> Str_Vector2(const string &s, const TVector2<T> &def) {
-	T x, y;
-	istringstream is(s);
-	is >> x >> y;
-	if (is.fail()) return def;
-	else return TVector2<T>(x, y);
+	return SpanVector2 (s.data(), s.size(), def);
 }
 template TVector2<ETR_DOUBLE> Str_Vector2(const string &s, const TVector2<ETR_DOUBLE> &def);
 template TVector2<int> Str_Vector2(const string &s, const TVector2<int> &def);
 
 template<typename T>
 TVector3<T> Str_Vector3(const string &s, const TVector3<T> &def) {
-	T x, y, z;
-	istringstream is(s);
-	is >> x >> y >> z;
-	if (is.fail()) return def;
-	else return TVector3<T>(x, y, z);
+	return SpanVector3 (s.data(), s.size(), def);
 }
 template TVector3<ETR_DOUBLE> Str_Vector3(const string &s, const TVector3<ETR_DOUBLE> &def);
 template TVector3<int> Str_Vector3(const string &s, const TVector3<int> &def);
 
 template<typename T>
 TVector4<T> Str_Vector4(const string &s, const TVector4<T> &def) {
-	T x, y, z, w;
-	istringstream is(s);
-	is >> x >> y >> z >> w;
-	if (is.fail()) return def;
-	else return TVector4<T>(x, y, z, w);
+	return SpanVector4 (s.data(), s.size(), def);
 }
 template TVector4<ETR_DOUBLE> Str_Vector4(const string &s, const TVector4<ETR_DOUBLE> &def);
 template TVector4<int> Str_Vector4(const string &s, const TVector4<int> &def);
 
 
 TColor Str_ColorN (const string &s, const TColor &def) {
-	float r, g, b, a;
-	istringstream is(s);
-	is >> r >> g >> b >> a;
-	if (is.fail()) return def;
-	else return TColor(r, g, b, a);
+	return SpanColor (s.data(), s.size(), def);
 }
 
 TColor3 Str_Color3N (const string &s, const TColor3 &def) {
-	float r, g, b;
-	istringstream is(s);
-	is >> r >> g >> b;
-	if (is.fail()) return def;
-	else return TColor3(r, g, b);
+	return SpanColor3 (s.data(), s.size(), def);
 }
 
 void Str_ArrN (const string &s, float *arr, size_t count, float def) {
-	istringstream is(s);
-	for (size_t i = 0; i < count; i++)
-		is >> arr[i];
-	if (is.fail())
-		for (size_t i=0; i<count; i++) arr[i] = def;
+	SpanArr (s.data(), s.size(), arr, count, def);
 }
 
 // --------------------------------------------------------------------
 //				SP functions for parsing lines
 // --------------------------------------------------------------------
 
-string SPItemN (const string &s, const string &tag) {
-	if (s.empty() || tag.empty()) return "";
-
-	string tg = '[' + tag + ']';
-	size_t i = SPosN (s, tg);
-	if (i == string::npos) return "";
-	size_t ii = i + tg.size();
-	string item;
-	while (ii < s.size() && s[ii] != '[' && s[ii] != '#') {
-		item += s[ii];
-		ii++;
+// Finds the first "[tag]" in the text. The value runs up to the next
+// '[' or '#' or the end of the text.
+static bool SPFind (const char *s, size_t len, const char *tag, size_t taglen,
+                    const char **val, size_t *vallen) {
+	if (taglen == 0) return false;
+	const char *end = s + len;
+	const char *p = s;
+	while (end - p >= (ptrdiff_t)taglen + 2) {
+		p = (const char*)memchr (p, '[', end - p - taglen - 1);
+		if (p == NULL) return false;
+		if (p[taglen+1] == ']' && memcmp (p+1, tag, taglen) == 0) {
+			const char *v = p + taglen + 2;
+			const char *e = v;
+			while (e < end && *e != '[' && *e != '#') e++;
+			*val = v;
+			*vallen = e - v;
+			return true;
+		}
+		p++;
 	}
-	return item;
+	return false;
+}
+
+static inline bool SPFindN (const string &s, const string &tag, const char **val, size_t *vallen) {
+	*val = NULL;
+	*vallen = 0;
+	return SPFind (s.data(), s.size(), tag.data(), tag.size(), val, vallen);
+}
+
+string SPItemN (const string &s, const string &tag) {
+	const char *val;
+	size_t len;
+	if (!SPFindN (s, tag, &val, &len)) return "";
+	return string (val, len);
 }
 
 string SPStrN (const string &s, const string &tag, const string& def) {
-	string item = SPItemN (s, tag);
-	if (item.empty()) return def;
-	STrimN (item);
-	return item;
+	const char *val;
+	size_t len;
+	SPFindN (s, tag, &val, &len);
+	return SpanStr (val, len, def);
 }
 
 int SPIntN (const string &s, const string &tag, const int def) {
-	return (Str_IntN (SPItemN (s, tag), def));
+	const char *val;
+	size_t len;
+	SPFindN (s, tag, &val, &len);
+	return SpanInt (val, len, def);
 }
 
 bool SPBoolN (const string &s, const string &tag, const bool def) {
-	string item = SPItemN (s, tag);
-	STrimN (item);
-	return Str_BoolN (item, def);
+	const char *val;
+	size_t len;
+	SPFindN (s, tag, &val, &len);
+	TrimSpan (val, len);
+	return SpanBool (val, len, def);
 }
 
 float SPFloatN (const string &s, const string &tag, const float def) {
-	return (Str_FloatN (SPItemN (s, tag), def));
+	const char *val;
+	size_t len;
+	SPFindN (s, tag, &val, &len);
+	return SpanFloat (val, len, def);
 }
 
 template<typename T>
 TVector2<T> SPVector2 (const string &s, const string &tag, const TVector2<T>& def) {
-	return (Str_Vector2(SPItemN (s, tag), def));
+	const char *val;
+	size_t len;
+	SPFindN (s, tag, &val, &len);
+	return SpanVector2 (val, len, def);
 }
 template TVector2<int> SPVector2(const string &s, const string &tag, const TVector2<int>& def);
 template TVector2<ETR_DOUBLE> SPVector2(const string &s, const string &tag, const TVector2<ETR_DOUBLE>& def);
 
 template<typename T>
 TVector3<T> SPVector3(const string &s, const string &tag, const TVector3<T>& def) {
-	return (Str_Vector3(SPItemN(s, tag), def));
+	const char *val;
+	size_t len;
+	SPFindN (s, tag, &val, &len);
+	return SpanVector3 (val, len, def);
 }
 template TVector3<int> SPVector3(const string &s, const string &tag, const TVector3<int>& def);
 template TVector3<ETR_DOUBLE> SPVector3(const string &s, const string &tag, const TVector3<ETR_DOUBLE>& def);
 
 template<typename T>
 TVector4<T> SPVector4(const string &s, const string &tag, const TVector4<T>& def) {
-	return (Str_Vector4(SPItemN(s, tag), def));
+	const char *val;
+	size_t len;
+	SPFindN (s, tag, &val, &len);
+	return SpanVector4 (val, len, def);
 }
 template TVector4<int> SPVector4(const string &s, const string &tag, const TVector4<int>& def);
 template TVector4<ETR_DOUBLE> SPVector4(const string &s, const string &tag, const TVector4<ETR_DOUBLE>& def);
 
 TColor SPColorN (const string &s, const string &tag, const TColor& def) {
-	return (Str_ColorN (SPItemN (s, tag), def));
+	const char *val;
+	size_t len;
+	SPFindN (s, tag, &val, &len);
+	return SpanColor (val, len, def);
 }
 
 TColor3 SPColor3N (const string &s, const string &tag, const TColor3& def) {
-	return (Str_Color3N (SPItemN (s, tag), def));
+	const char *val;
+	size_t len;
+	SPFindN (s, tag, &val, &len);
+	return SpanColor3 (val, len, def);
 }
 
 void SPArrN (const string &s, const string &tag, float *arr, size_t count, float def) {
-	Str_ArrN (SPItemN (s, tag), arr, count, def);
+	const char *val;
+	size_t len;
+	SPFindN (s, tag, &val, &len);
+	SpanArr (val, len, arr, count, def);
 }
 
 size_t SPPosN (const string &s, const string &tag) {
@@ -264,6 +410,129 @@ size_t SPPosN (const string &s, const string &tag) {
 	return SPosN (s, tg);
 }
 
+// --------------------------------------------------------------------
+//				CSPLine
+// --------------------------------------------------------------------
+
+void CSPLine::Parse (const char *s, size_t len) {
+	num = 0;
+	rest = NULL;
+	end = s + len;
+
+	const char *p = (const char*)memchr (s, '[', len);
+	while (p != NULL) {
+		const char *close = (const char*)memchr (p + 1, ']', end - p - 1);
+		if (close == NULL) break;
+		// "[a [b] x" has the tag b, as SPFind sees it
+		const char *inner = (const char*)memchr (p + 1, '[', close - p - 1);
+		if (inner != NULL) {
+			p = inner;
+			continue;
+		}
+		if (num == SP_MAX_TAGS) {
+			rest = p;
+			break;
+		}
+		const char *v = close + 1;
+		const char *e = v;
+		while (e < end && *e != '[' && *e != '#') e++;
+
+		TSPItem& item = items[num++];
+		item.tag = p + 1;
+		item.taglen = close - p - 1;
+		item.val = v;
+		item.vallen = e - v;
+
+		p = e < end ? (const char*)memchr (e, '[', end - e) : NULL;
+	}
+}
+
+bool CSPLine::Find (const char *tag, const char **val, size_t *len) const {
+	size_t taglen = strlen (tag);
+	*val = NULL;
+	*len = 0;
+	if (taglen == 0) return false;
+	for (size_t i = 0; i < num; i++) {
+		if (items[i].taglen == taglen && memcmp (items[i].tag, tag, taglen) == 0) {
+			*val = items[i].val;
+			*len = items[i].vallen;
+			return true;
+		}
+	}
+	if (rest != NULL) return SPFind (rest, end - rest, tag, taglen, val, len);
+	return false;
+}
+
+bool CSPLine::Has (const char *tag) const {
+	const char *val;
+	size_t len;
+	return Find (tag, &val, &len);
+}
+
+string CSPLine::Str (const char *tag, const string& def) const {
+	const char *val;
+	size_t len;
+	Find (tag, &val, &len);
+	return SpanStr (val, len, def);
+}
+
+int CSPLine::Int (const char *tag, const int def) const {
+	const char *val;
+	size_t len;
+	Find (tag, &val, &len);
+	return SpanInt (val, len, def);
+}
+
+bool CSPLine::Bool (const char *tag, const bool def) const {
+	const char *val;
+	size_t len;
+	Find (tag, &val, &len);
+	TrimSpan (val, len);
+	return SpanBool (val, len, def);
+}
+
+float CSPLine::Float (const char *tag, const float def) const {
+	const char *val;
+	size_t len;
+	Find (tag, &val, &len);
+	return SpanFloat (val, len, def);
+}
+
+TVector2d CSPLine::Vector2 (const char *tag, const TVector2d& def) const {
+	const char *val;
+	size_t len;
+	Find (tag, &val, &len);
+	return SpanVector2 (val, len, def);
+}
+
+TVector3d CSPLine::Vector3 (const char *tag, const TVector3d& def) const {
+	const char *val;
+	size_t len;
+	Find (tag, &val, &len);
+	return SpanVector3 (val, len, def);
+}
+
+TColor CSPLine::Color (const char *tag, const TColor& def) const {
+	const char *val;
+	size_t len;
+	Find (tag, &val, &len);
+	return SpanColor (val, len, def);
+}
+
+TColor3 CSPLine::Color3 (const char *tag, const TColor3& def) const {
+	const char *val;
+	size_t len;
+	Find (tag, &val, &len);
+	return SpanColor3 (val, len, def);
+}
+
+void CSPLine::Arr (const char *tag, float *arr, size_t count, float def) const {
+	const char *val;
+	size_t len;
+	Find (tag, &val, &len);
+	SpanArr (val, len, arr, count, def);
+}
+
 // ------------------ add ---------------------------------------------
 
 void SPAddIntN (string &s, const string &tag, const int val) {
@@ -386,52 +655,93 @@ void CSPList::Print () const {
 		cout << flines[i] << endl;
 }
 
-bool CSPList::Load (const string &filepath) {
-	std::ifstream tempfile(filepath.c_str());
-	string line;
+// The file is mapped (or read in one block) and split into lines in
+// place. Empty lines and comments are skipped. Without newlineflag a
+// line that doesn't start with '*' continues the previous one, with
+// newlineflag a trailing '\' joins the next line. Only such joined
+// lines are copied, all others are passed as views into the buffer.
 
-	if (!tempfile) {
+bool CSPList::Stream (const string& filepath, CSPVisitor& visitor, bool newlineflag) {
+	CMappedFile file;
+	if (!file.Open (filepath)) {
 		Message ("CSPList::Load - unable to open " + filepath);
 		return false;
-	} else {
-		bool backflag = false;
-		while (getline(tempfile, line)) {
-
-			// delete new line char if in string
-			size_t npos = line.rfind ('\n');
-			if (npos != string::npos) SDeleteN (line, npos, 1);
-
-			bool valid = true;
-			if (line.empty()) valid = false;	// empty line
-			else if (line[0] == '#') valid = false;	// comment line
-
-			if (valid) {
-				if (flines.size() < fmax) {
-					if (!fnewlineflag) {
-						if (line[0] == '*' || flines.empty()) Add (line);
-						else Append (line, flines.size()-1);
-					} else {
-						bool fwdflag;
-						if (line[line.length()-1] == '\\') {
-							SDeleteN (line, line.length()-1, 1);
-							fwdflag = true;
-						} else {
-							fwdflag = false;
-						}
-
-						if (backflag == false) Add (line);
-						else Append (line, flines.size()-1);
-
-						backflag = fwdflag;
-					}
-				} else {
-					Message ("CSPList::Load - not enough lines");
-					return false;
-				}
+	}
+
+	const char *p = (const char*)file.Data();
+	const char *end = p + file.Size();
+	const char *pending = NULL;	// logical line not yet passed on
+	size_t pendinglen = 0;
+	string joined;				// used if the logical line is split
+	bool isjoined = false;
+	bool backflag = false;
+
+	while (p < end) {
+		const char *nl = (const char*)memchr (p, '\n', end - p);
+		const char *lineend = nl ? nl : end;
+		const char *line = p;
+		size_t len = lineend - p;
+		p = nl ? nl + 1 : end;
+
+		if (len == 0 || line[0] == '#') continue;
+
+		bool startnew;
+		if (!newlineflag) {
+			startnew = (line[0] == '*' || pending == NULL);
+		} else {
+			startnew = !backflag;
+			backflag = (line[len-1] == '\\');
+			if (backflag) len--;
+		}
+
+		if (startnew) {
+			if (pending != NULL) {
+				if (isjoined) visitor.Visit (joined.data(), joined.size());
+				else visitor.Visit (pending, pendinglen);
 			}
+			pending = line;
+			pendinglen = len;
+			isjoined = false;
+		} else {
+			if (!isjoined) {
+				joined.assign (pending, pendinglen);
+				isjoined = true;
+			}
+			joined.append (line, len);
 		}
-		return true;
 	}
+	if (pending != NULL) {
+		if (isjoined) visitor.Visit (joined.data(), joined.size());
+		else visitor.Visit (pending, pendinglen);
+	}
+	return true;
+}
+
+bool CSPList::Stream (const string& dir, const string& filename, CSPVisitor& visitor, bool newlineflag) {
+	return Stream (dir + SEP + filename, visitor, newlineflag);
+}
+
+// Keeps at most max lines, callers size fixed arrays by it
+class CCollectVisitor : public CSPVisitor {
+	vector<string>& lines;
+	size_t max;
+public:
+	bool overflow;
+	CCollectVisitor (vector<string>& l, size_t m) : lines(l), max(m), overflow(false) {}
+	void Visit (const char *line, size_t len) {
+		if (lines.size() < max) lines.push_back (string (line, len));
+		else overflow = true;
+	}
+};
+
+bool CSPList::Load (const string &filepath) {
+	CCollectVisitor collect (flines, fmax);
+	if (!Stream (filepath, collect, fnewlineflag)) return false;
+	if (collect.overflow) {
+		Message ("CSPList::Load - not enough lines");
+		return false;
+	}
+	return true;
 }
 
 bool CSPList::Load (const string& dir, const string& filename) {
@@ -460,8 +770,7 @@ void CSPList::MakeIndex (map<string, size_t>& index, const string &tag) {
 	size_t idx = 0;
 
 	for (size_t i=0; i<flines.size(); i++) {
-		string item = SPItemN (flines[i], tag);
-		STrimN (item);
+		string item = SPStrN (flines[i], tag);
 		if (!item.empty()) {
 			index[item] = idx;
 			idx++;
@@ -78,6 +78,46 @@ TColor   SPColorN     (const string &s, const string &tag, const TColor& def);
 TColor3  SPColor3N    (const string &s, const string &tag, const TColor3& def);
 void     SPArrN       (const string &s, const string &tag, float *arr, size_t count, float def);
 
+// ----- parsed SP line -----------------------------------------------
+// Splits a line once into its [tag] value pairs, for reading several
+// tags of the same line. Nothing is copied, the values point into the
+// parsed text, so the text must outlive the CSPLine. Lookups give the
+// same results as the SP*N functions above.
+
+#define SP_MAX_TAGS 32
+
+class CSPLine {
+	struct TSPItem {
+		const char *tag;
+		size_t taglen;
+		const char *val;
+		size_t vallen;
+	};
+	TSPItem items[SP_MAX_TAGS];
+	size_t num;
+	const char *rest;		// unparsed text if there are more tags
+	const char *end;
+public:
+	CSPLine () : num(0), rest(NULL), end(NULL) {}
+	CSPLine (const string& s) { Parse (s.data(), s.size()); }
+	CSPLine (const char *s, size_t len) { Parse (s, len); }
+
+	void Parse (const char *s, size_t len);
+	size_t Count () const { return num; }
+	bool Find (const char *tag, const char **val, size_t *len) const;
+	bool Has (const char *tag) const;
+
+	string Str (const char *tag, const string& def = emptyString) const;
+	int Int (const char *tag, const int def) const;
+	bool Bool (const char *tag, const bool def) const;
+	float Float (const char *tag, const float def) const;
+	TVector2d Vector2 (const char *tag, const TVector2d& def = NullVec2) const;
+	TVector3d Vector3 (const char *tag, const TVector3d& def = NullVec3) const;
+	TColor Color (const char *tag, const TColor& def) const;
+	TColor3 Color3 (const char *tag, const TColor3& def) const;
+	void Arr (const char *tag, float *arr, size_t count, float def) const;
+};
+
 // ----- making SP strings --------------------------------------------
 void     SPAddIntN    (string &s, const string &tag, const int val);
 void     SPAddFloatN  (string &s, const string &tag, const float val, size_t count);
@@ -95,14 +135,26 @@ void     SPSetStrN    (string &s, const string &tag, const string &val);
 //		 string list
 // --------------------------------------------------------------------
 
+// Receives the logical lines of a list file one after another, see
+// CSPList::Stream. The text is only valid during the call.
+class CSPVisitor {
+public:
+	virtual ~CSPVisitor () {}
+	virtual void Visit (const char *line, size_t len) = 0;
+};
+
 class CSPList {
 private:
 	vector<string> flines;
 	size_t fmax;
 	bool fnewlineflag;
 public:
+	// at most maxlines lines are kept, Load fails if the file has more
 	CSPList (size_t maxlines, bool newlineflag = false);
 
+	static bool Stream (const string& filepath, CSPVisitor& visitor, bool newlineflag = false);
+	static bool Stream (const string& dir, const string& filename, CSPVisitor& visitor, bool newlineflag = false);
+
 	const string& Line (size_t idx) const;
 	size_t Count () const { return flines.size(); }
 	void Clear () { flines.clear(); }
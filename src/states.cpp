@@ -22,6 +22,9 @@ GNU General Public License for more details.
 #include "states.h"
 #include "ogl.h"
 #include "winsys.h"
+#include "font.h"
+#include "textures.h"
+#include "profiler.h"
 #include <ctime>
 #include <ubuntu/application/sensors/accelerometer.h>
 
@@ -47,10 +50,12 @@ State::Manager::~Manager() {
 }
 
 void State::Manager::Run(State& entranceState) {
-	SDL_setenv("UBUNTU_PLATFORM_API_BACKEND", "touch_mirclient", 1);
-	accel = ua_sensors_accelerometer_new();
-	ua_sensors_accelerometer_set_reading_cb(accel, tilt_cb, 0);
-	ua_sensors_accelerometer_enable(accel);
+	if (!Winsys.IsHeadless()) {
+		SDL_setenv("UBUNTU_PLATFORM_API_BACKEND", "touch_mirclient", 1);
+		accel = ua_sensors_accelerometer_new();
+		ua_sensors_accelerometer_set_reading_cb(accel, tilt_cb, 0);
+		ua_sensors_accelerometer_enable(accel);
+	}
 
 	current = &entranceState;
 	current->Enter();
@@ -240,5 +245,9 @@ void State::Manager::CallLoopFunction() {
 	g_game.time_step = cur_time - clock_time;
 	if (g_game.time_step < 0.0001) g_game.time_step = 0.0001;
 	clock_time = cur_time;
+	FT.NewFrame();
+	Tex.NewFrame();
+	PROFILE_NEW_FRAME();
+	GLSTATS_NEW_FRAME();
 	current->Loop();
 }
@@ -49,6 +49,8 @@ public:
 		void EnterNextState();
 	public:
 		void RequestEnterState(State& state) { next = &state; }
+		void CancelRequest() { next = NULL; }
+		State* NextState() { return next; }
 		void RequestQuit() { quit = true; }
 		void Run(State& entranceState);
 		State* PreviousState() { return previous; }
@@ -345,8 +345,24 @@ void CImage::WriteBMP (const char *filepath) {
 // --------------------------------------------------------------------
 //				class TTexture
 // --------------------------------------------------------------------
+static GLuint currentTexID = 0;
+
 TTexture::~TTexture() {
+	Unload();
+}
+
+void TTexture::Unload() {
+	if (id == 0) return;
+	// GL reuses the names of deleted textures
+	if (currentTexID == id) currentTexID = 0;
 	glDeleteTextures (1, &id);
+	id = 0;
+	bytes = 0;
+}
+
+void TTexture::SetBytes(int nx, int ny, int depth, bool mipmapped) {
+	bytes = (size_t)nx * ny * depth;
+	if (mipmapped) bytes += bytes / 3;
 }
 
 bool TTexture::Load(const string& filename) {
@@ -358,6 +374,9 @@ bool TTexture::Load(const string& filename) {
 #ifdef USE_GLES1
 	width = texImage.nx;
 	height= texImage.ny;
+	SetBytes (GLES2D_p2(texImage.nx), GLES2D_p2(texImage.ny), texImage.depth, false);
+#else
+	SetBytes (texImage.nx, texImage.ny, texImage.depth, false);
 #endif
 
 	glGenTextures (1, &id);
@@ -394,7 +413,10 @@ bool TTexture::LoadMipmap(const string& filename, bool repeatable) {
     CImage texImage;
 	if (texImage.LoadPng (filename.c_str(), true,!repeatable) == false)
 		return false;
+	return LoadMipmap (texImage, repeatable);
+}
 
+bool TTexture::LoadMipmap(CImage& texImage, bool repeatable) {
 	glGenTextures (1, &id);
 	Bind();
     glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
@@ -423,6 +445,7 @@ bool TTexture::LoadMipmap(const string& filename, bool repeatable) {
 	glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
 	if (repeatable)
 	{
+		SetBytes (texImage.nx, texImage.ny, texImage.depth, true);
 		glTexImage2D
 			(GL_TEXTURE_2D, 0, format, texImage.nx,
 			texImage.ny, 0, format, GL_UNSIGNED_BYTE, texImage.data);
@@ -430,11 +453,13 @@ bool TTexture::LoadMipmap(const string& filename, bool repeatable) {
 	else
 	{
 		int squared = GLES2D_p2(max(texImage.nx,texImage.ny));
+		SetBytes (squared, squared, texImage.depth, true);
 		glTexImage2D
 			(GL_TEXTURE_2D, 0, format, squared,
 			squared, 0, format, GL_UNSIGNED_BYTE, texImage.data);
 	}
 #else
+	SetBytes (texImage.nx, texImage.ny, texImage.depth, true);
 	gluBuild2DMipmaps
 		(GL_TEXTURE_2D, texImage.depth, texImage.nx,
 		texImage.ny, format, GL_UNSIGNED_BYTE, texImage.data);
@@ -445,9 +470,11 @@ bool TTexture::LoadMipmap(const string& filename, bool repeatable) {
 bool TTexture::LoadMipmap(const string& dir, const string& filename, bool repeatable) {
 	return LoadMipmap(dir + SEP + filename, repeatable);
 }
-static GLuint currentTexID = 0;
-
 void TTexture::Bind() {
+	if (managed) {
+		if (id == 0) Tex.MakeResident (this);
+		lastUsed = Tex.frame;
+	}
 	if (currentTexID != id)
 	{
 		glBindTexture (GL_TEXTURE_2D, id);
@@ -573,6 +600,7 @@ void TTexture::Draw(int x, int y, float width, float height, Orientation orienta
 }
 
 void TTexture::DrawFrame(int x, int y, ETR_DOUBLE w, ETR_DOUBLE h, int frame, const TColor& col) {
+	Bind();
 	if (id < 1)
 		return;
 
@@ -581,8 +609,6 @@ void TTexture::DrawFrame(int x, int y, ETR_DOUBLE w, ETR_DOUBLE h, int frame, co
 	GLshort xx = x;
 	GLshort yy = Winsys.resolution.height - hh - y;
 
-	Bind();
-
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
@@ -634,12 +660,103 @@ void TTexture::DrawFrame(int x, int y, ETR_DOUBLE w, ETR_DOUBLE h, int frame, co
 
 CTexture Tex;
 
+// Set when Tex is destroyed. Other globals may still release their
+// textures from their destructors afterwards.
+static bool texturesDestroyed = false;
+
 CTexture::CTexture () {
 	forientation = OR_TOP;
+	frame = 1;
 }
 
 CTexture::~CTexture () {
 	FreeTextureList();
+	for (map<string, TTexture*>::iterator it = Managed.begin(); it != Managed.end(); ++it)
+		delete it->second;
+	Managed.clear();
+	texturesDestroyed = true;
+}
+
+TTexture* CTexture::Acquire (const string& filepath, bool mipmap, bool repeatable) {
+	map<string, TTexture*>::iterator it = Managed.find (filepath);
+	if (it != Managed.end()) {
+		it->second->refs++;
+		return it->second;
+	}
+
+	TTexture* tex = new TTexture();
+	tex->source = filepath;
+	tex->managed = true;
+	tex->mipmap = mipmap;
+	tex->repeatable = repeatable;
+	tex->refs = 1;
+	Managed[filepath] = tex;
+	stats.managed++;
+	return tex;
+}
+
+void CTexture::Release (TTexture* tex) {
+	if (tex == NULL || texturesDestroyed) return;
+	if (--tex->refs > 0) return;
+
+	Managed.erase (tex->source);
+	stats.managed--;
+	if (tex->id != 0) {
+		stats.resident--;
+		stats.residentBytes -= tex->bytes;
+	}
+	delete tex;
+}
+
+bool CTexture::MakeResident (TTexture* tex) {
+	if (tex->id != 0) return true;
+	if (!tex->managed || tex->failed) return false;
+
+	bool ok;
+	if (tex->mipmap) ok = tex->LoadMipmap (tex->source, tex->repeatable);
+	else ok = tex->Load (tex->source);
+	if (!ok) {
+		tex->failed = true;
+		return false;
+	}
+
+	tex->lastUsed = frame;
+	stats.loads++;
+	stats.frameLoads++;
+	stats.resident++;
+	stats.residentBytes += tex->bytes;
+	TrimResident ();
+	stats.peakBytes = max (stats.peakBytes, stats.residentBytes);
+	return true;
+}
+
+// Unloads the textures that were not bound for the longest time until
+// the budget is kept again. Textures used in the current frame stay, so
+// a frame that needs more than the budget only exceeds it.
+void CTexture::TrimResident () {
+	if (param.texture_memory <= 0) return;
+	size_t budget = (size_t)param.texture_memory * 1024 * 1024;
+
+	while (stats.residentBytes > budget) {
+		TTexture* oldest = NULL;
+		for (map<string, TTexture*>::iterator it = Managed.begin(); it != Managed.end(); ++it) {
+			TTexture* tex = it->second;
+			if (tex->id == 0 || tex->lastUsed == frame) continue;
+			if (oldest == NULL || tex->lastUsed < oldest->lastUsed) oldest = tex;
+		}
+		if (oldest == NULL) break;
+
+		stats.resident--;
+		stats.residentBytes -= oldest->bytes;
+		stats.evictions++;
+		oldest->Unload();
+	}
+}
+
+void CTexture::NewFrame () {
+	frame++;
+	stats.lastFrameLoads = stats.frameLoads;
+	stats.frameLoads = 0;
 }
 
 void CTexture::LoadTextureList () {
@@ -654,12 +771,8 @@ void CTexture::LoadTextureList () {
 			string texfile = SPStrN (line, "file");
 			bool rep = SPBoolN (line, "repeat", false);
 			if (id >= 0) {
-				CommonTex[id] = new TTexture();
-				if (rep)
-					CommonTex[id]->LoadMipmap(param.tex_dir, texfile, rep);
-				else
-					CommonTex[id]->Load(param.tex_dir, texfile);
-
+				Release (CommonTex[id]);
+				CommonTex[id] = Acquire (param.tex_dir + SEP + texfile, rep, rep);
 				Index[name] = CommonTex[id];
 			} else Message ("wrong texture id in textures.lst");
 		}
@@ -668,7 +781,7 @@ void CTexture::LoadTextureList () {
 
 void CTexture::FreeTextureList () {
 	for (size_t i=0; i<CommonTex.size(); i++) {
-		delete CommonTex[i];
+		Release (CommonTex[i]);
 	}
 	CommonTex.clear();
 	Index.clear();
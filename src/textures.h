@@ -96,14 +96,30 @@ class TTexture {
 	TTexture& operator=(const TTexture&);
 
 	GLuint id;
+
+	// managed textures (see CTexture::Acquire) are decoded and uploaded
+	// on the first Bind and may be unloaded again by the memory budget
+	string source;
+	bool managed;
+	bool mipmap;
+	bool repeatable;
+	bool failed;		// don't retry a file that could not be loaded
+	int refs;
+	size_t bytes;		// estimated GPU memory, 0 if not resident
+	unsigned int lastUsed;	// CTexture frame of the last Bind
+
+	void SetBytes(int nx, int ny, int depth, bool mipmapped);
+	void Unload();
+	friend class CTexture;
 public:
 
-	TTexture() : id(0) {}
+	TTexture() : id(0), managed(false), mipmap(false), repeatable(false), failed(false), refs(0), bytes(0), lastUsed(0) {}
 	~TTexture();
 	bool Load(const string& filename);
 	bool Load(const string& dir, const string& filename);
 	bool LoadMipmap(const string& filename, bool repeatable);
 	bool LoadMipmap(const string& dir, const string& filename, bool repeatable);
+	bool LoadMipmap(CImage& texImage, bool repeatable);	// decoded with needsquared = !repeatable
 
 	void Bind();
 	void Draw();
@@ -116,19 +132,48 @@ public:
 #endif
 };
 
+struct TTextureStats {
+	size_t residentBytes;	// estimated GPU memory of the managed textures
+	size_t peakBytes;
+	unsigned int resident;	// managed textures currently uploaded
+	unsigned int managed;	// all managed textures, loaded or not
+	unsigned int loads;
+	unsigned int evictions;
+	unsigned int frameLoads;	// loads in the current frame
+	unsigned int lastFrameLoads;	// loads in the previous frame
+	TTextureStats() : residentBytes(0), peakBytes(0), resident(0), managed(0),
+		loads(0), evictions(0), frameLoads(0), lastFrameLoads(0) {}
+};
+
 class CTexture {
 private:
 	vector<TTexture*> CommonTex;
 	map<string, TTexture*> Index;
+	map<string, TTexture*> Managed;	// by file path
 	Orientation forientation;
+	unsigned int frame;
+	TTextureStats stats;
 
 	void DrawNumChr (char c, int x, int y, int w, int h, const TColor& col);
+	void TrimResident ();
+	friend class TTexture;
 public:
 	CTexture ();
 	~CTexture ();
 	void LoadTextureList ();
 	void FreeTextureList ();
 
+	// Managed textures are shared by file path and reference counted.
+	// Nothing is loaded before the first use; afterwards the textures
+	// that were not bound for the longest time are unloaded again if
+	// param.texture_memory is exceeded. Release deletes the texture
+	// when the last reference is gone.
+	TTexture* Acquire (const string& filepath, bool mipmap, bool repeatable);
+	void Release (TTexture* tex);
+	bool MakeResident (TTexture* tex);
+	void NewFrame ();
+	const TTextureStats& Stats () const { return stats; }
+
 	TTexture* GetTexture (size_t idx) const;
 	TTexture* GetTexture (const string& name) const;
 	bool BindTex (size_t idx);
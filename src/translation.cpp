@@ -180,24 +180,28 @@ const string& CTranslation::GetLanguage (const string& lang) const {
 	return GetLanguage (GetLangIdx (lang));
 }
 
+class CTranslationVisitor : public CSPVisitor {
+	string *texts;
+	CSPLine line;
+public:
+	CTranslationVisitor (string *t) : texts(t) {}
+	void Visit (const char *s, size_t len) {
+		line.Parse (s, len);
+		int idx = line.Int ("idx", -1);
+		if (idx >= 0 && idx < NUM_COMMON_TEXTS) {
+			texts[idx] = line.Str ("trans", texts[idx]);
+		}
+	}
+};
+
 void CTranslation::LoadTranslations (size_t langidx) {
 	SetDefaultTranslations ();
 	if (langidx == 0 || langidx >= languages.size()) return;
 
-	CSPList list(MAX_COMMON_TEXT_LINES);
 	string filename = languages[langidx].lang + ".lst";
-	if (!list.Load (param.trans_dir, filename)) {
+	CTranslationVisitor visitor (texts);
+	if (!CSPList::Stream (param.trans_dir, filename, visitor))
 		Message ("could not load translations list:", filename);
-		return;
-	}
-
-	for (size_t i=0; i<list.Count(); i++) {
-		const string& line = list.Line(i);
-		int idx = SPIntN (line, "idx", -1);
-		if (idx >= 0 && idx < NUM_COMMON_TEXTS) {
-			texts[idx] = SPStrN (line, "trans", texts[idx]);
-		}
-	}
 }
 
 string CTranslation::GetSystemDefaultLang() {
@@ -29,7 +29,6 @@ An name convention:
 
 #define MAX_LANGUAGES 32
 #define NUM_COMMON_TEXTS 95
-#define MAX_COMMON_TEXT_LINES NUM_COMMON_TEXTS*2
 
 
 struct TLang {
@@ -30,8 +30,11 @@ still shaped with spheres.
 #include "textures.h"
 #include "course.h"
 #include "physics.h"
+#include "game_ctrl.h"
 //#include <GL/glu.h>
 #include <algorithm>
+#include <cstring>
+#include <fstream>
 
 #define MAX_ARM_ANGLE2 30.0
 #define MAX_PADDLING_ANGLE2 35.0
@@ -51,51 +54,79 @@ static const TColor shad_col(0.0, 0.0, 0.0, 0.1);
 static const TCharMaterial TuxDefMat = {TColor(0.5, 0.5, 0.5, 1.0), TColor(0.0, 0.0, 0.0, 1.0), 0.0, string()};
 static const TCharMaterial Highlight = {TColor(0.8, 0.15, 0.15, 1.0), TColor(0.0, 0.0, 0.0, 1.0), 0.0, string()};
 
-static int numpoints = 0;
-static bool bVerticesLoaded = false;
-static GLfloat charvertices[30000];
-static GLushort charvertexcount[10000];
+// Unit spheres for every number of divisions, shared by all characters.
+// Each one is a single triangle strip of d stacks and 2d slices; the
+// positions are also the normals. They are built on the first draw and
+// kept in client memory: the flattened path transforms them on the CPU
+// and DrawNodes draws them directly.
+struct TSphereMesh {
+	GLint first;
+	GLsizei count;
+};
+static vector<GLfloat> sphereVertices;
+static TSphereMesh sphereMeshes[MAX_SPHERE_DIV+1];
+
+// Nodes closer to the eye than this get their own number of divisions,
+// beyond it the divisions fall with 1 / distance.
+#define SPHERE_LOD_DIST 5.0
+
+static void AddSpherePoint (ETR_DOUBLE phi, ETR_DOUBLE theta) {
+	sphereVertices.push_back (sin(phi) * cos(theta));
+	sphereVertices.push_back (sin(phi) * sin(theta));
+	sphereVertices.push_back (cos(phi));
+}
+
+// The bands are joined by two degenerate triangles. A band has an even
+// number of vertices, so every band starts with the same winding, and
+// so does every sphere in the flattened strips.
+static void BuildSphereMeshes () {
+	for (int d=MIN_SPHERE_DIV; d<=MAX_SPHERE_DIV; d++) {
+		sphereMeshes[d].first = (GLint)(sphereVertices.size() / 3);
+		for (int s=0; s<d; s++) {
+			ETR_DOUBLE phi0 = M_PI * s / d;
+			ETR_DOUBLE phi1 = M_PI * (s+1) / d;
+			if (s > 0) {
+				size_t last = sphereVertices.size() - 3;
+				for (int k=0; k<3; k++) sphereVertices.push_back (sphereVertices[last+k]);
+				AddSpherePoint (phi0, 0);
+			}
+			for (int k=0; k<=2*d; k++) {
+				ETR_DOUBLE theta = M_PI * k / d;
+				AddSpherePoint (phi0, theta);
+				AddSpherePoint (phi1, theta);
+			}
+		}
+		sphereMeshes[d].count = (GLsizei)(sphereVertices.size() / 3) - sphereMeshes[d].first;
+	}
+	for (int d=0; d<MIN_SPHERE_DIV; d++) sphereMeshes[d] = sphereMeshes[MIN_SPHERE_DIV];
+}
+
+static const char *JointNames[NUM_JOINTS] = {
+	"root", "neck", "head", "left_shldr", "right_shldr", "left_hip", "right_hip",
+	"left_knee", "right_knee", "left_ankle", "right_ankle", "tail"
+};
 
 CCharShape TestChar;
+bool CCharShape::flattenMesh = true;
+TCharDrawStats CCharShape::drawStats;
 
 CCharShape::CCharShape () {
 	for (int i=0; i<MAX_CHAR_NODES; i++) {
 		Nodes[i] = NULL;
 		Index[i] = -1;
 	}
+	for (int j=0; j<NUM_JOINTS; j++) Joints[j] = NULL;
+	for (int i=0; i<MAX_CHAR_NODES; i++) nodeJoint[i] = -1;
 	numNodes = 0;
 
 	useActions = false;
 	newActions = false;
 	useMaterials = true;
 	useHighlighting = false;
+	useCompiled = true;
+	useLod = false;
 	highlighted = false;
 	highlight_node = -1;
-
-	if (!bVerticesLoaded)
-	{
-		float fTheta = 32 * M_PI/180.0;
-		float fPhi = fTheta;
-		int pos = 0;
-		
-		for(float phi = -(M_PI); phi < M_PI; phi+=fPhi) 
-		{
-			for(float theta = 0.0; theta < (2*M_PI); theta+=fTheta) 
-			{
-				charvertices[pos++] = (sin(phi) * cos(theta));
-				charvertices[pos++] = (sin(phi) * sin(theta));
-				charvertices[pos++] = (cos(phi));
-				charvertexcount[numpoints] = numpoints;
-				numpoints++;
-				charvertices[pos++] = (sin(phi+fPhi) * cos(theta));
-				charvertices[pos++] = (sin(phi+fPhi) * sin(theta));
-				charvertices[pos++] = (cos(phi+fPhi));
-				charvertexcount[numpoints] = numpoints;
-				numpoints++;
-			}
-		}
-		bVerticesLoaded = true;
-	}
 }
 
 CCharShape::~CCharShape() {
@@ -125,6 +156,7 @@ TCharNode *CCharShape::GetNode (size_t node_name) {
 void CCharShape::CreateRootNode () {
 	TCharNode *node = new TCharNode;
 	node->node_name = 0;
+	node->node_idx = 0;
 	node->parent = NULL;
 	node->parent_name = 99;
 	node->next = NULL;
@@ -135,6 +167,7 @@ void CCharShape::CreateRootNode () {
 	node->joint = "root";
 	node->render_shadow = false;
 	node->visible = false;
+	node->vis_level = 0;
 	node->action = NULL;
 	node->trans.SetIdentity();
 	node->invtrans.SetIdentity();
@@ -144,6 +177,7 @@ void CCharShape::CreateRootNode () {
 	Index[0] = 0;
 	Nodes[0] = node;
 	numNodes = 1;
+	for (int j=0; j<NUM_JOINTS; j++) Joints[j] = NULL;
 }
 
 bool CCharShape::CreateCharNode(int parent_name, size_t node_name, const string& joint, const string& name, const string& order, bool shadow) {
@@ -173,6 +207,7 @@ bool CCharShape::CreateCharNode(int parent_name, size_t node_name, const string&
 	node->mat   = NULL;
 	node->node_idx = numNodes;
 	node->visible = false;
+	node->vis_level = 0;
 	node->render_shadow = shadow;
 	node->joint = joint;
 
@@ -211,12 +246,8 @@ bool CCharShape::TranslateNode (size_t node_name, const TVector3d& vec) {
 	TCharNode *node = GetNode (node_name);
 	if (node == NULL) return false;
 
-	TMatrix<4, 4> TransMatrix;
-
-	TransMatrix.SetTranslationMatrix(vec.x, vec.y, vec.z);
-	node->trans = node->trans * TransMatrix;
-	TransMatrix.SetTranslationMatrix(-vec.x, -vec.y, -vec.z);
-	node->invtrans = TransMatrix * node->invtrans;
+	node->trans.Translate(vec.x, vec.y, vec.z);
+	node->invtrans.PreTranslate(-vec.x, -vec.y, -vec.z);
 
 	if (newActions && useActions) AddAction (node_name, 0, vec, 0);
 	return true;
@@ -228,7 +259,6 @@ bool CCharShape::RotateNode (size_t node_name, int axis, ETR_DOUBLE angle) {
 
 	if (axis > 3) return false;
 
-	TMatrix<4, 4> rotMatrix;
 	char caxis = '0';
 	switch (axis) {
 		case 1:
@@ -242,10 +272,8 @@ bool CCharShape::RotateNode (size_t node_name, int axis, ETR_DOUBLE angle) {
 			break;
 	}
 
-	rotMatrix.SetRotationMatrix(angle, caxis);
-	node->trans = node->trans * rotMatrix;
-	rotMatrix.SetRotationMatrix(-angle, caxis);
-	node->invtrans = rotMatrix * node->invtrans;
+	node->trans.Rotate(angle, caxis);
+	node->invtrans.PreRotate(-angle, caxis);
 
 	if (newActions && useActions) AddAction (node_name, axis, NullVec3, angle);
 	return true;
@@ -261,12 +289,8 @@ void CCharShape::ScaleNode (size_t node_name, const TVector3d& vec) {
 	TCharNode *node = GetNode(node_name);
 	if (node == NULL) return;
 
-	TMatrix<4, 4> matrix;
-
-	matrix.SetScalingMatrix(vec.x, vec.y, vec.z);
-	node->trans = node->trans * matrix;
-	matrix.SetScalingMatrix(1.0 / vec.x, 1.0 / vec.y, 1.0 / vec.z);
-	node->invtrans = matrix * node->invtrans;
+	node->trans.Scale(vec.x, vec.y, vec.z);
+	node->invtrans.PreScale(1.0 / vec.x, 1.0 / vec.y, 1.0 / vec.z);
 
 	if (newActions && useActions) AddAction (node_name, 4, vec, 0);
 }
@@ -276,6 +300,7 @@ bool CCharShape::VisibleNode (size_t node_name, float level) {
 	if (node == NULL) return false;
 
 	node->visible = (level > 0);
+	node->vis_level = level;
 
 	if (node->visible) {
 		node->divisions =
@@ -311,7 +336,7 @@ bool CCharShape::ResetNode (const string& node_trivialname) {
 	return ResetNode (i->second);
 }
 
-bool CCharShape::TransformNode(size_t node_name, const TMatrix<4, 4>& mat, const TMatrix<4, 4>& invmat) {
+bool CCharShape::TransformNode(size_t node_name, const TAffine& mat, const TAffine& invmat) {
 	TCharNode *node = GetNode(node_name);
 	if (node == NULL) return false;
 
@@ -320,18 +345,65 @@ bool CCharShape::TransformNode(size_t node_name, const TMatrix<4, 4>& mat, const
 	return true;
 }
 
+void CCharShape::ResolveJoints () {
+	for (int i=0; i<MAX_CHAR_NODES; i++) nodeJoint[i] = -1;
+	for (int j=0; j<NUM_JOINTS; j++) {
+		map<string, size_t>::const_iterator i = NodeIndex.find(JointNames[j]);
+		Joints[j] = i == NodeIndex.end() ? NULL : GetNode (i->second);
+		if (Joints[j] != NULL) nodeJoint[Joints[j]->node_idx] = j;
+	}
+}
+
+void CCharShape::ResetJoint (TCharJoint joint) {
+	TCharNode *node = Joints[joint];
+	if (node == NULL) return;
+	node->trans.SetIdentity();
+	node->invtrans.SetIdentity();
+}
+
 void CCharShape::ResetJoints () {
-	ResetNode ("left_shldr");
-	ResetNode ("right_shldr");
-	ResetNode ("left_hip");
-	ResetNode ("right_hip");
-	ResetNode ("left_knee");
-	ResetNode ("right_knee");
-	ResetNode ("left_ankle");
-	ResetNode ("right_ankle");
-	ResetNode ("tail");
-	ResetNode ("neck");
-	ResetNode ("head");
+	for (int j=JOINT_ROOT+1; j<NUM_JOINTS; j++) ResetJoint ((TCharJoint)j);
+}
+
+// Rotates the node about the axes in the given order. Angles of 0 are
+// skipped, so most joints need only one rotation.
+static void PoseRotate (TCharNode *node, const TVector3d& rot, const char *order) {
+	for (const char *axis = order; *axis; axis++) {
+		ETR_DOUBLE angle = *axis == 'x' ? rot.x : (*axis == 'y' ? rot.y : rot.z);
+		if (angle == 0) continue;
+		node->trans.Rotate (angle, *axis);
+		node->invtrans.PreRotate (-angle, *axis);
+	}
+}
+
+// The same for instances, which need no inverse
+static void PoseRotate (TAffine& trans, const TVector3d& rot, const char *order) {
+	for (const char *axis = order; *axis; axis++) {
+		ETR_DOUBLE angle = *axis == 'x' ? rot.x : (*axis == 'y' ? rot.y : rot.z);
+		if (angle != 0) trans.Rotate (angle, *axis);
+	}
+}
+
+// Evaluates the whole pose in one pass over the joint nodes.
+void CCharShape::SetPose (const TCharPose& pose) {
+	lastPose = pose;
+	if (Joints[JOINT_ROOT] != NULL)
+		PoseRotate (Joints[JOINT_ROOT], pose.rot[JOINT_ROOT], "yxz");
+
+	for (int j=JOINT_ROOT+1; j<NUM_JOINTS; j++) {
+		TCharNode *node = Joints[j];
+		if (node == NULL) continue;
+		node->trans.SetIdentity();
+		node->invtrans.SetIdentity();
+		PoseRotate (node, pose.rot[j], "zyx");
+	}
+}
+
+// The current root transformation and pose, to draw the character
+// again later with DrawInstances
+void CCharShape::GetInstance (TCharInstance& inst) const {
+	inst.root = Nodes[0]->trans;
+	inst.pose = lastPose;
 }
 
 void CCharShape::Reset () {
@@ -343,6 +415,7 @@ void CCharShape::Reset () {
 		}
 		Index[i] = -1;
 	}
+	for (int j=0; j<NUM_JOINTS; j++) Joints[j] = NULL;
 	Materials.clear();
 	NodeIndex.clear();
 	MaterialIndex.clear();
@@ -397,8 +470,23 @@ void CCharShape::CreateMaterial (const string& line) {
 void CCharShape::DrawCharSphere (int num_divisions) {
 	if (num_divisions<1)
 		return;
-	
-	glDrawElements(GL_TRIANGLE_STRIP, numpoints, GL_UNSIGNED_INT, charvertexcount);
+
+	const TSphereMesh& mesh = sphereMeshes[num_divisions];
+	glDrawArrays(GL_TRIANGLE_STRIP, mesh.first, mesh.count);
+	drawStats.vertices += mesh.count;
+}
+
+// The divisions of a node for the current eye position, see
+// SPHERE_LOD_DIST. Needs the model matrices from FlattenNodes or
+// FlattenInstance.
+int CCharShape::LodDivisions (const TCharNode *node, size_t world_idx) const {
+	if (!useLod) return node->divisions;
+	const TAffine& mat = world[world_idx];
+	TVector3d center (mat[0][3], mat[1][3], mat[2][3]);
+	ETR_DOUBLE dist = (center - lodEye).Length();
+	if (dist <= SPHERE_LOD_DIST) return node->divisions;
+	int div = (int)(node->divisions * SPHERE_LOD_DIST / dist);
+	return max (div, (int)MIN_SPHERE_DIV);
 }
 
 void CCharShape::DrawNodes (const TCharNode *node) {
@@ -417,7 +505,9 @@ void CCharShape::DrawNodes (const TCharNode *node) {
 	if (node->visible == true) {
 		set_material (mat->diffuse, mat->specular, mat->exp);
 
-		DrawCharSphere (node->divisions);
+		DrawCharSphere (LodDivisions (node, node->node_idx));
+		drawStats.draws++;
+		drawStats.nodes++;
 	}
 // -------------- recursive loop -------------------------------------
 	TCharNode *child = node->child;
@@ -430,25 +520,198 @@ void CCharShape::DrawNodes (const TCharNode *node) {
 	glPopMatrix();
 }
 
+// The model matrices of all nodes in one pass. A parent is always
+// created before its children, so it has a lower index.
+void CCharShape::FlattenNodes () {
+	if (world.size() < numNodes) world.resize (numNodes);
+	world[0] = Nodes[0]->trans;
+	for (size_t i=1; i<numNodes; i++)
+		world[i] = world[Nodes[i]->parent->node_idx] * Nodes[i]->trans;
+}
+
+// Like FlattenNodes, but the joints are posed from inst instead of
+// taking the transformations of the nodes.
+void CCharShape::FlattenInstance (const TCharInstance& inst, TAffine *out) const {
+	out[0] = inst.root;
+	for (size_t i=1; i<numNodes; i++) {
+		const TAffine& parent = out[Nodes[i]->parent->node_idx];
+		int joint = nodeJoint[i];
+		if (joint > JOINT_ROOT) {
+			TAffine local;
+			local.SetIdentity();
+			PoseRotate (local, inst.pose.rot[joint], "zyx");
+			out[i] = parent * local;
+		} else {
+			out[i] = parent * Nodes[i]->trans;
+		}
+	}
+}
+
+// Appends one sphere to the current triangle strip. Spheres of the same
+// batch are joined by two degenerate triangles; a sphere has an even
+// number of vertices, so the winding stays the same.
+void CCharShape::AddSphereVertices (const TAffine& mat, int divisions, bool join) {
+	// normals are transformed with the inverse transpose of the linear
+	// part and normalized here, so GL_NORMALIZE is not needed
+	TAffine inv = mat.GetInverse();
+
+	const TSphereMesh& mesh = sphereMeshes[divisions];
+	const GLfloat *sphere = &sphereVertices[mesh.first * 3];
+	size_t start = batchVertices.size();
+	batchVertices.resize (start + (mesh.count + (join ? 2 : 0)) * 6);
+	GLfloat *out = &batchVertices[start];
+	if (join) {
+		for (int k=0; k<6; k++) out[k] = out[k - 6];
+		out += 6;
+	}
+
+	for (int v=0; v<mesh.count; v++) {
+		TVector3d p (sphere[v*3], sphere[v*3+1], sphere[v*3+2]);
+		TVector3d pt = TransformPoint (mat, p);
+		TVector3d nml (
+		    inv[0][0] * p.x + inv[1][0] * p.y + inv[2][0] * p.z,
+		    inv[0][1] * p.x + inv[1][1] * p.y + inv[2][1] * p.z,
+		    inv[0][2] * p.x + inv[1][2] * p.y + inv[2][2] * p.z);
+		nml.Norm();
+		out[0] = pt.x;
+		out[1] = pt.y;
+		out[2] = pt.z;
+		out[3] = nml.x;
+		out[4] = nml.y;
+		out[5] = nml.z;
+		out += 6;
+		if (join && v == 0) {
+			for (int k=0; k<6; k++) out[k] = out[k - 6];
+			out += 6;
+		}
+	}
+}
+
+// One batch per material for the spheres of all instances in world
+void CCharShape::BuildBatches (size_t num_instances) {
+	batchVertices.clear();
+	batches.clear();
+	drawStats.nodes = 0;
+
+	// one batch per material, the nodes without material come last
+	for (size_t m=0; m<=Materials.size(); m++) {
+		const TCharMaterial *mat = m < Materials.size() ? &Materials[m] : NULL;
+		size_t first = batchVertices.size();
+		for (size_t k=0; k<num_instances; k++) {
+			for (size_t i=0; i<numNodes; i++) {
+				const TCharNode *node = Nodes[i];
+				if (!node->visible || node->divisions < 1) continue;
+				const TCharMaterial *nodemat = useMaterials ? node->mat : NULL;
+				if (nodemat != mat) continue;
+				size_t idx = k * numNodes + i;
+				AddSphereVertices (world[idx], LodDivisions (node, idx), batchVertices.size() > first);
+				drawStats.nodes++;
+			}
+		}
+		if (batchVertices.size() > first) {
+			TCharBatch batch;
+			batch.mat = mat != NULL ? mat : &TuxDefMat;
+			batch.first = (GLint)(first / 6);
+			batch.count = (GLsizei)((batchVertices.size() - first) / 6);
+			batches.push_back (batch);
+		}
+	}
+	drawStats.draws = drawStats.materials = (unsigned int)batches.size();
+	drawStats.vertices = (unsigned int)(batchVertices.size() / 6);
+}
+
+void CCharShape::BuildFlattened () {
+	FlattenNodes ();
+	BuildBatches (1);
+}
+
+// Draws what BuildFlattened collected, with the given alpha for the
+// diffuse colour of all materials.
+void CCharShape::DrawBatches (float alpha) {
+	if (batches.empty()) return;
+
+	const GLsizei stride = 6 * sizeof(GLfloat);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, stride, &batchVertices[0]);
+	glNormalPointer(GL_FLOAT, stride, &batchVertices[3]);
+	for (size_t b=0; b<batches.size(); b++) {
+		const TCharMaterial *mat = batches[b].mat;
+		TColor diffuse = mat->diffuse;
+		diffuse.a *= alpha;
+		set_material (diffuse, mat->specular, mat->exp);
+		glDrawArrays(GL_TRIANGLE_STRIP, batches[b].first, batches[b].count);
+	}
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+}
+
+void CCharShape::PrepareDraw () {
+	if (sphereVertices.empty()) BuildSphereMeshes ();
+
+	// the level of detail needs the eye, which the tools don't have
+	useLod = g_game.toolmode == NONE && g_game.player != NULL
+	         && g_game.player->ctrl != NULL && g_game.player->ctrl->view_init;
+	if (useLod) lodEye = g_game.player->ctrl->viewpos;
+}
+
+// Draws num characters of this shape with one draw call per material,
+// e.g. the ghosts. With alpha < 1 the first pass only writes the depth,
+// so the second one blends just the surfaces nearest to the eye. No
+// shadows.
+void CCharShape::DrawInstances (const TCharInstance *inst, size_t num, float alpha) {
+	static const float dummy_color[] = {0.0, 0.0, 0.0, 1.0};
+
+	glMaterialfv (GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, dummy_color);
+	ScopedRenderMode rm(TUX);
+	if (GetNode(0) == NULL || num == 0) return;
+	PrepareDraw ();
+
+	if (world.size() < num * numNodes) world.resize (num * numNodes);
+	for (size_t k=0; k<num; k++) FlattenInstance (inst[k], &world[k * numNodes]);
+	BuildBatches (num);
+	if (alpha >= 1.0) {
+		DrawBatches (1.0);
+		return;
+	}
+	glColorMask (GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	DrawBatches (1.0);
+	glColorMask (GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthFunc (GL_LEQUAL);
+	DrawBatches (alpha);
+	glDepthFunc (GL_LESS);
+}
+
 void CCharShape::Draw () {
 	static const float dummy_color[] = {0.0, 0.0, 0.0, 1.0};
 
 	glMaterialfv (GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, dummy_color);
 	ScopedRenderMode rm(TUX);
-	glEnable (GL_NORMALIZE);
 
 	TCharNode *node = GetNode(0);
 	if (node == NULL) return;
+	PrepareDraw ();
+
+	// the tools highlight subtrees, which only DrawNodes supports
+	if (flattenMesh && !useHighlighting) {
+		BuildFlattened ();
+		DrawBatches (1.0);
+		if (param.perf_level > 2 && g_game.toolmode == NONE) DrawShadow ();
+		return;
+	}
 
+	if (useLod) FlattenNodes ();
+	glEnable (GL_NORMALIZE);
+	drawStats = TCharDrawStats();
 	glEnableClientState(GL_NORMAL_ARRAY);
-	glNormalPointer(GL_FLOAT, 0,charvertices);
 	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(3, GL_FLOAT, 0,charvertices);
+	glNormalPointer(GL_FLOAT, 0, &sphereVertices[0]);
+	glVertexPointer(3, GL_FLOAT, 0, &sphereVertices[0]);
 	DrawNodes (node);
 	glDisableClientState(GL_VERTEX_ARRAY);
 	glDisableClientState(GL_NORMAL_ARRAY);
 	glDisable (GL_NORMALIZE);
-	if (param.perf_level > 2 && g_game.argument == 0) DrawShadow ();
+	if (param.perf_level > 2 && g_game.toolmode == NONE) DrawShadow ();
 	highlighted = false;
 }
 
@@ -457,6 +720,7 @@ void CCharShape::Draw () {
 bool CCharShape::Load (const string& dir, const string& filename, bool with_actions) {
 	CSPList list (500);
 
+	if (!with_actions && useCompiled && LoadCompiled (dir, filename)) return true;
 	useActions = with_actions;
 	CreateRootNode ();
 	newActions = true;
@@ -518,6 +782,229 @@ bool CCharShape::Load (const string& dir, const string& filename, bool with_acti
 		}
 	}
 	newActions = false;
+	ResolveJoints ();
+	return true;
+}
+
+// --------------------------------------------------------------------
+//				compiled shape
+// --------------------------------------------------------------------
+// "shape.lst" is compiled to "shape.pak": the materials and the node
+// table with parent names, material indices and the final transforms,
+// so the shape is built without parsing or replaying the node actions.
+// The tools load the text file because they need the actions.
+
+#define SHAPE_MAGIC 0x53525445	// "ETRS"
+#define SHAPE_VERSION 2
+#define SHAPE_JOINT_LEN 32
+
+// fixed-width fields only, the same layout on 32 and 64 bit systems
+struct TShapeHeader {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 header_size;
+	Uint32 real_size;
+	Uint32 num_materials;
+	Uint32 num_nodes;		// without the root
+	Sint64 stamps[2];		// mtime and size of the text file
+};
+
+struct TShapeMaterial {
+	ETR_DOUBLE diffuse[4];
+	ETR_DOUBLE specular[4];
+	float exp;
+};
+
+struct TShapeNode {
+	unsigned int node_name;
+	unsigned int parent_name;
+	int material;			// -1 if none
+	float vis_level;
+	unsigned int shadow;
+	char joint[SHAPE_JOINT_LEN];
+	ETR_DOUBLE trans[3][4];
+	ETR_DOUBLE invtrans[3][4];
+};
+
+static bool FillShapeHeader (TShapeHeader& hdr, const string& textfile) {
+	memset (&hdr, 0, sizeof(hdr));
+	hdr.magic = SHAPE_MAGIC;
+	hdr.version = SHAPE_VERSION;
+	hdr.header_size = sizeof(TShapeHeader);
+	hdr.real_size = sizeof(ETR_DOUBLE);
+	return FileStat (textfile, &hdr.stamps[0], &hdr.stamps[1]);
+}
+
+static void CopyAffine (ETR_DOUBLE dest[3][4], const TAffine& src) {
+	for (int i=0; i<3; i++)
+		for (int j=0; j<4; j++)
+			dest[i][j] = src[i][j];
+}
+
+static void CopyAffine (TAffine& dest, const ETR_DOUBLE src[3][4]) {
+	for (int i=0; i<3; i++)
+		for (int j=0; j<4; j++)
+			dest[i][j] = src[i][j];
+}
+
+bool CCharShape::LoadCompiled (const string& dir, const string& filename) {
+	string pakfile = dir + SEP + CompiledName (filename);
+	if (!FileExists (pakfile)) return false;
+
+	TShapeHeader expected;
+	if (!FillShapeHeader (expected, dir + SEP + filename)) return false;
+
+	CMappedFile file;
+	if (!file.Open (pakfile)) return false;
+	useActions = false;
+	const TShapeHeader* hdr = (const TShapeHeader*)file.Data();
+	if (file.Size() < sizeof(TShapeHeader)
+	        || hdr->magic != expected.magic
+	        || hdr->version != expected.version
+	        || hdr->header_size != expected.header_size
+	        || hdr->real_size != expected.real_size
+	        || memcmp (hdr->stamps, expected.stamps, sizeof(expected.stamps)) != 0
+	        || hdr->num_materials > MAX_CHAR_MAT
+	        || hdr->num_nodes >= MAX_CHAR_NODES
+	        || file.Size() != sizeof(TShapeHeader) + hdr->num_materials * sizeof(TShapeMaterial)
+	        + hdr->num_nodes * sizeof(TShapeNode)) {
+		Message ("compiled shape is out of date", pakfile);
+		return false;
+	}
+
+	const TShapeMaterial* mats = (const TShapeMaterial*)(file.Data() + sizeof(TShapeHeader));
+	const TShapeNode* nodes = (const TShapeNode*)(mats + hdr->num_materials);
+
+	CreateRootNode ();
+	Materials.resize (hdr->num_materials);
+	for (size_t i=0; i<hdr->num_materials; i++) {
+		TCharMaterial& mat = Materials[i];
+		mat.diffuse = TColor (mats[i].diffuse[0], mats[i].diffuse[1], mats[i].diffuse[2], mats[i].diffuse[3]);
+		mat.specular = TColor (mats[i].specular[0], mats[i].specular[1], mats[i].specular[2], mats[i].specular[3]);
+		mat.exp = mats[i].exp;
+	}
+
+	for (size_t i=0; i<hdr->num_nodes; i++) {
+		const TShapeNode& rec = nodes[i];
+		if (rec.node_name >= MAX_CHAR_NODES || rec.material >= (int)Materials.size()
+		        || memchr (rec.joint, 0, SHAPE_JOINT_LEN) == NULL
+		        || !CreateCharNode (rec.parent_name, rec.node_name, rec.joint, "", "", rec.shadow != 0)) {
+			Message ("corrupt compiled shape", pakfile);
+			Reset ();
+			return false;
+		}
+		TCharNode *node = Nodes[numNodes-1];
+		if (rec.material >= 0) node->mat = &Materials[rec.material];
+		CopyAffine (node->trans, rec.trans);
+		CopyAffine (node->invtrans, rec.invtrans);
+		VisibleNode (rec.node_name, rec.vis_level);
+	}
+	ResolveJoints ();
+	return true;
+}
+
+bool CCharShape::SaveCompiled (const string& dir, const string& filename) const {
+	TShapeHeader hdr;
+	if (!FillShapeHeader (hdr, dir + SEP + filename)) return false;
+	hdr.num_materials = Materials.size();
+	hdr.num_nodes = numNodes - 1;
+
+	string pakfile = dir + SEP + CompiledName (filename);
+	ofstream file (pakfile.c_str(), ios::out | ios::binary);
+	if (!file) {
+		Message ("could not write compiled shape", pakfile);
+		return false;
+	}
+	file.write ((const char*)&hdr, sizeof(hdr));
+
+	for (size_t i=0; i<Materials.size(); i++) {
+		TShapeMaterial rec;
+		memset (&rec, 0, sizeof(rec));
+		const TColor& diff = Materials[i].diffuse;
+		const TColor& spec = Materials[i].specular;
+		rec.diffuse[0] = diff.r;
+		rec.diffuse[1] = diff.g;
+		rec.diffuse[2] = diff.b;
+		rec.diffuse[3] = diff.a;
+		rec.specular[0] = spec.r;
+		rec.specular[1] = spec.g;
+		rec.specular[2] = spec.b;
+		rec.specular[3] = spec.a;
+		rec.exp = Materials[i].exp;
+		file.write ((const char*)&rec, sizeof(rec));
+	}
+
+	for (size_t i=1; i<numNodes; i++) {
+		const TCharNode *node = Nodes[i];
+		if (node->joint.size() >= SHAPE_JOINT_LEN) {
+			Message ("joint name too long for the compiled shape", node->joint);
+			return false;
+		}
+		TShapeNode rec;
+		memset (&rec, 0, sizeof(rec));
+		rec.node_name = node->node_name;
+		rec.parent_name = node->parent_name;
+		rec.material = node->mat ? (int)(node->mat - &Materials[0]) : -1;
+		rec.vis_level = node->vis_level;
+		rec.shadow = node->render_shadow;
+		strcpy (rec.joint, node->joint.c_str());
+		CopyAffine (rec.trans, node->trans);
+		CopyAffine (rec.invtrans, node->invtrans);
+		file.write ((const char*)&rec, sizeof(rec));
+	}
+	if (!file) {
+		Message ("could not write compiled shape", pakfile);
+		return false;
+	}
+	return true;
+}
+
+static bool SameMaterial (const TCharMaterial *a, const TCharMaterial *b) {
+	if (a == NULL || b == NULL) return a == b;
+	return a->diffuse.r == b->diffuse.r && a->diffuse.g == b->diffuse.g
+	       && a->diffuse.b == b->diffuse.b && a->diffuse.a == b->diffuse.a
+	       && a->specular.r == b->specular.r && a->specular.g == b->specular.g
+	       && a->specular.b == b->specular.b && a->specular.a == b->specular.a
+	       && a->exp == b->exp;
+}
+
+static bool SameAffine (const TAffine& a, const TAffine& b) {
+	for (int i=0; i<3; i++)
+		for (int j=0; j<4; j++)
+			if (a[i][j] != b[i][j]) return false;
+	return true;
+}
+
+// Exact comparison of everything the game uses, for the round trip
+// check of "etr --compile-chars".
+bool CCharShape::SameShape (const CCharShape& other) const {
+	if (numNodes != other.numNodes) {
+		Message ("node count differs");
+		return false;
+	}
+	for (size_t i=0; i<numNodes; i++) {
+		const TCharNode *a = Nodes[i];
+		const TCharNode *b = other.Nodes[i];
+		if (a->node_name != b->node_name
+		        || a->parent_name != b->parent_name
+		        || a->joint != b->joint
+		        || a->render_shadow != b->render_shadow
+		        || a->visible != b->visible
+		        || (a->visible && (a->divisions != b->divisions || a->radius != b->radius))
+		        || !SameMaterial (a->mat, b->mat)
+		        || !SameAffine (a->trans, b->trans)
+		        || !SameAffine (a->invtrans, b->invtrans)) {
+			Message ("node differs:", Int_StrN ((int)a->node_name));
+			return false;
+		}
+	}
+	for (int j=0; j<NUM_JOINTS; j++) {
+		if ((Joints[j] == NULL) != (other.Joints[j] == NULL)
+		        || (Joints[j] && Joints[j]->node_idx != other.Joints[j]->node_idx)) {
+			Message ("joint differs:", JointNames[j]);
+			return false;
+		}
+	}
 	return true;
 }
 
@@ -580,7 +1067,8 @@ void CCharShape::AdjustOrientation (CControl *ctrl, bool eps,
 	rot_mat = RotateAboutVectorMatrix (new_x, ctrl->flip_factor * 360);
 	cob_mat = rot_mat * cob_mat;
 
-	TransformNode (0, cob_mat, cob_mat.GetTransposed());
+	TAffine cob_affine (cob_mat);
+	TransformNode (0, cob_affine, cob_affine.GetRigidInverse());
 }
 
 void CCharShape::AdjustJoints (ETR_DOUBLE turnFact, bool isBraking,
@@ -607,41 +1095,41 @@ void CCharShape::AdjustJoints (ETR_DOUBLE turnFact, bool isBraking,
 	force_angle = clamp (-20.0, -net_force.z / 300.0, 20.0);
 	turn_leg_angle = turnFact * 10;
 
-	ResetJoints ();
-
-	RotateNode ("left_shldr", 3,
-	            min (braking_angle + paddling_angle + turning_angle[0], MAX_ARM_ANGLE2) + flap_angle);
-	RotateNode ("right_shldr", 3,
-	            min (braking_angle + paddling_angle + turning_angle[1], MAX_ARM_ANGLE2) + flap_angle);
-
-	RotateNode ("left_shldr", 2, -ext_paddling_angle);
-	RotateNode ("right_shldr", 2, ext_paddling_angle);
-	RotateNode ("left_hip", 3, -20 + turn_leg_angle + force_angle);
-	RotateNode ("right_hip", 3, -20 - turn_leg_angle + force_angle);
-
-	RotateNode ("left_knee", 3,
-	            -10 + turn_leg_angle - min (35.0f, speed) + kick_paddling_angle + force_angle);
-	RotateNode ("right_knee", 3,
-	            -10 - turn_leg_angle - min (35.0f, speed) - kick_paddling_angle + force_angle);
-
-	RotateNode ("left_ankle", 3, -20 + min (50.0f, speed));
-	RotateNode ("right_ankle", 3, -20 + min (50.0f, speed));
-	RotateNode ("tail", 3, turnFact * 20);
-	RotateNode ("neck", 3, -50);
-	RotateNode ("head", 3, -30);
-	RotateNode ("head", 2, -turnFact * 70);
+	TCharPose pose;
+	pose.rot[JOINT_LEFT_SHLDR].z =
+	    min (braking_angle + paddling_angle + turning_angle[0], MAX_ARM_ANGLE2) + flap_angle;
+	pose.rot[JOINT_RIGHT_SHLDR].z =
+	    min (braking_angle + paddling_angle + turning_angle[1], MAX_ARM_ANGLE2) + flap_angle;
+
+	pose.rot[JOINT_LEFT_SHLDR].y = -ext_paddling_angle;
+	pose.rot[JOINT_RIGHT_SHLDR].y = ext_paddling_angle;
+	pose.rot[JOINT_LEFT_HIP].z = -20 + turn_leg_angle + force_angle;
+	pose.rot[JOINT_RIGHT_HIP].z = -20 - turn_leg_angle + force_angle;
+
+	pose.rot[JOINT_LEFT_KNEE].z =
+	    -10 + turn_leg_angle - min (35.0f, speed) + kick_paddling_angle + force_angle;
+	pose.rot[JOINT_RIGHT_KNEE].z =
+	    -10 - turn_leg_angle - min (35.0f, speed) - kick_paddling_angle + force_angle;
+
+	pose.rot[JOINT_LEFT_ANKLE].z = -20 + min (50.0f, speed);
+	pose.rot[JOINT_RIGHT_ANKLE].z = -20 + min (50.0f, speed);
+	pose.rot[JOINT_TAIL].z = turnFact * 20;
+	pose.rot[JOINT_NECK].z = -50;
+	pose.rot[JOINT_HEAD].z = -30;
+	pose.rot[JOINT_HEAD].y = -turnFact * 70;
+	SetPose (pose);
 }
 
 // --------------------------------------------------------------------
 //				collision
 // --------------------------------------------------------------------
 
-bool CCharShape::CheckPolyhedronCollision(const TCharNode *node, const TMatrix<4, 4>& modelMatrix,
-        const TMatrix<4, 4>& invModelMatrix, const TPolyhedron& ph) {
+bool CCharShape::CheckPolyhedronCollision(const TCharNode *node, const TAffine& modelMatrix,
+        const TAffine& invModelMatrix, const TPolyhedron& ph) {
 	bool hit = false;
 
-	TMatrix<4, 4> newModelMatrix = modelMatrix * node->trans;
-	TMatrix<4, 4> newInvModelMatrix = node->invtrans * invModelMatrix;
+	TAffine newModelMatrix = modelMatrix * node->trans;
+	TAffine newInvModelMatrix = node->invtrans * invModelMatrix;
 
 	if (node->visible) {
 		TPolyhedron newph = ph;
@@ -662,7 +1150,7 @@ bool CCharShape::CheckPolyhedronCollision(const TCharNode *node, const TMatrix<4
 bool CCharShape::CheckCollision (const TPolyhedron& ph) {
 	TCharNode *node = GetNode(0);
 	if (node == NULL) return false;
-	const TMatrix<4, 4>& identity = TMatrix<4, 4>::getIdentity();
+	const TAffine& identity = TAffine::getIdentity();
 	return CheckPolyhedronCollision(node, identity, identity, ph);
 }
 
@@ -675,140 +1163,134 @@ bool CCharShape::Collision (const TVector3d& pos, const TPolyhedron& ph) {
 // --------------------------------------------------------------------
 //				shadow
 // --------------------------------------------------------------------
-bool bLoaded = false;
-ETR_DOUBLE vectors[32*3];
-
-void CCharShape::DrawShadowVertex(int& n, const TMatrix<4, 4>& mat) {
-	TVector3d pt(vectors[n],vectors[n+1] , vectors[n+2]);
-	n += 3;
-	pt = TransformPoint (mat, pt);
-	ETR_DOUBLE old_y = pt.y;
-	//TVector3d nml = Course.FindCourseNormal (pt.x, pt.z);
-	pt.y = Course.FindYCoord (pt.x, pt.z) + SHADOW_HEIGHT;
-	if (pt.y > old_y) pt.y = old_y;
-	//glNormal3(nml);
-	glVertex3(pt);
-}
-
-void CCharShape::DrawShadowSphere(const TMatrix<4, 4>& mat) {
-	int vc  = 0;
-	if (!bLoaded)
-	{
-		ETR_DOUBLE theta, phi, d_theta, d_phi, eps, twopi;
-		//int div = param.tux_shadow_sphere_divisions;
-		eps = 1e-15;
-		twopi = M_PI * 2.0;
-		d_theta = d_phi = M_PI / 3;
-		for (phi = 0.0; phi + eps < M_PI; phi += d_phi) {
-			ETR_DOUBLE cos_theta, sin_theta;
-			ETR_DOUBLE sin_phi, cos_phi;
-			ETR_DOUBLE sin_phi_d_phi, cos_phi_d_phi;
-			
-			sin_phi = sin (phi);
-			cos_phi = cos (phi);
-			sin_phi_d_phi = sin (phi + d_phi);
-			cos_phi_d_phi = cos (phi + d_phi);
-			
-			if (phi <= eps) {
-				vectors[vc++] = 0.0;
-				vectors[vc++] = 0.0;
-				vectors[vc++] = 1.0;
-				for (theta = 0.0; theta + eps < twopi; theta += d_theta) {
-					sin_theta = sin (theta);
-					cos_theta = cos (theta);
-					
-					vectors[vc++] = cos_theta * sin_phi_d_phi;
-					vectors[vc++] = sin_theta * sin_phi_d_phi;
-					vectors[vc++] = cos_phi_d_phi;
-				}
-				vectors[vc++] = sin_phi_d_phi;
-				vectors[vc++] = 0.0;
-				vectors[vc++] = cos_phi_d_phi;
-			} else if (phi + d_phi + eps >= M_PI) {
-				vectors[vc++] = 0.0;
-				vectors[vc++] = 0.0;
-				vectors[vc++] = -1.0;
-				for (theta = twopi; theta - eps > 0; theta -= d_theta) {
-					sin_theta = sin (theta);
-					cos_theta = cos (theta);
-					vectors[vc++] = cos_theta * sin_phi;
-					vectors[vc++] = sin_theta * sin_phi;
-					vectors[vc++] = cos_phi;
-				}
-				vectors[vc++] = sin_phi;
-				vectors[vc++] = 0.0;
-				vectors[vc++] = cos_phi;
-			} else {
-				for (theta = 0.0; theta + eps < twopi; theta += d_theta) {
-					sin_theta = sin (theta);
-					cos_theta = cos (theta);
-					vectors[vc++] = cos_theta * sin_phi;
-					vectors[vc++] = sin_theta * sin_phi;
-					vectors[vc++] = cos_phi;
-					
-					vectors[vc++] = cos_theta * sin_phi_d_phi;
-					vectors[vc++] = sin_theta * sin_phi_d_phi;
-					vectors[vc++] = cos_phi_d_phi;
-				}
-				vectors[vc++] = sin_phi;
-				vectors[vc++] = 0.0;
-				vectors[vc++] = cos_phi;
-				vectors[vc++] = sin_phi_d_phi;
-				vectors[vc++] = 0.0;
-				vectors[vc++] = cos_phi_d_phi;
-			}
+
+// The shadow of every node is the outline of its ellipsoid projected
+// straight down, laid onto the ground as a fan of SHADOW_SEGMENTS
+// triangles. The ground is the local course plane under the character,
+// corrected by a small height grid that is sampled once per frame.
+
+#define SHADOW_SEGMENTS 12
+#define SHADOW_GRID 8			// cells per side
+#define SHADOW_GRID_SIZE 4.0	// side length in m
+#define MAX_SHADOW_VERTICES (MAX_CHAR_NODES * SHADOW_SEGMENTS * 3)
+
+static GLfloat shadowVertices[MAX_SHADOW_VERTICES * 3];
+
+struct TShadowGround {
+	TPlane plane;
+	ETR_DOUBLE x0, z0;
+	ETR_DOUBLE offset[SHADOW_GRID+1][SHADOW_GRID+1];	// terrain height above the plane
+
+	ETR_DOUBLE PlaneY (ETR_DOUBLE x, ETR_DOUBLE z) const {
+		if (plane.nml.y < EPS) return 0;
+		return -(plane.nml.x * x + plane.nml.z * z + plane.d) / plane.nml.y;
+	}
+	void Sample (const TVector3d& center);
+	ETR_DOUBLE Height (ETR_DOUBLE x, ETR_DOUBLE z) const;
+};
+
+void TShadowGround::Sample (const TVector3d& center) {
+	plane = Course.GetLocalCoursePlane (center);
+	x0 = center.x - SHADOW_GRID_SIZE / 2;
+	z0 = center.z - SHADOW_GRID_SIZE / 2;
+	const ETR_DOUBLE cell = SHADOW_GRID_SIZE / SHADOW_GRID;
+	for (int j=0; j<=SHADOW_GRID; j++) {
+		for (int i=0; i<=SHADOW_GRID; i++) {
+			ETR_DOUBLE x = x0 + i * cell;
+			ETR_DOUBLE z = z0 + j * cell;
+			offset[j][i] = Course.FindYCoord (x, z) - PlaneY (x, z);
 		}
-		bLoaded = true;
-	}
-	vc  = 0;
-	glBegin (GL_TRIANGLE_FAN);
-	DrawShadowVertex (vc, mat);
-	for (int x = 0;x < 7; x++) {
-		DrawShadowVertex (vc, mat);
-	}
-	DrawShadowVertex (vc, mat);
-	glEnd();
-	glBegin (GL_TRIANGLE_STRIP);
-	for (int x = 0;x < 7; x++) {
-		DrawShadowVertex (vc, mat);
-		DrawShadowVertex (vc, mat);
-	}
-	DrawShadowVertex (vc, mat);
-	DrawShadowVertex (vc, mat);
-	glEnd();
-	glBegin (GL_TRIANGLE_FAN);
-	DrawShadowVertex (vc, mat);
-	for (int x = 0;x < 6; x++) {
-		DrawShadowVertex (vc, mat);
-	}
-	DrawShadowVertex (vc, mat);
-	glEnd();
-}
-
-void CCharShape::TraverseDagForShadow(const TCharNode *node, const TMatrix<4, 4>& mat) {
-	TMatrix<4, 4> new_matrix = mat * node->trans;
-	if (node->visible && node->render_shadow)
-		DrawShadowSphere (new_matrix);
-
-	TCharNode* child = node->child;
-	while (child != NULL) {
-		TraverseDagForShadow (child, new_matrix);
-		child = child->next;
 	}
 }
 
+// bilinear in the grid, the plane alone outside of it
+ETR_DOUBLE TShadowGround::Height (ETR_DOUBLE x, ETR_DOUBLE z) const {
+	const ETR_DOUBLE cell = SHADOW_GRID_SIZE / SHADOW_GRID;
+	ETR_DOUBLE fx = (x - x0) / cell;
+	ETR_DOUBLE fz = (z - z0) / cell;
+	if (fx < 0 || fz < 0 || fx >= SHADOW_GRID || fz >= SHADOW_GRID)
+		return PlaneY (x, z);
+
+	int i = (int)fx;
+	int j = (int)fz;
+	fx -= i;
+	fz -= j;
+	ETR_DOUBLE top = offset[j][i] + (offset[j][i+1] - offset[j][i]) * fx;
+	ETR_DOUBLE bott = offset[j+1][i] + (offset[j+1][i+1] - offset[j+1][i]) * fx;
+	return PlaneY (x, z) + top + (bott - top) * fz;
+}
+
+static TShadowGround shadowGround;
+
+// The unit sphere transformed by mat seen from above is an ellipse with
+// the shape matrix S = A * A^T, A being the x and z rows of the linear
+// part. Its outline is center + sqrt(S) * (cos, sin); the square root of
+// a 2x2 matrix has the closed form (S + sqrt(det) I) / sqrt(trace + 2 sqrt(det)).
+static GLfloat *AddShadowEllipse (const TAffine& mat, GLfloat *out) {
+	ETR_DOUBLE sxx = mat[0][0] * mat[0][0] + mat[0][1] * mat[0][1] + mat[0][2] * mat[0][2];
+	ETR_DOUBLE szz = mat[2][0] * mat[2][0] + mat[2][1] * mat[2][1] + mat[2][2] * mat[2][2];
+	ETR_DOUBLE sxz = mat[0][0] * mat[2][0] + mat[0][1] * mat[2][1] + mat[0][2] * mat[2][2];
+	ETR_DOUBLE sdet = sqrt (max (sxx * szz - sxz * sxz, (ETR_DOUBLE)0));
+	ETR_DOUBLE t = sqrt (sxx + szz + 2 * sdet);
+	if (t < EPS) return out;
+	ETR_DOUBLE rxx = (sxx + sdet) / t;
+	ETR_DOUBLE rzz = (szz + sdet) / t;
+	ETR_DOUBLE rxz = sxz / t;
+
+	// the shadow must not lie above the lowest point of the ellipsoid
+	ETR_DOUBLE ylow = mat[1][3] - sqrt (mat[1][0] * mat[1][0] + mat[1][1] * mat[1][1] + mat[1][2] * mat[1][2]);
+	ETR_DOUBLE cx = mat[0][3];
+	ETR_DOUBLE cz = mat[2][3];
+	ETR_DOUBLE cy = min (shadowGround.Height (cx, cz) + SHADOW_HEIGHT, ylow);
+
+	GLfloat outline[SHADOW_SEGMENTS+1][3];
+	for (int k=0; k<=SHADOW_SEGMENTS; k++) {
+		ETR_DOUBLE angle = 2 * M_PI * (k % SHADOW_SEGMENTS) / SHADOW_SEGMENTS;
+		ETR_DOUBLE c = cos (angle);
+		ETR_DOUBLE s = sin (angle);
+		ETR_DOUBLE x = cx + rxx * c + rxz * s;
+		ETR_DOUBLE z = cz + rxz * c + rzz * s;
+		outline[k][0] = x;
+		outline[k][1] = min (shadowGround.Height (x, z) + SHADOW_HEIGHT, ylow);
+		outline[k][2] = z;
+	}
+
+	for (int k=0; k<SHADOW_SEGMENTS; k++) {
+		*out++ = cx;
+		*out++ = cy;
+		*out++ = cz;
+		for (int n=0; n<3; n++) *out++ = outline[k+1][n];
+		for (int n=0; n<3; n++) *out++ = outline[k][n];
+	}
+	return out;
+}
+
 void CCharShape::DrawShadow () {
 	if (g_game.light_id == 1 || g_game.light_id == 3) return;
 
-	ScopedRenderMode rm(TUX_SHADOW);
-	glColor(shad_col);
-
 	TCharNode *node = GetNode(0);
 	if (node == NULL) {
 		Message ("couldn't find tux's root node");
 		return;
 	}
-	TraverseDagForShadow(node, TMatrix<4, 4>::getIdentity());
+
+	FlattenNodes ();
+	shadowGround.Sample (TVector3d (world[0][0][3], world[0][1][3], world[0][2][3]));
+
+	GLfloat *out = shadowVertices;
+	for (size_t i=0; i<numNodes; i++) {
+		if (Nodes[i]->visible && Nodes[i]->render_shadow)
+			out = AddShadowEllipse (world[i], out);
+	}
+	GLsizei count = (GLsizei)((out - shadowVertices) / 3);
+	if (count == 0) return;
+
+	ScopedRenderMode rm(TUX_SHADOW);
+	glColor(shad_col);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, shadowVertices);
+	glDrawArrays(GL_TRIANGLES, 0, count);
+	glDisableClientState(GL_VERTEX_ARRAY);
 }
 
 // --------------------------------------------------------------------
@@ -835,9 +1317,6 @@ size_t CCharShape::GetNodeName (const string& node_trivialname) const {
 
 void CCharShape::RefreshNode (size_t idx) {
 	if (idx >= numNodes) return;
-	TMatrix<4, 4> TempMatrix;
-	char caxis;
-	ETR_DOUBLE angle;
 
 	TCharNode *node = Nodes[idx];
 	TCharAction *act = node->action;
@@ -854,40 +1333,20 @@ void CCharShape::RefreshNode (size_t idx) {
 
 		switch (type) {
 			case 0:
-				TempMatrix.SetTranslationMatrix(vec.x, vec.y, vec.z);
-				node->trans = node->trans * TempMatrix;
-				TempMatrix.SetTranslationMatrix(-vec.x, -vec.y, -vec.z);
-				node->invtrans = TempMatrix * node->invtrans;
+				node->trans.Translate(vec.x, vec.y, vec.z);
+				node->invtrans.PreTranslate(-vec.x, -vec.y, -vec.z);
 				break;
 			case 1:
-				caxis = 'x';
-				angle = dval;
-				TempMatrix.SetRotationMatrix(angle, caxis);
-				node->trans = node->trans * TempMatrix;
-				TempMatrix.SetRotationMatrix(-angle, caxis);
-				node->invtrans = TempMatrix * node->invtrans;
-				break;
 			case 2:
-				caxis = 'y';
-				angle = dval;
-				TempMatrix.SetRotationMatrix(angle, caxis);
-				node->trans = node->trans * TempMatrix;
-				TempMatrix.SetRotationMatrix(-angle, caxis);
-				node->invtrans = TempMatrix * node->invtrans;
-				break;
-			case 3:
-				caxis = 'z';
-				angle = dval;
-				TempMatrix.SetRotationMatrix(angle, caxis);
-				node->trans = node->trans * TempMatrix;
-				TempMatrix.SetRotationMatrix(-angle, caxis);
-				node->invtrans = TempMatrix * node->invtrans;
+			case 3: {
+				char caxis = "xyz"[type - 1];
+				node->trans.Rotate(dval, caxis);
+				node->invtrans.PreRotate(-dval, caxis);
 				break;
+			}
 			case 4:
-				TempMatrix.SetScalingMatrix(vec.x, vec.y, vec.z);
-				node->trans = node->trans * TempMatrix;
-				TempMatrix.SetScalingMatrix(1.0 / vec.x, 1.0 / vec.y, 1.0 / vec.z);
-				node->invtrans = TempMatrix * node->invtrans;
+				node->trans.Scale(vec.x, vec.y, vec.z);
+				node->invtrans.PreScale(1.0 / vec.x, 1.0 / vec.y, 1.0 / vec.z);
 				break;
 			case 5:
 				VisibleNode (node->node_name, dval);
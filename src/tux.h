@@ -61,18 +61,65 @@ struct TCharNode {
 	size_t next_name;
 
 	string joint;
-	TMatrix<4, 4> trans;
-	TMatrix<4, 4> invtrans;
+	TAffine trans;
+	TAffine invtrans;
 	ETR_DOUBLE radius;
 	int divisions;
+	float vis_level;	// as given in shape.lst, kept for the compiled shape
 	TCharMaterial *mat;
 	bool render_shadow;
 	bool visible;
 };
 
+// The joints that are animated every frame. Their nodes are looked up
+// once in CCharShape::Load.
+enum TCharJoint {
+	JOINT_ROOT,
+	JOINT_NECK,
+	JOINT_HEAD,
+	JOINT_LEFT_SHLDR,
+	JOINT_RIGHT_SHLDR,
+	JOINT_LEFT_HIP,
+	JOINT_RIGHT_HIP,
+	JOINT_LEFT_KNEE,
+	JOINT_RIGHT_KNEE,
+	JOINT_LEFT_ANKLE,
+	JOINT_RIGHT_ANKLE,
+	JOINT_TAIL,
+	NUM_JOINTS
+};
+
+// Joint angles in degrees. The root is rotated about y, x and z on top
+// of its current transformation, the other joints are rotated about
+// z, y and x starting from the identity.
+struct TCharPose {
+	TVector3d rot[NUM_JOINTS];
+};
+
+// What differs between characters that share one shape: the final
+// transformation of the root node and the angles of the other joints
+// (pose.rot[JOINT_ROOT] is already part of root). Drawn with
+// CCharShape::DrawInstances, which leaves the nodes of the shape alone.
+struct TCharInstance {
+	TAffine root;
+	TCharPose pose;
+};
+
+// Draw calls of the last character drawn, for the profiler
+struct TCharDrawStats {
+	unsigned int draws;
+	unsigned int nodes;		// visible nodes, one draw each with DrawNodes
+	unsigned int materials;	// one draw each with the flattened mesh
+	unsigned int vertices;
+	TCharDrawStats() : draws(0), nodes(0), materials(0), vertices(0) {}
+};
+
 class CCharShape {
 private:
 	TCharNode *Nodes[MAX_CHAR_NODES];
+	TCharNode *Joints[NUM_JOINTS];	// NULL if the shape has no such joint
+	int nodeJoint[MAX_CHAR_NODES];	// joint of each node index, -1 if none
+	TCharPose lastPose;
 	size_t Index[MAX_CHAR_NODES];
 	size_t numNodes;
 	bool useActions;
@@ -89,27 +136,47 @@ private:
 	 const string& name, const string& order, bool shadow);
 	bool VisibleNode (size_t node_name, float level);
 	bool MaterialNode (size_t node_name, const string& mat_name);
-	bool TransformNode(size_t node_name, const TMatrix<4, 4>& mat, const TMatrix<4, 4>& invmat);
+	bool TransformNode(size_t node_name, const TAffine& mat, const TAffine& invmat);
+	void ResolveJoints ();
+	bool LoadCompiled (const string& dir, const string& filename);
 
 	// material
 	TCharMaterial* GetMaterial (const string& mat_name);
 	void CreateMaterial (const string& line);
 
 	// drawing
+	bool useLod;		// set by Draw when the eye position is known
+	TVector3d lodEye;
+	int LodDivisions (const TCharNode *node, size_t world_idx) const;
 	void DrawCharSphere (int num_divisions);
 	void DrawNodes (const TCharNode *node);
+
+	// flattened drawing: the spheres of all visible nodes are transformed
+	// on the CPU into one vertex array, sorted by material. For instances
+	// world holds numNodes matrices per instance.
+	struct TCharBatch {
+		const TCharMaterial *mat;
+		GLint first;
+		GLsizei count;
+	};
+	vector<TAffine> world;			// model matrix of each node
+	vector<GLfloat> batchVertices;	// position + normal
+	vector<TCharBatch> batches;
+	void FlattenNodes ();
+	void FlattenInstance (const TCharInstance& inst, TAffine *out) const;
+	void AddSphereVertices (const TAffine& mat, int divisions, bool join);
+	void BuildBatches (size_t num_instances);
+	void BuildFlattened ();
+	void DrawBatches (float alpha);
+	void PrepareDraw ();
+	static TCharDrawStats drawStats;
 	TVector3d AdjustRollvector (const CControl *ctrl, const TVector3d& vel, const TVector3d& zvec);
 
 	// collision
-	bool CheckPolyhedronCollision(const TCharNode *node, const TMatrix<4, 4>& modelMatrix,
-	                              const TMatrix<4, 4>& invModelMatrix, const TPolyhedron& ph);
+	bool CheckPolyhedronCollision(const TCharNode *node, const TAffine& modelMatrix,
+	                              const TAffine& invModelMatrix, const TPolyhedron& ph);
 	bool CheckCollision (const TPolyhedron& ph);
 
-	// shadow
-	void DrawShadowVertex(int& n, const TMatrix<4, 4>& mat);
-	void DrawShadowSphere(const TMatrix<4, 4>& mat);
-	void TraverseDagForShadow(const TCharNode *node, const TMatrix<4, 4>& mat);
-
 	// testing and developing
 	void AddAction (size_t node_name, int type, const TVector3d& vec, ETR_DOUBLE val);
 public:
@@ -117,6 +184,8 @@ public:
 	~CCharShape();
 	bool useMaterials;
 	bool useHighlighting;
+	bool useCompiled;		// try shape.pak before shape.lst
+	static bool flattenMesh;	// BuildFlattened instead of DrawNodes
 	map<string, size_t> NodeIndex;
 
 	// nodes
@@ -128,12 +197,19 @@ public:
 	void ScaleNode (size_t node_name, const TVector3d& vec);
 	void ResetRoot () { ResetNode (0); }
 	void ResetJoints ();
+	void ResetJoint (TCharJoint joint);
+	void SetPose (const TCharPose& pose);
+	void GetInstance (TCharInstance& inst) const;
 
 	// global functions
 	void Reset ();
 	void Draw ();
+	void DrawInstances (const TCharInstance *inst, size_t num, float alpha);
 	void DrawShadow ();
+	static const TCharDrawStats& DrawStats () { return drawStats; }
 	bool Load (const string& dir, const string& filename, bool with_actions);
+	bool SaveCompiled (const string& dir, const string& filename) const;
+	bool SameShape (const CCharShape& other) const;
 
 	void AdjustOrientation (CControl *ctrl, bool eps,
 	                        ETR_DOUBLE dist_from_surface, const TVector3d& surf_nml);
@@ -40,6 +40,15 @@ ETR_DOUBLE TVector3<ETR_DOUBLE>::Norm() {
 	return denom;
 }
 
+template<>
+ETR_DOUBLE TVector4<ETR_DOUBLE>::Norm() {
+	ETR_DOUBLE square = x*x + y*y + z*z + w*w;
+	if (square == 0.0) return 0.0;
+	ETR_DOUBLE denom = sqrt(square);
+	*this *= 1.0 / denom;
+	return denom;
+}
+
 ETR_DOUBLE DotProduct(const TVector3d& v1, const TVector3d& v2) {
 	return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
 }
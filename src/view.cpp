@@ -39,7 +39,7 @@ GNU General Public License for more details.
 #define NO_INTERPOLATION_SPEED 2.0
 #define CAMERA_DISTANCE_INCREMENT 2
 
-static TMatrix<4, 4> stationary_matrix;
+static TAffine stationary_matrix;
 static bool is_stationary = false;
 static bool shall_stationary = false;
 
@@ -137,17 +137,8 @@ void setup_view_matrix (CControl *ctrl, bool save_mat) {
 	ctrl->view_mat[3][1] = ctrl->viewpos.y;
 	ctrl->view_mat[3][2] = ctrl->viewpos.z;
 
-	TMatrix<4, 4> view_mat = ctrl->view_mat.GetTransposed();
-
-	view_mat[0][3] = 0;
-	view_mat[1][3] = 0;
-	view_mat[2][3] = 0;
-
-	TVector3d viewpt_in_view_frame = TransformPoint (view_mat, ctrl->viewpos);
-
-	view_mat[3][0] = -viewpt_in_view_frame.x;
-	view_mat[3][1] = -viewpt_in_view_frame.y;
-	view_mat[3][2] = -viewpt_in_view_frame.z;
+	// the camera frame is orthonormal, so it is inverted by transposing
+	TAffine view_mat = TAffine (ctrl->view_mat).GetRigidInverse();
 
 	if (save_mat) {
 		stationary_matrix = view_mat;
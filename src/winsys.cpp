@@ -29,10 +29,25 @@ GNU General Public License for more details.
 #include "spx.h"
 #include "course.h"
 #include <SDL2/SDL_syswm.h>
+// the headless backends need no X11 types
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <cstring>
 #include <iostream>
 
 #define USE_JOYSTICK true
 
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+typedef EGLDisplay (EGLAPIENTRYP PGetPlatformDisplay) (EGLenum platform, void *native, const EGLint *attribs);
+
+// the pbuffer context of the headless backends
+static EGLDisplay egl_display = EGL_NO_DISPLAY;
+static EGLSurface egl_surface = EGL_NO_SURFACE;
+static EGLContext egl_context = EGL_NO_CONTEXT;
+
 TVector2i cursor_pos(0, 0);
 
 CWinsys Winsys;
@@ -41,6 +56,8 @@ CWinsys::CWinsys ()
 	: auto_resolution(800, 600)
 {
 	window = NULL;
+	context = NULL;
+	backend = VIDEO_WINDOW;
 
 	orient = 0;
 
@@ -136,10 +153,113 @@ void CWinsys::InitJoystick () {
 	joystick_active = true;
 }
 
+// Mesa's surfaceless platform needs no X or Wayland server. Other EGL
+// implementations get the default display.
+static EGLDisplay GetOffscreenDisplay () {
+	const char *ext = eglQueryString (EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (ext != NULL && strstr (ext, "EGL_MESA_platform_surfaceless") != NULL) {
+		PGetPlatformDisplay getPlatformDisplay = (PGetPlatformDisplay) eglGetProcAddress ("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay != NULL)
+			return getPlatformDisplay (EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	return eglGetDisplay (EGL_DEFAULT_DISPLAY);
+}
+
+bool CWinsys::InitOffscreen () {
+	egl_display = GetOffscreenDisplay ();
+	if (egl_display == EGL_NO_DISPLAY || !eglInitialize (egl_display, NULL, NULL)) {
+		Message ("could not initialize EGL");
+		return false;
+	}
+#ifdef USE_GLES1
+	eglBindAPI (EGL_OPENGL_ES_API);
+	const EGLint renderable = EGL_OPENGL_ES_BIT;
+	const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 1, EGL_NONE};
+#else
+	eglBindAPI (EGL_OPENGL_API);
+	const EGLint renderable = EGL_OPENGL_BIT;
+	const EGLint context_attribs[] = {EGL_NONE};
+#endif
+	const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, renderable,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+#if defined (USE_STENCIL_BUFFER)
+		EGL_STENCIL_SIZE, 8,
+#endif
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint num_configs = 0;
+	if (!eglChooseConfig (egl_display, config_attribs, &config, 1, &num_configs) || num_configs < 1) {
+		Message ("no EGL pbuffer config");
+		return false;
+	}
+
+	const EGLint surface_attribs[] = {EGL_WIDTH, resolution.width, EGL_HEIGHT, resolution.height, EGL_NONE};
+	egl_surface = eglCreatePbufferSurface (egl_display, config, surface_attribs);
+	egl_context = eglCreateContext (egl_display, config, EGL_NO_CONTEXT, context_attribs);
+	if (egl_surface == EGL_NO_SURFACE || egl_context == EGL_NO_CONTEXT
+	        || !eglMakeCurrent (egl_display, egl_surface, egl_surface, egl_context)) {
+		Message ("could not create the offscreen GL context");
+		return false;
+	}
+	return true;
+}
+
+void CWinsys::QuitOffscreen () {
+	if (egl_display == EGL_NO_DISPLAY) return;
+	eglMakeCurrent (egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (egl_context != EGL_NO_CONTEXT) eglDestroyContext (egl_display, egl_context);
+	if (egl_surface != EGL_NO_SURFACE) eglDestroySurface (egl_display, egl_surface);
+	eglTerminate (egl_display);
+	egl_display = EGL_NO_DISPLAY;
+	egl_surface = EGL_NO_SURFACE;
+	egl_context = EGL_NO_CONTEXT;
+}
+
+// The headless backends render into an EGL pbuffer, there is no window
+// and SDL only handles events, timers and audio. The GL is whatever the
+// EGL driver offers, the renderer is written on the console. Without a
+// GPU that is a software rasterizer like llvmpipe, and its rasterization
+// is then part of the frame times of the benchmarks. The null backend
+// has the same context, but the draw and state calls are only counted
+// and not forwarded to GL, so it needs -DUSE_GLSTATS (see main.cpp).
 void CWinsys::Init () {
 	Uint32 sdl_flags = SDL_INIT_VIDEO | SDL_INIT_NOPARACHUTE | SDL_INIT_TIMER;
+	if (IsHeadless ()) sdl_flags = SDL_INIT_EVENTS | SDL_INIT_NOPARACHUTE | SDL_INIT_TIMER;
 	if (SDL_Init (sdl_flags) < 0) Message ("Could not initialize SDL");
 
+	if (IsHeadless ()) {
+		resolution = auto_resolution;
+		scale = CalcScreenScale ();
+		if (param.use_quad_scale) scale = sqrt (scale);
+		if (!InitOffscreen ()) {
+			QuitOffscreen ();
+			SDL_Quit ();
+			exit (1);
+		}
+		const GLubyte *renderer = glGetString (GL_RENDERER);
+		cout << "offscreen GL: " << (renderer ? (const char*)renderer : "unknown") << '\n';
+#ifdef USE_GLSTATS
+		if (backend == VIDEO_NULL) GLStatsSetForward (false);
+#endif
+	} else {
+		InitWindow ();
+	}
+	SetOrient(param.orient >= 0 ? param.orient : resolution.width < resolution.height);
+	Reshape (resolution.width, resolution.height);
+
+	//SDL_WM_SetCaption (WINDOW_TITLE, WINDOW_TITLE);
+	KeyRepeat (false);
+	if (USE_JOYSTICK) InitJoystick ();
+//	SDL_EnableUNICODE (1);
+}
+
+void CWinsys::InitWindow () {
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_EGL, 1);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 1); 
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1); 
@@ -160,13 +280,6 @@ void CWinsys::Init () {
 
 	SetupVideoMode (GetResolution (param.res_type));
 	context = SDL_GL_CreateContext(window);
-	SetOrient(param.orient >= 0 ? param.orient : resolution.width < resolution.height);
-	Reshape (resolution.width, resolution.height);
-
-	//SDL_WM_SetCaption (WINDOW_TITLE, WINDOW_TITLE);
-	KeyRepeat (false);
-	if (USE_JOYSTICK) InitJoystick ();
-//	SDL_EnableUNICODE (1);
 }
 
 void CWinsys::KeyRepeat (bool repeat) {
@@ -189,11 +302,12 @@ void CWinsys::CloseJoystick () {
 
 void CWinsys::Quit () {
 	CloseJoystick ();
-	Score.SaveHighScore ();
+	if (g_game.argument == RUN_GAME) Score.SaveHighScore ();
 	SaveMessages ();
 	Audio.Close ();		// frees music and sound as well
 	FT.Clear ();
-	if (g_game.argument < 1) Players.SavePlayers ();
+	if (g_game.argument == RUN_GAME) Players.SavePlayers ();
+	QuitOffscreen ();
 	SDL_Quit ();
 }
 
@@ -27,6 +27,13 @@ GNU General Public License for more details.
 
 extern TVector2i cursor_pos;
 
+// video backends, selected before Init (see --benchmark in main.cpp)
+enum TVideoBackend {
+	VIDEO_WINDOW,		// normal fullscreen window
+	VIDEO_OFFSCREEN,	// EGL pbuffer, no window and no display server
+	VIDEO_NULL			// like offscreen, draw calls are not forwarded (-DUSE_GLSTATS only)
+};
+
 struct TScreenRes {
 	int width, height;
 	TScreenRes(int w = 0, int h = 0) : width(w), height(h) {}
@@ -44,7 +51,11 @@ private:
 	TScreenRes auto_resolution;
 	SDL_Window *window;
 	SDL_GLContext context;
+	TVideoBackend backend;
 	ETR_DOUBLE CalcScreenScale () const;
+	void InitWindow ();
+	bool InitOffscreen ();
+	void QuitOffscreen ();
 public:
 	TScreenRes resolution;
 	ETR_DOUBLE scale;			// scale factor for screen, see 'use_quad_scale'
@@ -55,6 +66,8 @@ public:
 	// sdl window
 	const TScreenRes& GetResolution (size_t idx) const;
 	string GetResName (size_t idx) const;
+	void SetBackend (TVideoBackend b) { backend = b; }
+	bool IsHeadless () const { return backend != VIDEO_WINDOW; }
 	void Init ();
 	void SetupVideoMode (const TScreenRes& resolution);
 	void SetupVideoMode (size_t idx);
@@ -67,7 +80,7 @@ public:
 		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
 		glClear(GL_COLOR_BUFFER_BIT);
 		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-		SDL_GL_SwapWindow(window);
+		if (window) SDL_GL_SwapWindow(window);
 	}
 	void SetOrient(int o);
 	void Quit ();